@@ -0,0 +1,145 @@
+///
+/// \file       benchmark.cpp
+/// \brief      The Lung Carburetor Firmware benchmark module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    benchmark
+#include "benchmark.h"
+
+#if BENCHMARK
+#include "datamodel.h"
+#include "configuration.h"
+#include "control.h"
+#include "sensors.h"
+#include "safeties.h"
+#include "serialportreader.h"
+#include "warmrestart.h"
+#include "buzzer.h"
+
+/// \enum eBenchmarkConsts
+/// \brief Benchmark constants
+enum eBenchmarkConsts
+{
+    kBenchmarkIterations    = 100,  ///> Calls per benchmark, micros() resolution is 4us on a 16MHz part
+};
+
+static volatile float gSink;        // Keeps results of pure functions from being optimized out
+
+// Print benchmark result in microseconds per call, after its name
+static void Report(uint32_t nElapsed_us)
+{
+    char szValue[12];
+    dtostrf((float)nElapsed_us / kBenchmarkIterations, 0, 2, szValue);
+
+    Serial.print(',');
+    Serial.println(szValue);
+
+    wdt_reset();
+}
+
+static void Report(const __FlashStringHelper* szName, uint32_t nElapsed_us)
+{
+    Serial.print(szName);
+    Report(nElapsed_us);
+}
+
+void Benchmark_Run()
+{
+    uint32_t start;
+
+    // Control PID, controller state restored after
+    {
+        float fP = gDataModel.fP, fI = gDataModel.fI, fD = gDataModel.fD, fFF = gDataModel.fFF, fLeak = gDataModel.fLeak, fPI = gDataModel.fPI;
+        uint16_t nPWMPump = gDataModel.nPWMPump;
+
+        start = micros();
+        for (uint16_t a = 0; a < kBenchmarkIterations; ++a)
+        {
+            Control_PID();
+        }
+        Report(F("Control_PID"), micros() - start);
+
+        gDataModel.fP = fP; gDataModel.fI = fI; gDataModel.fD = fD; gDataModel.fFF = fFF; gDataModel.fLeak = fLeak; gDataModel.fPI = fPI;
+        gDataModel.nPWMPump = nPWMPump;
+    }
+
+    // Respiration set-point while waiting for a timed trigger, never starts a respiration
+    {
+        eTriggerMode nTriggerMode   = gDataModel.nTriggerMode;
+        gDataModel.nTriggerMode     = kTriggerMode_Timed;
+        gDataModel.nCycleState      = kCycleState_WaitTrigger;
+        gDataModel.nRespirationDeadline_us = micros() + 60000000UL;
+
+        start = micros();
+        for (uint16_t a = 0; a < kBenchmarkIterations; ++a)
+        {
+            Control_ComputeRespirationSetPoint();
+        }
+        Report(F("ComputeRespirationSetPoint"), micros() - start);
+
+        gDataModel.nTriggerMode     = nTriggerMode;
+    }
+
+    // Command lookup of every opcode, handlers mostly print on the serial port and are not timed
+    char szName[4];
+    for (uint8_t index = 1; GetCommandName(index, szName); ++index)
+    {
+        const uint8_t* pName = reinterpret_cast<const uint8_t*>(szName);
+
+        start = micros();
+        for (uint16_t a = 0; a < kBenchmarkIterations; ++a)
+        {
+            gSink = FindCommand(pName);
+        }
+
+        Serial.print(szName);
+        Report(micros() - start);
+    }
+
+    // Curve update from current settings, fills and commits the same shadow curves again
+    start = micros();
+    for (uint16_t a = 0; a < kBenchmarkIterations; ++a)
+    {
+        updateCurve();
+    }
+    Report(F("updateCurve"), micros() - start);
+
+    start = micros();
+    for (uint16_t a = 0; a < kBenchmarkIterations; ++a)
+    {
+        gSink = Sensors_PressureTransfer(a);
+    }
+    Report(F("Sensors_PressureTransfer"), micros() - start);
+
+    // Safeties evaluate rules on new samples only, every call sees a new one
+    start = micros();
+    for (uint16_t a = 0; a < kBenchmarkIterations; ++a)
+    {
+        ++gDataModel.nSampleCount;
+        Safeties_Process();
+    }
+    Report(F("Safeties_Process"), micros() - start);
+
+    start = micros();
+    for (uint16_t a = 0; a < kBenchmarkIterations; ++a)
+    {
+        gSink = CRC32((uint8_t*)&gConfiguration, sizeof(tConfiguration));
+    }
+    Report(F("CRC32"), micros() - start);
+
+    start = micros();
+    for (uint16_t a = 0; a < kBenchmarkIterations; ++a)
+    {
+        WarmRestart_Save();
+    }
+    Report(F("WarmRestart_Save"), micros() - start);
+
+    start = micros();
+    for (uint16_t a = 0; a < kBenchmarkIterations; ++a)
+    {
+        Buzzer_Process();
+    }
+    Report(F("Buzzer_Process"), micros() - start);
+}
+
+#endif // BENCHMARK
@@ -0,0 +1,24 @@
+///
+/// \file       benchmark.h
+/// \brief      The Lung Carburetor Firmware benchmark module
+///
+/// Test-only micro-benchmarks of the firmware hot paths, timed on the target with micros().
+/// Only built when BENCHMARK is enabled in defs.h.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   benchmark Benchmark
+#ifndef TLC_BENCHMARK_H
+#define TLC_BENCHMARK_H
+
+#include "common.h"
+
+#if BENCHMARK
+
+/// \fn void Benchmark_Run()
+/// \brief Run all benchmarks and print one "name,us per call" line for each on the serial port.
+/// Must only run while respiration is stopped, control state is modified.
+void Benchmark_Run();
+
+#endif // BENCHMARK
+
+#endif // TLC_BENCHMARK_H
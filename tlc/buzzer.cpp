@@ -0,0 +1,115 @@
+///
+/// \file       buzzer.cpp
+/// \brief      The Lung Carburetor Firmware buzzer module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    buzzer
+#include "buzzer.h"
+#include "datamodel.h"
+
+/// \enum eBuzzerConsts
+/// \brief Buzzer constants
+enum eBuzzerConsts
+{
+    kBuzzerMediumWarnings   = kAlarm_PressureRedundancyLost,    ///> Ventilation goes on without sensor redundancy
+    kBuzzerLowWarnings      = kAlarm_BatteryLow,                ///> Operator awareness
+    kBuzzerWarnings         = kBuzzerMediumWarnings | kBuzzerLowWarnings,   ///> Alarms not stopping ventilation, any other is high priority
+};
+
+/// \struct tBuzzerPattern
+/// \brief Pulses of a burst, one kPeriodBuzzer slot per bit, first slot in bit 0
+struct tBuzzerPattern
+{
+    uint32_t    nPulses;    ///> Buzzer on in slots with a set bit
+    uint8_t     nLength;    ///> Slots of the burst
+    uint8_t     nPeriod;    ///> Slots between burst starts, 0 for a single burst
+};
+
+// In eBuzzerPriority order, kPeriodBuzzer slots
+static const tBuzzerPattern gBuzzerPatterns[kBuzzerPriority_Count] PROGMEM =
+{
+    { 0x000000, 0,  0   },  // None
+    { 0x000001, 1,  0   },  // Chirp:  x
+    { 0x000005, 3,  250 },  // Low:    x-x, every 25s
+    { 0x000015, 5,  100 },  // Medium: x-x-x, every 10s
+    { 0x52A295, 23, 60  },  // High:   x-x-x--x-x---x-x-x--x-x, every 6s
+};
+
+// Pulse widths and spacing of the patterns are set for 100ms slots
+HXCOMPILATIONASSERT(assertBuzzerPeriodCheck, (kPeriodBuzzer == 100));
+
+/// \struct tBuzzer
+/// \brief Buzzer pattern state
+struct tBuzzer
+{
+    uint8_t         nPriority;  ///> Sounded pattern (eBuzzerPriority)
+    uint8_t         nSlot;      ///> Current slot in the pattern period
+    bool            bChirp;     ///> Chirp requested and not sounded yet
+    bool            bOn;        ///> Buzzer output
+    uint32_t        nPulses;    ///> Pulses left in the current burst, next slot in bit 0
+    tBuzzerPattern  pattern;    ///> Sounded pattern, copied from flash when priority changes
+};
+static tBuzzer gBuzzer;
+
+// Buzzer is active low
+static void SetBuzzer(bool bOn)
+{
+    if (bOn != gBuzzer.bOn)
+    {
+        gBuzzer.bOn = bOn;
+        digitalWrite(PIN_OUT_BUZZER, bOn ? LOW : HIGH);
+    }
+}
+
+void Buzzer_Init()
+{
+    memset(&gBuzzer, 0, sizeof(tBuzzer));
+    digitalWrite(PIN_OUT_BUZZER, HIGH);
+}
+
+void Buzzer_Chirp()
+{
+    gBuzzer.bChirp = true;
+}
+
+void Buzzer_Process()
+{
+    // Stopped ventilation is always high priority, raised alarms outside of error are warnings
+    uint16_t flags = gDataModel.nSafetyFlags;
+    uint8_t  priority;
+    if (gDataModel.nState == kState_Error || (flags & ~kBuzzerWarnings)) priority = kBuzzerPriority_High;
+    else if (flags & kBuzzerMediumWarnings) priority = kBuzzerPriority_Medium;
+    else if (flags & kBuzzerLowWarnings)    priority = kBuzzerPriority_Low;
+    else if (gBuzzer.bChirp)                priority = kBuzzerPriority_Chirp;
+    else                                    priority = kBuzzerPriority_None;
+
+    // New pattern starts from its first slot, a pending chirp is consumed by any new pattern
+    if (priority != gBuzzer.nPriority)
+    {
+        gBuzzer.nPriority   = priority;
+        gBuzzer.nSlot       = 0;
+        gBuzzer.bChirp      = false;
+        memcpy_P(&gBuzzer.pattern, &gBuzzerPatterns[priority], sizeof(tBuzzerPattern));
+    }
+
+    if (gBuzzer.nSlot == 0)
+    {
+        gBuzzer.nPulses = gBuzzer.pattern.nPulses;
+    }
+
+    if (gBuzzer.nSlot < gBuzzer.pattern.nLength)
+    {
+        SetBuzzer(gBuzzer.nPulses & 1);
+        gBuzzer.nPulses >>= 1;
+        ++gBuzzer.nSlot;
+        return;
+    }
+
+    SetBuzzer(false);
+
+    // Between bursts; a single burst stays silent past its length until the priority changes
+    if (gBuzzer.pattern.nPeriod != 0 && ++gBuzzer.nSlot >= gBuzzer.pattern.nPeriod)
+    {
+        gBuzzer.nSlot = 0;
+    }
+}
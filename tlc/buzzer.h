@@ -0,0 +1,42 @@
+///
+/// \file       buzzer.h
+/// \brief      The Lung Carburetor Firmware buzzer module
+///
+/// Non-blocking buzzer patterns, in the style of IEC 60601-1-8 alarm signals: a high priority alarm sounds
+/// bursts of 10 pulses, a medium priority one bursts of 3 pulses, a low priority one 2 pulses. Priority follows
+/// the consequence: an error stopping ventilation is always high priority, warnings raised while ventilation
+/// goes on have their own priority. A higher priority preempts the current pattern at once.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   buzzer Buzzer
+#ifndef TLC_BUZZER_H
+#define TLC_BUZZER_H
+
+#include "common.h"
+
+/// \enum eBuzzerPriority
+/// \brief Sounded pattern, in increasing priority
+enum eBuzzerPriority
+{
+    kBuzzerPriority_None = 0,   ///> Silent
+    kBuzzerPriority_Chirp,      ///> Single pulse, at boot
+    kBuzzerPriority_Low,        ///> Low priority alarm
+    kBuzzerPriority_Medium,     ///> Medium priority alarm
+    kBuzzerPriority_High,       ///> High priority alarm
+
+    kBuzzerPriority_Count
+};
+
+/// \fn void Buzzer_Init()
+/// \brief Initialize buzzer, silent
+void Buzzer_Init();
+
+/// \fn void Buzzer_Chirp()
+/// \brief Sound a single pulse, unless an alarm is sounding
+void Buzzer_Chirp();
+
+/// \fn void Buzzer_Process()
+/// \brief Sound the pattern of the highest priority raised alarm, called every kPeriodBuzzer
+void Buzzer_Process();
+
+#endif // TLC_BUZZER_H
@@ -0,0 +1,133 @@
+///
+/// \file       calibration.cpp
+/// \brief      The Lung Carburetor Firmware pressure calibration module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    calibration
+#include "calibration.h"
+#include "configuration.h"
+#include "sensors.h"
+
+/// \struct tCalibrationSegment
+/// \brief Calibration segment from a point to the next one, fixed-point
+struct tCalibrationSegment
+{
+    uint16_t    nRaw;           ///> Measured counts at segment start
+    int32_t     nCounts_q8;     ///> Nominal counts at segment start, Q8
+    int32_t     nSlope_q16;     ///> Nominal counts per measured count, Q16
+};
+
+/// \struct tCalibrationTable
+/// \brief Calibration segments of every pressure channel
+struct tCalibrationTable
+{
+    tCalibrationSegment pSegments[kPressureChannelCount][kCalibrationPointCount - 1];
+    uint8_t             nSegments[kPressureChannelCount];   ///> 0 when channel uses the nominal transfer
+};
+static tCalibrationTable gCalibrationTable;
+
+// Build segments of a channel, points must be sorted by strictly increasing counts
+static void BuildChannel(uint8_t nChannel)
+{
+    const tCalibration& calibration = gConfiguration.pCalibration[nChannel];
+    gCalibrationTable.nSegments[nChannel] = 0;
+
+    if (calibration.nCount < 2 || calibration.nCount > kCalibrationPointCount)
+    {
+        return;
+    }
+
+    for (uint8_t a = 1; a < calibration.nCount; ++a)
+    {
+        if (calibration.pPoints[a].nRaw <= calibration.pPoints[a - 1].nRaw)
+        {
+            return;
+        }
+    }
+
+    for (uint8_t a = 0; a + 1 < calibration.nCount; ++a)
+    {
+        const tCalibrationPoint& p0 = calibration.pPoints[a];
+        const tCalibrationPoint& p1 = calibration.pPoints[a + 1];
+
+        float c0    = Sensors_PressureInverseTransfer(p0.fPressure_mmH2O);
+        float c1    = Sensors_PressureInverseTransfer(p1.fPressure_mmH2O);
+        float slope = (c1 - c0) / (float)(p1.nRaw - p0.nRaw);
+
+        tCalibrationSegment& segment = gCalibrationTable.pSegments[nChannel][a];
+        segment.nRaw        = p0.nRaw;
+        segment.nCounts_q8  = lround(c0 * 256.0f);
+        segment.nSlope_q16  = lround(constrain(slope, -32.0f, 32.0f) * 65536.0f);
+    }
+
+    gCalibrationTable.nSegments[nChannel] = calibration.nCount - 1;
+}
+
+void Calibration_Build()
+{
+    for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+    {
+        BuildChannel(a);
+    }
+}
+
+uint16_t Calibration_Apply(uint8_t nChannel, uint16_t nRaw)
+{
+    uint8_t index = gCalibrationTable.nSegments[nChannel];
+    if (index == 0)
+    {
+        return nRaw;
+    }
+
+    // First and last segments extrapolate outside the calibrated range
+    const tCalibrationSegment* pSegments = gCalibrationTable.pSegments[nChannel];
+    --index;
+    while (index > 0 && nRaw < pSegments[index].nRaw)
+    {
+        --index;
+    }
+
+    const tCalibrationSegment& segment = pSegments[index];
+    int32_t counts_q8 = segment.nCounts_q8 + ((static_cast<int32_t>(nRaw) - segment.nRaw) * segment.nSlope_q16 >> 8);
+    int32_t counts    = (counts_q8 + 128) >> 8;
+
+    return static_cast<uint16_t>(constrain(counts, 0L, 0xFFFFL));
+}
+
+bool Calibration_AddPoint(uint8_t nChannel, uint16_t nRaw, float fPressure_mmH2O)
+{
+    tCalibration& calibration = gConfiguration.pCalibration[nChannel];
+    if (calibration.nCount > kCalibrationPointCount)
+    {
+        calibration.nCount = 0;
+    }
+
+    uint8_t index = 0;
+    while (index < calibration.nCount && calibration.pPoints[index].nRaw < nRaw)
+    {
+        ++index;
+    }
+
+    if (index >= calibration.nCount || calibration.pPoints[index].nRaw != nRaw)
+    {
+        if (calibration.nCount >= kCalibrationPointCount)
+        {
+            return false;
+        }
+
+        memmove(&calibration.pPoints[index + 1], &calibration.pPoints[index], (calibration.nCount - index) * sizeof(tCalibrationPoint));
+        ++calibration.nCount;
+    }
+
+    calibration.pPoints[index].nRaw             = nRaw;
+    calibration.pPoints[index].fPressure_mmH2O  = fPressure_mmH2O;
+
+    BuildChannel(nChannel);
+    return true;
+}
+
+void Calibration_Clear(uint8_t nChannel)
+{
+    gConfiguration.pCalibration[nChannel].nCount = 0;
+    BuildChannel(nChannel);
+}
@@ -0,0 +1,33 @@
+///
+/// \file       calibration.h
+/// \brief      The Lung Carburetor Firmware pressure calibration module
+///
+/// Multi-point calibration of every pressure sensor, points stored in the configuration. Points are
+/// converted to a fixed-point segment table mapping measured counts to the counts the nominal sensor
+/// transfer function would read, so fusion, safeties and control keep working in nominal counts.
+/// Applying it costs a segment search and an integer multiply per sample, no float divide.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   calibration Pressure calibration
+#ifndef TLC_CALIBRATION_H
+#define TLC_CALIBRATION_H
+
+#include "common.h"
+
+/// \fn void Calibration_Build()
+/// \brief Build segment tables from configuration points, sensors without valid points use the nominal transfer
+void Calibration_Build();
+
+/// \fn uint16_t Calibration_Apply(uint8_t nChannel, uint16_t nRaw)
+/// \brief Convert measured counts of pressure channel nChannel, offset removed, to nominal counts
+uint16_t Calibration_Apply(uint8_t nChannel, uint16_t nRaw);
+
+/// \fn bool Calibration_AddPoint(uint8_t nChannel, uint16_t nRaw, float fPressure_mmH2O)
+/// \brief Insert or replace the point at nRaw in the configuration, then rebuild. Returns false if table is full.
+bool Calibration_AddPoint(uint8_t nChannel, uint16_t nRaw, float fPressure_mmH2O);
+
+/// \fn void Calibration_Clear(uint8_t nChannel)
+/// \brief Remove every point of pressure channel nChannel, which then uses the nominal transfer
+void Calibration_Clear(uint8_t nChannel);
+
+#endif // TLC_CALIBRATION_H
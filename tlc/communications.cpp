@@ -8,6 +8,8 @@
 #include "datamodel.h"
 #include "lcd_keypad.h"
 #include "serialportreader.h"
+#include "faultinjection.h"
+#include "recorder.h"
 
 static bool     gSerialConnected    = false;
 
@@ -62,6 +64,9 @@ void Communications_Process()
             }
 
             Serial.readBytes(&gRxBuffer.data[ofs], count-ofs);
+#if FAULT_INJECTION
+            count = ofs + FaultInjection_Serial(&gRxBuffer.data[ofs], count-ofs);
+#endif
 
             // Scan for crlf
             int cmdOfs = 0;
@@ -70,6 +75,7 @@ void Communications_Process()
                 if (gRxBuffer.data[a]   == '\r' &&
                     gRxBuffer.data[a+1] == '\n')
                 {
+                    Recorder_CaptureCommand(&gRxBuffer.data[cmdOfs], a+2 - cmdOfs);
                     ParseCommand(&gRxBuffer.data[cmdOfs], a+2 - cmdOfs);
 
                     ++a;
@@ -98,7 +104,7 @@ void Communications_Process()
         // Print the lcd details on the serial since not everyone has one!
         if (strlen(gLcdDetail) > 0)
         {
-            Serial.print("DEBUG:");
+            Serial.print(F("DEBUG:"));
             Serial.println(gLcdDetail);
         }
         #endif
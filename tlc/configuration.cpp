@@ -7,6 +7,8 @@
 #include "configuration.h"
 #include <EEPROM.h>
 #include "lcd_keypad.h"
+#include "pumpmap.h"
+#include "calibration.h"
 
 tConfiguration gConfiguration;
 
@@ -23,13 +25,13 @@ bool Configuration_Init()
     bool bValid = Configuration_Read();
     if (!bValid)
     {
-        sprintf(gLcdMsg, "NVM Fail");
+        strcpy_P(gLcdMsg, PSTR("NVM Fail"));
         Configuration_SetDefaults();
         Configuration_Write();
     }
     else
     {
-        sprintf(gLcdMsg, "NVM Success");
+        strcpy_P(gLcdMsg, PSTR("NVM Success"));
 
     }
 #endif
@@ -41,7 +43,7 @@ bool Configuration_Init()
 // Written by Christopher Andrews.
 // CRC algorithm generated by pycrc, MIT licence ( https://github.com/tpircher/pycrc ).
 //
-static uint32_t CRC32(uint8_t* pBuffer, int len)
+uint32_t CRC32(uint8_t* pBuffer, int len)
 {
     const uint32_t crc_table[16] =
     {
@@ -66,22 +68,33 @@ bool Configuration_SetDefaults()
 {
     gConfiguration.nVersion                 = kEEPROM_Version;
     gConfiguration.fMinBatteryLevel         = 10.0f;
-    gConfiguration.nPressureSensorOffset[0] = 0;
-    gConfiguration.nPressureSensorOffset[1] = 0;
+    memset(gConfiguration.nPressureSensorOffset, 0, sizeof(gConfiguration.nPressureSensorOffset));
+    memset(gConfiguration.pCalibration, 0, sizeof(gConfiguration.pCalibration));
     gConfiguration.fMaxPressureLimit_mmH2O  = kMPX5010_MaxPressure_mmH2O;
     gConfiguration.fMinPressureLimit_mmH2O  = -kMPX5010_MaxPressure_mmH2O;
     gConfiguration.fMaxPressureDelta_mmH2O  = kMPX5010_MaxPressureDelta_mmH2O;
-    gConfiguration.fGainP                   = 250.5f;
-    gConfiguration.fGainI                   = 0.01f;
-    gConfiguration.fGainD                   = 0.0000f;
+    for (int a = 0; a < kGainSet_Count; ++a)
+    {
+        gConfiguration.pGains[a].fP         = 250.5f;
+        gConfiguration.pGains[a].fI         = 0.01f;
+        gConfiguration.pGains[a].fD         = 0.0000f;
+    }
     gConfiguration.fILimit                  = 5.0f;
     gConfiguration.fPILimit                 = 1000.0f;
     gConfiguration.fControlTransfer         = 1.0f;
+    gConfiguration.fFeedForwardGain         = 0.0f;
+    gConfiguration.fFeedForwardForget       = 0.98f;
+    gConfiguration.nPumpMapMode             = kPumpMapMode_Learn;
+    gConfiguration.fLeakCompensationGain    = 0.0f;
     gConfiguration.fPatientTrigger_mmH2O    = 40.0f;
+    gConfiguration.fPatientTriggerSlope_mmH2O_s = 100.0f;
+    gConfiguration.nPatientTriggerRefractory_ms = 300;
     gConfiguration.nServoExhaleOpenAngle    = 2270;
     gConfiguration.nServoExhaleCloseAngle   = 750;
     gConfiguration.nCRC                     = 0; // Clear CRC for computation
 
+    Calibration_Build();
+
     return true;
 }
 
@@ -99,6 +112,9 @@ bool Configuration_Read()
     gConfiguration.nCRC = 0; // Clear CRC for computation
     uint32_t cmpCRC = CRC32(pConfiguration, sizeof(tConfiguration));
 
+    // Invalid points fall back on the nominal transfer until defaults are set
+    Calibration_Build();
+
     return (oemCRC == cmpCRC) && (gConfiguration.nVersion == kEEPROM_Version);
 }
 
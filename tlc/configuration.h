@@ -9,23 +9,53 @@
 
 #include "common.h"
 
+/// \struct tGains
+/// \brief PID gains of a gain set
+struct tGains
+{
+    float       fP;                         ///> Control gain P
+    float       fI;                         ///> Control gain I
+    float       fD;                         ///> Control gain D
+};
+
+/// \struct tCalibrationPoint
+/// \brief Pressure calibration point
+struct tCalibrationPoint
+{
+    uint16_t    nRaw;                       ///> Measured counts, offset removed
+    float       fPressure_mmH2O;            ///> Reference pressure
+};
+
+/// \struct tCalibration
+/// \brief Multi-point calibration of a pressure sensor, points sorted by counts
+struct tCalibration
+{
+    uint8_t             nCount;                             ///> Number of points, less than 2 for the nominal transfer
+    tCalibrationPoint   pPoints[kCalibrationPointCount];    ///> Calibration points
+};
+
 /// \struct tConfiguration
 /// \brief NVM Configuration Stored and Loaded from EEPROM.
 struct tConfiguration
 {
     uint8_t     nVersion;                   ///> Configuration structure version
-    uint16_t    nPressureSensorOffset[2];   ///> Offset when pressure sensor is at atmosphere readings
+    uint16_t    nPressureSensorOffset[kPressureChannelCount]; ///> Offset when pressure sensor is at atmosphere readings
+    tCalibration pCalibration[kPressureChannelCount]; ///> Multi-point calibration of every pressure sensor
     float       fMinBatteryLevel;           ///> Minimum battery level for alarm
     float       fMaxPressureLimit_mmH2O;    ///> Max allowed pressure limit
     float       fMinPressureLimit_mmH2O;    ///> Min allowed pressure limit
     float       fMaxPressureDelta_mmH2O;    ///> Maximum allowed pressure delta between redundant readings
-    float       fGainP;                     ///> Control gain P
-    float       fGainI;                     ///> Control gain I
-    float       fGainD;                     ///> Control gain D
+    tGains      pGains[kGainSet_Count];     ///> Control gains for every eGainSet
     float       fILimit;                    ///> Integral error limit
     float       fPILimit;                   ///> Proportional+Integral error limit
     float       fControlTransfer;           ///> Control transfer from adjusted errors to pwm
+    float       fFeedForwardGain;           ///> Iterative learning gain, pwm correction per mmH2O of error, 0 disables learning
+    float       fFeedForwardForget;         ///> Iterative learning forgetting factor (0..1) applied to corrections every respiration
+    uint8_t     nPumpMapMode;               ///> Pump map usage (ePumpMapMode)
+    float       fLeakCompensationGain;      ///> Fraction (0..1) of the estimated leak compensated by feed-forward, 0 disables
     float       fPatientTrigger_mmH2O;      ///> Patient triggers respiration when this value is reached (In TriggerMode Patient or semi automatic)
+    float       fPatientTriggerSlope_mmH2O_s; ///> Patient triggers respiration when pressure falls faster than this slope, 0 disables
+    uint16_t    nPatientTriggerRefractory_ms; ///> Slope trigger ignored for this time after exhale, valve transients are not patient efforts
     uint16_t    nServoExhaleOpenAngle;      ///> Angle in degree (0..180) when exhale servo valve is open
     uint16_t    nServoExhaleCloseAngle;     ///> Angle in degree (0..180) when exhale servo valve is close
     uint32_t    nCRC;                       ///> Configuration CRC check
@@ -33,7 +63,11 @@ struct tConfiguration
 extern tConfiguration gConfiguration;
 
 // Make sure that configuration structure can fit into the EEPROM
-HXCOMPILATIONASSERT(assertEEPROMSizeCheck, (sizeof(tConfiguration) <= 512));
+HXCOMPILATIONASSERT(assertEEPROMSizeCheck, (sizeof(tConfiguration) <= kEEPROM_PumpMapOffset));
+
+/// \fn uint32_t CRC32(uint8_t* pBuffer, int len)
+/// \brief Compute CRC32 of a buffer, used to validate EEPROM content
+uint32_t CRC32(uint8_t* pBuffer, int len);
 
 /// \fn bool Configuration_Init()
 /// \brief Initialize configuration module
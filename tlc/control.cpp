@@ -10,15 +10,58 @@
 #include "safeties.h"
 #include "TimerOne.h"
 #include "lcd_keypad.h"
+#include "feedforward.h"
+#include "pumpmap.h"
+#include "leak.h"
+#include "faultinjection.h"
 
 ServoTimer2 exhaleValveServo;
 
+static uint32_t gLastTimedStart_us   = 0;       // Start of last timed respiration, reference for interval error
+static bool     gLastTimedValid      = false;   // Last respiration was timed and scheduler ran since
+static float    gLastPressure_mmH2O  = 0.0f;    // Pressure at previous control tick, for the derivative
+static bool     gPatientTriggerArmed = false;   // Slope trigger armed, re-armed once pressure is steady again
+
+static float    gPidLastPressure_mmH2O = 0.0f;  // Pressure at previous PID update, for the derivative term
+static uint8_t  gPidGainSet          = kGainSet_Hold; // Gain set used at previous PID update
+static bool     gExhaleValveOpen     = true;    // Last exhale valve command
+static bool     gWasStarted          = false;   // Start flag at previous control tick, to detect an operator stop
+
+static const float kPressureSlopeFilterGain = 0.25f;    // First order low-pass gain on the pressure derivative
+static const float kDerivativeFilterGain    = 0.2f;     // First order low-pass gain on the PID derivative term
+static const float kAntiWindupGain          = 0.5f;     // Back-calculation gain, fraction of saturation removed from integral per tick
+
+// Command exhale valve servo
+static void SetExhaleValve(bool bOpen)
+{
+    gExhaleValveOpen = bOpen;
+#if FAULT_INJECTION
+    if (FaultInjection_IsActive(kFault_ServoStuck))
+    {
+        return;
+    }
+#endif
+    exhaleValveServo.write(bOpen ? gConfiguration.nServoExhaleOpenAngle : gConfiguration.nServoExhaleCloseAngle);
+}
+
+// Pump power to output
+static void WritePump()
+{
+#if FAULT_INJECTION
+    Timer1.pwm(PIN_OUT_PUMP1_PWM, FaultInjection_Pump(gDataModel.nPWMPump));
+#else
+    Timer1.pwm(PIN_OUT_PUMP1_PWM, gDataModel.nPWMPump);
+#endif
+}
+
 bool Control_Init()
 {
     gDataModel.nTickRespiration = millis(); // Respiration cycle start tick. Used to compute respiration per minutes
-    exhaleValveServo.write(gConfiguration.nServoExhaleOpenAngle);
+    Control_SetRespirationRate(gDataModel.fRespirationPerMinute);
+    gDataModel.nRespirationDeadline_us = micros() + gDataModel.nRespirationPeriod_us;
+    SetExhaleValve(true);
 
-    Timer1.initialize(4000);         // initialize timer1, and set a 4000us period
+    Timer1.initialize(kPeriodPumpPWM_us);   // initialize timer1, and set a 4000us period
     Timer1.pwm(PIN_OUT_PUMP1_PWM, 0);                // setup pwm on pin 9, 50% duty cycle  ( 0 to 1000)
 
     gDataModel.bStartFlag = false;
@@ -26,13 +69,9 @@ bool Control_Init()
     return true;
 }
 
-// Control using a PID with pressure feedback
-void Control_PID()
+// Keep the integral within fILimit
+static void ClampIntegral()
 {
-    gDataModel.fPressureError = gDataModel.fRequestPressure_mmH2O - gDataModel.fPressure_mmH2O[0];
-    gDataModel.fP = gDataModel.fPressureError * gConfiguration.fGainP;
-
-    gDataModel.fI += gDataModel.fPressureError;
     if (gDataModel.fI > gConfiguration.fILimit)
     {
         gDataModel.fI = gConfiguration.fILimit;
@@ -41,8 +80,53 @@ void Control_PID()
     {
         gDataModel.fI = -gConfiguration.fILimit;
     }
+}
+
+// Control using a PID with pressure feedback
+void Control_PID()
+{
+    if (gDataModel.nGainSet >= kGainSet_Count)
+    {
+        gDataModel.nGainSet = kGainSet_Hold;
+    }
+    const tGains& gains = gConfiguration.pGains[gDataModel.nGainSet];
+
+    gDataModel.fPressureError = gDataModel.fRequestPressure_mmH2O - gDataModel.fPressureFused_mmH2O;
+    gDataModel.fP = gDataModel.fPressureError * gains.fP;
+
+    // Feed-forward learned at this time of previous respirations, and record this error for the next one
+    uint32_t breathTick = millis() - gDataModel.nTickRespiration;
+    gDataModel.fFF = FeedForward_Get(breathTick);
+    FeedForward_Record(breathTick, gDataModel.fPressureError);
+
+    // Leak only drains the circuit while the exhale valve is closed
+    gDataModel.fLeak = gExhaleValveOpen ? 0.0f : gConfiguration.fLeakCompensationGain * Leak_GetCompensation(gDataModel.fRequestPressure_mmH2O);
 
-    gDataModel.fPI = gDataModel.fP + gDataModel.fI;
+    if (gDataModel.nGainSet != gPidGainSet)
+    {
+        // Bumpless transfer: integral takes only the change of the gain set terms at the current error,
+        // so the set-point step of the new phase still drives the output
+        const tGains& previous = gConfiguration.pGains[gPidGainSet];
+        gDataModel.fI += (previous.fP - gains.fP) * gDataModel.fPressureError;
+        if (previous.fD != 0.0f)
+        {
+            float fD = gDataModel.fD * gains.fD / previous.fD;
+            gDataModel.fI += gDataModel.fD - fD;
+            gDataModel.fD  = fD;
+        }
+        gPidGainSet = gDataModel.nGainSet;
+    }
+
+    // Derivative on measurement, so set-point steps of the curve do not kick the pump. First order low-pass filtered.
+    float rawD = -(gDataModel.fPressureFused_mmH2O - gPidLastPressure_mmH2O) * gains.fD;
+    gPidLastPressure_mmH2O = gDataModel.fPressureFused_mmH2O;
+    gDataModel.fD += kDerivativeFilterGain * (rawD - gDataModel.fD);
+
+    gDataModel.fI += gDataModel.fPressureError * gains.fI;
+    ClampIntegral();
+
+    float unsaturated = gDataModel.fP + gDataModel.fI + gDataModel.fD + gDataModel.fFF + gDataModel.fLeak;
+    gDataModel.fPI = unsaturated;
     if (gDataModel.fPI > gConfiguration.fPILimit)
     {
         gDataModel.fPI = gConfiguration.fPILimit;
@@ -52,42 +136,109 @@ void Control_PID()
         gDataModel.fPI = -gConfiguration.fPILimit;
     }
 
-    // Note: Derivative not used, not necessary for now.
-
     //*** Validate how we manage too much pressure
     if (gDataModel.fPI < 0)
     {
         gDataModel.fPI = 0;
     }
 
-    gDataModel.nPWMPump = (uint16_t)(gDataModel.fPI * gConfiguration.fControlTransfer);
+    // Back-calculation anti-windup: bleed the integral by the amount the output saturated, within its limit
+    gDataModel.fI += kAntiWindupGain * (gDataModel.fPI - unsaturated);
+    ClampIntegral();
+
+    // Pump map only describes the pump against a closed exhale valve
+    float command = gDataModel.fPI * gConfiguration.fControlTransfer;
+    if (gExhaleValveOpen)
+    {
+        gDataModel.nPWMPump = (uint16_t)command;
+    }
+    else
+    {
+        gDataModel.nPWMPump = PumpMap_Linearize(command);
+    }
 }
 
-// Return true when condition for respiration has been triggered
-static bool CheckTrigger()
+void Control_SetRespirationRate(float fRespirationPerMinute)
+{
+    gDataModel.fRespirationPerMinute = fRespirationPerMinute;
+    gDataModel.nRespirationPeriod_us = (fRespirationPerMinute > 0.0f) ? (uint32_t)(60000000.0f / fRespirationPerMinute + 0.5f) : 0;
+}
+
+// Update the filtered pressure derivative in mmH2O/s
+static void UpdatePressureSlope()
+{
+    float slope = (gDataModel.fPressureFused_mmH2O - gLastPressure_mmH2O) * (1000.0f / kPeriodControl);
+    gLastPressure_mmH2O = gDataModel.fPressureFused_mmH2O;
+
+    gDataModel.fPressureSlope_mmH2O_s += kPressureSlopeFilterGain * (slope - gDataModel.fPressureSlope_mmH2O_s);
+}
+
+// Return true when patient inspiratory effort is detected
+static bool CheckPatientTrigger()
+{
+    // Pressure pulled below absolute threshold
+    if (gDataModel.fPressureFused_mmH2O < gConfiguration.fPatientTrigger_mmH2O)
+    {
+        return true;
+    }
+
+    if (gConfiguration.fPatientTriggerSlope_mmH2O_s <= 0.0f)
+    {
+        return false;
+    }
+
+    // Refractory window after exhale, the valve transient is not a patient effort
+    if ((millis() - gDataModel.nTickWait) < gConfiguration.nPatientTriggerRefractory_ms)
+    {
+        gPatientTriggerArmed = false;
+        return false;
+    }
+
+    if (!gPatientTriggerArmed)
+    {
+        // Hysteresis: re-arm only when pressure falls at less than half the trigger slope
+        gPatientTriggerArmed = gDataModel.fPressureSlope_mmH2O_s > -0.5f * gConfiguration.fPatientTriggerSlope_mmH2O_s;
+        return false;
+    }
+
+    if (gDataModel.fPressureSlope_mmH2O_s <= -gConfiguration.fPatientTriggerSlope_mmH2O_s)
+    {
+        gPatientTriggerArmed = false;
+        return true;
+    }
+
+    return false;
+}
+
+// Return true when the absolute deadline of the next timed respiration is reached
+static bool CheckTimedTrigger()
+{
+    return (gDataModel.nRespirationPeriod_us > 0) && ((int32_t)(micros() - gDataModel.nRespirationDeadline_us) >= 0);
+}
+
+// Return true when condition for respiration has been triggered, bTimed tells if it was triggered by the scheduler
+static bool CheckTrigger(bool& bTimed)
 {
     bool trigger = false;
+    bTimed = false;
     switch (gDataModel.nTriggerMode)
     {
     case kTriggerMode_Timed:
-        trigger = ((gDataModel.nRespirationPerMinute > 0) && (millis() - gDataModel.nTickRespiration) >= (60000 / gDataModel.nRespirationPerMinute));
+        trigger = bTimed = CheckTimedTrigger();
         break;
 
     case kTriggerMode_Patient:
         // If patient triggers respiration
-        if (gDataModel.fPressure_mmH2O[0] < gConfiguration.fPatientTrigger_mmH2O)
-        {
-            trigger = true;
-        }
+        trigger = CheckPatientTrigger();
         break;
 
     case kTriggerMode_PatientSemiAutomatic:
         // If patient triggers respiration or if time for next respiration cycle
-        if (gDataModel.fPressure_mmH2O[0] < gConfiguration.fPatientTrigger_mmH2O)
+        trigger = CheckPatientTrigger();
+        if (!trigger)
         {
-            trigger = true;
+            trigger = bTimed = CheckTimedTrigger();
         }
-        trigger |= ((gDataModel.nRespirationPerMinute > 0) && (millis() - gDataModel.nTickRespiration) >= (60000 / gDataModel.nRespirationPerMinute));
         break;
 
     default:
@@ -100,9 +251,65 @@ static bool CheckTrigger()
     return trigger;
 }
 
-static bool BeginRespirationCycle()
+static bool BeginRespirationCycle(bool bTimed)
 {
+    uint32_t now = micros();
     gDataModel.nTickRespiration = millis(); // Respiration cycle start tick. Used to compute respiration per minutes
+    ++gDataModel.nRespirationCount;
+
+    if (gDataModel.nTickFirstBreath == 0)
+    {
+        gDataModel.nTickFirstBreath = gDataModel.nTickRespiration;
+    }
+
+    // Ventilation gap of the last error, from the alarm to this respiration
+    if (gSafeties.nTickError != 0)
+    {
+        gSafeties.nRecoveryGap_ms = gDataModel.nTickRespiration - gSafeties.nTickError;
+        if (gSafeties.nRecoveryGap_ms > gSafeties.nRecoveryGapMax_ms)
+        {
+            gSafeties.nRecoveryGapMax_ms = gSafeties.nRecoveryGap_ms;
+        }
+        gSafeties.nTickError = 0;
+    }
+
+    if (bTimed)
+    {
+        // Lateness is measured against the absolute deadline and is not carried over to the next respiration
+        gDataModel.nRespirationLateness_us = (int32_t)(now - gDataModel.nRespirationDeadline_us);
+        if (gDataModel.nRespirationLateness_us > gDataModel.nRespirationLatenessMax_us)
+        {
+            gDataModel.nRespirationLatenessMax_us = gDataModel.nRespirationLateness_us;
+        }
+
+        if (gLastTimedValid)
+        {
+            gDataModel.nRespirationTimingError_us += (int32_t)(now - gLastTimedStart_us) - (int32_t)gDataModel.nRespirationPeriod_us;
+        }
+        gLastTimedStart_us  = now;
+        gLastTimedValid     = true;
+
+        gDataModel.nRespirationDeadline_us += gDataModel.nRespirationPeriod_us;
+
+        // More than a period late (rate increased or loop stalled), resynchronize instead of bursting respirations
+        if ((int32_t)(now - gDataModel.nRespirationDeadline_us) >= 0)
+        {
+            gDataModel.nRespirationDeadline_us = now + gDataModel.nRespirationPeriod_us;
+        }
+    }
+    else
+    {
+        // Patient triggered, backup timed respiration restarts a full period from now
+        gDataModel.nRespirationDeadline_us  = now + gDataModel.nRespirationPeriod_us;
+        gLastTimedValid                     = false;
+    }
+
+    // Breath boundary, new curves from the host take effect now. Corrections learned on old curves no longer apply.
+    if (DataModel_SwapCurves())
+    {
+        FeedForward_Reset();
+    }
+    FeedForward_EndRespiration();
 
     return true;
 }
@@ -114,18 +321,20 @@ static bool EndRespirationCycle()
 
 static bool StartInhaleCycle()
 {
-    if (gDataModel.pInhaleCurve.nCount <= 0)
+    const tPressureCurve* pCurve = &DataModel_GetActiveCurves()->pInhaleCurve;
+    if (pCurve->nCount <= 0)
     {
         return false;
     }
 
     // Make sure exhale valve is closed
-    exhaleValveServo.write(gConfiguration.nServoExhaleCloseAngle);
+    SetExhaleValve(false);
 
     // Start a new inhale cycle
     gDataModel.nCurveIndex              = 0;
     gDataModel.nTickSetPoint            = millis();
-    gDataModel.fRequestPressure_mmH2O   = gDataModel.pInhaleCurve.fSetPoint_mmH2O[0];
+    gDataModel.fRequestPressure_mmH2O   = pCurve->fSetPoint_mmH2O[0];
+    gDataModel.nGainSet                 = pCurve->nGainSet[0];
 
     return true;
 }
@@ -133,21 +342,24 @@ static bool StartInhaleCycle()
 // Inhale cycle set point, returns true when cycle is finished
 static bool Inhale()
 {
+    const tPressureCurve* pCurve = &DataModel_GetActiveCurves()->pInhaleCurve;
+
     // Check for overflow of allowed maximum curve setpoint count
     if (gDataModel.nCurveIndex >= kMaxCurveCount)
     {
         // Raise a safety issue
         gSafeties.bCritical     = true;
-        gDataModel.nCurveIndex  = gDataModel.pInhaleCurve.nCount;
+        gDataModel.nCurveIndex  = pCurve->nCount;
     }
 
-    if (gDataModel.nCurveIndex >= gDataModel.pInhaleCurve.nCount)
+    if (gDataModel.nCurveIndex >= pCurve->nCount)
     {
         return true;
     }
 
-    gDataModel.fRequestPressure_mmH2O = gDataModel.pInhaleCurve.fSetPoint_mmH2O[gDataModel.nCurveIndex];
-    if ((millis() - gDataModel.nTickSetPoint) >= gDataModel.pInhaleCurve.nSetPoint_TickMs[gDataModel.nCurveIndex])
+    gDataModel.fRequestPressure_mmH2O = pCurve->fSetPoint_mmH2O[gDataModel.nCurveIndex];
+    gDataModel.nGainSet               = pCurve->nGainSet[gDataModel.nCurveIndex];
+    if ((millis() - gDataModel.nTickSetPoint) >= pCurve->nSetPoint_TickMs[gDataModel.nCurveIndex])
     {
         gDataModel.nTickSetPoint = millis();
         ++gDataModel.nCurveIndex;
@@ -163,7 +375,8 @@ static bool StopInhaleCycle()
 
 static bool StartExhaleCycle()
 {
-    if (gDataModel.pExhaleCurve.nCount <= 0)
+    const tPressureCurve* pCurve = &DataModel_GetActiveCurves()->pExhaleCurve;
+    if (pCurve->nCount <= 0)
     {
         return false;
     }
@@ -171,30 +384,34 @@ static bool StartExhaleCycle()
     // Start a new inhale cycle
     gDataModel.nCurveIndex              = 0;
     gDataModel.nTickSetPoint            = millis();
-    gDataModel.fRequestPressure_mmH2O   = gDataModel.pExhaleCurve.fSetPoint_mmH2O[0];
+    gDataModel.fRequestPressure_mmH2O   = pCurve->fSetPoint_mmH2O[0];
+    gDataModel.nGainSet                 = pCurve->nGainSet[0];
 
-    exhaleValveServo.write(gConfiguration.nServoExhaleOpenAngle);
+    SetExhaleValve(true);
 
     return true;
 }
 
 static bool Exhale()
 {
+    const tPressureCurve* pCurve = &DataModel_GetActiveCurves()->pExhaleCurve;
+
     // Check for overflow of allowed maximum curve setpoint count
     if (gDataModel.nCurveIndex >= kMaxCurveCount)
     {
         // Raise a safety issue
         gSafeties.bCritical     = true;
-        gDataModel.nCurveIndex  = gDataModel.pExhaleCurve.nCount;
+        gDataModel.nCurveIndex  = pCurve->nCount;
     }
 
-    if (gDataModel.nCurveIndex >= gDataModel.pExhaleCurve.nCount)
+    if (gDataModel.nCurveIndex >= pCurve->nCount)
     {
         return true;
     }
 
-    gDataModel.fRequestPressure_mmH2O = gDataModel.pExhaleCurve.fSetPoint_mmH2O[gDataModel.nCurveIndex];
-    if ((millis() - gDataModel.nTickSetPoint) >= gDataModel.pExhaleCurve.nSetPoint_TickMs[gDataModel.nCurveIndex])
+    gDataModel.fRequestPressure_mmH2O = pCurve->fSetPoint_mmH2O[gDataModel.nCurveIndex];
+    gDataModel.nGainSet               = pCurve->nGainSet[gDataModel.nCurveIndex];
+    if ((millis() - gDataModel.nTickSetPoint) >= pCurve->nSetPoint_TickMs[gDataModel.nCurveIndex])
     {
         gDataModel.nTickSetPoint = millis();
         ++gDataModel.nCurveIndex;
@@ -205,36 +422,39 @@ static bool Exhale()
 
 static bool StopExhaleCycle()
 {
-    exhaleValveServo.write(gConfiguration.nServoExhaleCloseAngle);
+    SetExhaleValve(false);
 
     return true;
 }
 
-static bool ComputeRespirationSetPoint()
+bool Control_ComputeRespirationSetPoint()
 {
     // Process proper part of the respiration cycle: Trigger, Inhale or Exhale
     switch (gDataModel.nCycleState)
     {
     case kCycleState_WaitTrigger:
-        sprintf(gLcdDetail, "Trigger   ");
-        if (CheckTrigger())
         {
-            BeginRespirationCycle();
-            if (StartInhaleCycle())
+            strcpy_P(gLcdDetail, PSTR("Trigger   "));
+            bool bTimed = false;
+            if (CheckTrigger(bTimed))
             {
-                gDataModel.nCycleState = kCycleState_Inhale;
-            }
-            else
-            {
-                // No inhale curve set
-                gSafeties.bCritical = true;
+                BeginRespirationCycle(bTimed);
+                if (StartInhaleCycle())
+                {
+                    gDataModel.nCycleState = kCycleState_Inhale;
+                }
+                else
+                {
+                    // No inhale curve set
+                    gSafeties.bCritical = true;
+                }
             }
         }
         break;
 
     case kCycleState_Inhale:
         {
-            sprintf(gLcdDetail, "Inhale  ");
+            strcpy_P(gLcdDetail, PSTR("Inhale  "));
             bool inhaleFinished = Inhale();
             if (inhaleFinished)
             {
@@ -243,40 +463,42 @@ static bool ComputeRespirationSetPoint()
                 {
                     gDataModel.nCycleState = kCycleState_Exhale;
                 }
-            }
-            else
-            {
-                // No exhale curve set
-                gSafeties.bCritical = true;
+                else
+                {
+                    // No exhale curve set
+                    gSafeties.bCritical = true;
+                }
             }
         }
         break;
 
     case kCycleState_Exhale:
         {
-            sprintf(gLcdDetail, "Exhale   ");
+            strcpy_P(gLcdDetail, PSTR("Exhale   "));
             bool exhaleFinished = Exhale();
             if (exhaleFinished)
             {
                 StopExhaleCycle();
                 EndRespirationCycle();
                 gDataModel.nTickStabilization = millis();
+                gDataModel.nGainSet = kGainSet_Hold;
                 gDataModel.nCycleState = kCycleState_Stabilization;
             }
         }
         break;
 
     case kCycleState_Stabilization:
-        sprintf(gLcdDetail, "Stabil   ");
+        strcpy_P(gLcdDetail, PSTR("Stabil   "));
         // Pressure Stabilization between cycles
         if ((millis() - gDataModel.nTickStabilization) >= kPeriodStabilization)
         {
+            gDataModel.nTickWait   = millis();
             gDataModel.nCycleState = kCycleState_WaitTrigger;
         }
         break;
 
     default:
-        sprintf(gLcdDetail, "N/A   ");
+        strcpy_P(gLcdDetail, PSTR("N/A   "));
         // Invalid setting
         gSafeties.bConfigurationInvalid = true;
         gDataModel.nPWMPump             = 0;
@@ -289,12 +511,48 @@ static bool ComputeRespirationSetPoint()
 
 void Control_Process()
 {
+    // Operator stop is the falling edge of the start flag, an error leaves the flag set
+    bool bOperatorStop = gWasStarted && !gDataModel.bStartFlag;
+    gWasStarted = gDataModel.bStartFlag;
+
     if (!gDataModel.bStartFlag || gDataModel.nState != kState_Process)
     {
         gDataModel.nCycleState = kCycleState_WaitTrigger;
-        exhaleValveServo.write(gConfiguration.nServoExhaleOpenAngle);
+        SetExhaleValve(true);
         gDataModel.nTickRespiration = millis(); // Respiration cycle start tick. Used to compute
-        Timer1.pwm(PIN_OUT_PUMP1_PWM, gDataModel.nPWMPump);
+        uint32_t now = micros();
+        if (gDataModel.nState != kState_Error)
+        {
+            gDataModel.nRespirationDeadline_us = now + gDataModel.nRespirationPeriod_us; // First respiration a period after start
+        }
+        else if ((int32_t)(now - gDataModel.nRespirationDeadline_us) > 0)
+        {
+            // Schedule is kept through an error, a fast recovery starts the overdue respiration at once
+            gDataModel.nRespirationDeadline_us = now;
+        }
+
+        if (gDataModel.nState == kState_Error)
+        {
+            // Pump is off through an error, a resolved alarm resumes from a fresh respiration
+            gDataModel.nPWMPump = 0;
+        }
+
+        // Stopped by the operator, not by an error
+        if (!gDataModel.bStartFlag)
+        {
+            gSafeties.nTickError = 0;
+        }
+        gLastTimedValid = false;
+        gDataModel.nTickWait = millis();
+        FeedForward_Abort();
+        WritePump();
+
+        // Persist pump map learned during ventilation. Only on an operator stop, since the EEPROM writes
+        // block the loop for up to ~100ms and must never delay the response to an error.
+        if (bOperatorStop)
+        {
+            PumpMap_Save();
+        }
         return;
     }
 
@@ -302,8 +560,22 @@ void Control_Process()
     switch (gDataModel.nControlMode)
     {
     case kControlMode_PID:
+        UpdatePressureSlope();
+
+        // Learn pump response from the pwm applied at previous tick
+        if (!gExhaleValveOpen)
+        {
+            PumpMap_Learn(gDataModel.nPWMPump, gDataModel.fPressureFused_mmH2O, gDataModel.fPressureSlope_mmH2O_s);
+        }
+
+        // Learn leak from the PEEP hold after exhale, the command applied at previous tick against the pressure decay
+        if (!gExhaleValveOpen && (gDataModel.nCycleState == kCycleState_Stabilization || gDataModel.nCycleState == kCycleState_WaitTrigger))
+        {
+            Leak_Update(gDataModel.fPI, gDataModel.fPressureFused_mmH2O, gDataModel.fPressureSlope_mmH2O_s);
+        }
+
         // It is assumed that the last pressure setpoint in the exhale curve is kept between respiration
-        if (ComputeRespirationSetPoint())
+        if (Control_ComputeRespirationSetPoint())
         {
             Control_PID();
         }
@@ -321,5 +593,5 @@ void Control_Process()
     };
 
     // Pump power to output
-    Timer1.pwm(PIN_OUT_PUMP1_PWM, gDataModel.nPWMPump);
+    WritePump();
 }
@@ -19,4 +19,16 @@ bool Control_Init();
 /// \brief Process control
 void Control_Process();
 
+/// \fn void Control_PID()
+/// \brief Update pump pwm from pressure error to current set-point
+void Control_PID();
+
+/// \fn bool Control_ComputeRespirationSetPoint()
+/// \brief Advance respiration cycle and compute current pressure set-point
+bool Control_ComputeRespirationSetPoint();
+
+/// \fn void Control_SetRespirationRate(float fRespirationPerMinute)
+/// \brief Set respiration rate and precompute the breath scheduler period
+void Control_SetRespirationRate(float fRespirationPerMinute);
+
 #endif // TLC_CONTROL_H
@@ -12,22 +12,26 @@ bool DataModel_Init()
 {
     memset(&gDataModel, 0, sizeof(tDataModel));
 
-    gDataModel.pInhaleCurve.nCount = 8;
+    tRespirationCurves* pCurves = &gDataModel.pCurves[gDataModel.nActiveCurves];
+
+    pCurves->pInhaleCurve.nCount = 8;
     for (int a = 0; a < 8; ++a)
     {
-        gDataModel.pInhaleCurve.nSetPoint_TickMs[a] = 100;
-        gDataModel.pInhaleCurve.fSetPoint_mmH2O[a]  = 250.0f;
+        pCurves->pInhaleCurve.nSetPoint_TickMs[a] = 100;
+        pCurves->pInhaleCurve.fSetPoint_mmH2O[a]  = 250.0f;
+        pCurves->pInhaleCurve.nGainSet[a]         = (a == 0) ? kGainSet_Rise : kGainSet_Plateau;
     }
 
-    gDataModel.pExhaleCurve.nCount = 8;
+    pCurves->pExhaleCurve.nCount = 8;
     for (int a = 0; a < 8; ++a)
     {
-        gDataModel.pExhaleCurve.nSetPoint_TickMs[a] = 100;
-        gDataModel.pExhaleCurve.fSetPoint_mmH2O[a]  = 80.0f;
+        pCurves->pExhaleCurve.nSetPoint_TickMs[a] = 100;
+        pCurves->pExhaleCurve.fSetPoint_mmH2O[a]  = 80.0f;
+        pCurves->pExhaleCurve.nGainSet[a]         = kGainSet_Exhale;
     }
-    gDataModel.pExhaleCurve.fSetPoint_mmH2O[7]  = 0.0f;
+    pCurves->pExhaleCurve.fSetPoint_mmH2O[7]  = 0.0f;
 
-    gDataModel.nRespirationPerMinute    = 12;
+    gDataModel.fRespirationPerMinute    = 12.0f;
     gDataModel.nControlMode             = kControlMode_PID;
     gDataModel.nTriggerMode             = kTriggerMode_Timed;
 
@@ -43,3 +47,31 @@ bool DataModel_Init()
     return true;
 }
 
+const tRespirationCurves* DataModel_GetActiveCurves()
+{
+    return &gDataModel.pCurves[gDataModel.nActiveCurves];
+}
+
+tRespirationCurves* DataModel_BeginCurvesUpdate()
+{
+    // Cancel pending swap first, so control never swaps in curves being written
+    gDataModel.bCurvesPending = false;
+    return &gDataModel.pCurves[gDataModel.nActiveCurves ^ 1];
+}
+
+void DataModel_CommitCurves()
+{
+    gDataModel.bCurvesPending = true;
+}
+
+bool DataModel_SwapCurves()
+{
+    if (!gDataModel.bCurvesPending)
+    {
+        return false;
+    }
+
+    gDataModel.nActiveCurves ^= 1;
+    gDataModel.bCurvesPending = false;
+    return true;
+}
@@ -17,9 +17,18 @@ struct tPressureCurve
 {
     float           fSetPoint_mmH2O[kMaxCurveCount];    ///> Pressure for every point of the curve
     uint32_t        nSetPoint_TickMs[kMaxCurveCount];   ///> Number of millisecond to execute point of the curve
+    uint8_t         nGainSet[kMaxCurveCount];           ///> PID gain set (eGainSet) for every point of the curve
     uint8_t         nCount;                             ///> Number of active points in the setpoint curve
 };
 
+/// \struct tRespirationCurves
+/// \brief Inhale and exhale curves of a respiration cycle
+struct tRespirationCurves
+{
+    tPressureCurve  pInhaleCurve;                       ///> Inhale curve descriptor
+    tPressureCurve  pExhaleCurve;                       ///> Exhale curve descriptor
+};
+
 /// \struct tDataModel
 /// \brief Describe internal data
 ///
@@ -31,27 +40,36 @@ struct tDataModel
     eState          nState;                 ///> System state
     eControlMode    nControlMode;           ///> Control mode of the pump
     eTriggerMode    nTriggerMode;           ///> Respiration trigger mode
-    uint8_t         nRawPressure[2];        ///> Raw read pressure from sensor
-    float           fBatteryLevel;          ///> Battery voltage level
+    uint16_t        nSensorRaw[kSensor_Count];  ///> Raw reading of every sensor (eSensor), offset removed
+    float           fSensor[kSensor_Count];     ///> Converted reading of every sensor (eSensor), in its units
+    uint8_t         nSensorRangeFlags;          ///> Sensors reading outside their valid range, bit mask of eSensor
+    uint16_t        nRawPressureFused;      ///> Raw pressure estimate from healthy sensors
+    uint16_t        nRawPressureSpread;     ///> Largest difference between healthy pressure sensors, 0xFFFF when none is healthy
+    uint8_t         nSampleCount;           ///> Incremented on every new sensors sample, wraps
 
     eCycleState     nCycleState;            ///> Respiration cycle state
-    tPressureCurve  pInhaleCurve;           ///> Inhale curve descriptor
-    tPressureCurve  pExhaleCurve;           ///> Exhale curve descriptor
+    tRespirationCurves pCurves[2];          ///> Double buffered curves: active one used by control, shadow one filled by parser
+    volatile uint8_t   nActiveCurves;       ///> Index of the active curves in pCurves
+    volatile bool      bCurvesPending;      ///> Shadow curves are complete, swap them in at next respiration cycle
     uint8_t         nCurveIndex;            ///> Current executing curve setpoint index
 
     float           fRequestPressure_mmH2O; ///> Requested pressure set-point
-    uint8_t         nRespirationPerMinute;  ///> Number of respiration per minute
+    uint8_t         nGainSet;               ///> PID gain set (eGainSet) of the current set-point
+    float           fRespirationPerMinute;  ///> Number of respiration per minute, fractional rates allowed
     float           fInhalePressureTarget_mmH2O; ///> Inhale Pressure Target
     float           fExhalePressureTarget_mmH2O; ///> Exhale Pressure Target
     float           fInhaleRatio;           ///> Inhale Ratio
     float           fExhaleRatio;           ///> Exhale Ratio
 
-    float           fPressure_mmH2O[2];     ///> Converted pressure, useable as cmH2O
+    float           fPressureFused_mmH2O;   ///> Pressure estimate from healthy sensors, drives control
+    float           fPressureSlope_mmH2O_s; ///> Filtered pressure derivative, used by patient trigger
     float           fPressureError;         ///> Pressure error: readings vs set-point
     float           fP;                     ///> Control Proportional
     float           fI;                     ///> Control Integral
     float           fD;                     ///> Control Derivative
-    float           fPI;                    ///> Control Sum of Proportional and Integral errors
+    float           fFF;                    ///> Control feed-forward learned from previous respirations
+    float           fLeak;                  ///> Control feed-forward compensating the estimated leak
+    float           fPI;                    ///> Control output, saturated sum of Proportional, Integral, Derivative and feed-forward terms
     uint16_t        nPWMPump;               ///> Pump PWM power output
 
     uint32_t        nTickControl;           ///> Last control tick
@@ -59,9 +77,23 @@ struct tDataModel
     uint32_t        nTickSensors;           ///> Last sensors tick
     uint32_t        nTickSetPoint;          ///> Current curve pressure set-point ticker
     uint32_t        nTickRespiration;       ///> Start of respiration tick
+
+    uint32_t        nRespirationPeriod_us;      ///> Respiration period in microseconds, precomputed from fRespirationPerMinute
+    uint32_t        nRespirationDeadline_us;    ///> Absolute deadline (micros) of next timed respiration
+    uint32_t        nRespirationCount;          ///> Number of respirations since start
+    int32_t         nRespirationLateness_us;    ///> Lateness of last timed respiration vs its deadline
+    int32_t         nRespirationLatenessMax_us; ///> Worst lateness of timed respirations since start
+    int32_t         nRespirationTimingError_us; ///> Accumulated error of timed respiration intervals vs set period
     uint32_t        nTickStabilization;     ///> Stabilization tick between respiration
     uint32_t        nTickWait;              ///> Wait tick after respiration
     uint32_t        nTickLcdKeypad;         ///> Lcd and Keypad update and scan rate
+    uint32_t        nTickWarmRestart;       ///> Last warm restart snapshot tick
+    uint32_t        nTickBuzzer;            ///> Last buzzer pattern slot tick
+
+    uint8_t         nResetFlags;            ///> MCUSR reset cause flags at boot
+    bool            bWarmRestart;           ///> Ventilation settings restored from the warm restart snapshot at boot
+    uint32_t        nTickWarmupDone;        ///> Tick of the end of the first warmup since boot, 0 until then
+    uint32_t        nTickFirstBreath;       ///> Tick of the first respiration since boot, 0 until then
 };
 
 extern tDataModel gDataModel;
@@ -70,4 +102,20 @@ extern tDataModel gDataModel;
 /// \brief Initialize datamodel defaults
 bool DataModel_Init();
 
+/// \fn const tRespirationCurves* DataModel_GetActiveCurves()
+/// \brief Curves currently executed by control
+const tRespirationCurves* DataModel_GetActiveCurves();
+
+/// \fn tRespirationCurves* DataModel_BeginCurvesUpdate()
+/// \brief Get the shadow curves to fill, cancels any pending swap
+tRespirationCurves* DataModel_BeginCurvesUpdate();
+
+/// \fn void DataModel_CommitCurves()
+/// \brief Mark the shadow curves complete, control swaps them in at next respiration cycle
+void DataModel_CommitCurves();
+
+/// \fn bool DataModel_SwapCurves()
+/// \brief Swap the shadow curves in if committed, returns true if swapped. Called by control at a breath boundary
+bool DataModel_SwapCurves();
+
 #endif // TLC_DATAMODEL_H
@@ -6,6 +6,19 @@
 #ifndef TLC_DEFS_H
 #define TLC_DEFS_H
 
+// Test-only fault injector scripted through the serial port (FIJ/FIR commands), never enable in a therapy build
+#ifndef FAULT_INJECTION
+#define FAULT_INJECTION     0
+#endif
+
+// Test-only replay of recorded ADC samples in place of the ADC (REC 2, RPS commands), never enable in a therapy build
+#ifndef RECORDER_REPLAY
+#define RECORDER_REPLAY     0
+#endif
+
+// Test-only micro-benchmarks of hot paths (BEN command)
+#define BENCHMARK           0
+
 // Force error check at compile time for constants
 #define HXCOMPILATIONASSERT(name, x) typedef char name[x ? 1 : -1]
 
@@ -17,20 +30,31 @@ enum eConsts
     kSerialRxTimeOut            = 10,       ///> Maximum wait time in ms to wait for serial data
     kRxBufferSize               = 250,      ///> Maximum rx buffer size
     kRxBufferReserve            = 10,       ///> Reserve of data before we start discarding rx buffer
+    kLcdLineSize                = 17,       ///> Lcd line of 16 characters and terminator
     kSerialDiscardTimeout       = 500,      ///> Discard rx buffer timeout
     kPeriodCommPublish          = 500,      ///> Period to send status information to controller
     kPeriodControl              = 5,        ///> Period to call control loop in milliseconds
     kPeriodCommunications       = 2,        ///> Period to call communications loop in milliseconds
     kPeriodLcdKeypad            = 250,      ///> Period to refresh Lcd and scan keypad in milliseconds
     kPeriodSensors              = 5,        ///> Period to call sensors loop in milliseconds
-    kPeriodWarmup               = 1000,     ///> Period to warmup the system in milliseconds
+    kPeriodPumpPWM_us           = 4000,     ///> Period of the pump PWM (Timer1) in microseconds
+    kPeriodWarmup               = 1000,     ///> Maximum period to warmup the system in milliseconds
+    kPeriodWarmupMin            = 200,      ///> Minimum period to warmup the system, then leave as soon as sensors are stable
+    kPeriodBuzzer               = 100,      ///> Period of buzzer pattern slots in milliseconds
+    kPeriodWarmRestart          = 100,      ///> Period to snapshot ventilation state for a warm restart in milliseconds
     kPeriodStabilization        = 100,      ///> Stablization period between respiration cycles
-    kEEPROM_Version             = 1,        ///> EEPROM version must match this version for compatibility
+    kEEPROM_Version             = 7,        ///> EEPROM version must match this version for compatibility
     kMaxCurveCount              = 8,       ///> Maximum respiration curve index count
+    kEEPROM_PumpMapOffset       = 512,      ///> EEPROM offset of the pump map, after the configuration
+    kAlarmCount                 = 7,        ///> Number of eAlarm bits
+    kPressureChannelCount       = 2,        ///> Redundant pressure sensors fused for control, 2 or 3
+    kCalibrationPointCount      = 8,        ///> Maximum calibration points of a pressure sensor
 };
 
 HXCOMPILATIONASSERT(assertSensorPeriodCheck, (kPeriodSensors >= 1));
+HXCOMPILATIONASSERT(assertWarmupPeriodCheck, (kPeriodWarmupMin <= kPeriodWarmup));
 HXCOMPILATIONASSERT(assertRXBufferSizeCheck, (kRxBufferSize < 255));
+HXCOMPILATIONASSERT(assertPressureChannelCountCheck, (kPressureChannelCount >= 2 && kPressureChannelCount <= 3));
 
 /// \enum eState
 /// \brief System state
@@ -57,6 +81,18 @@ enum eCycleState
     kCycleState_Count
 };
 
+/// \enum eGainSet
+/// \brief PID gain set, selected by respiration cycle state and curve segment
+enum eGainSet
+{
+    kGainSet_Hold = 0,      ///> Pressure hold between respirations, exhale valve closed
+    kGainSet_Rise,          ///> Inhale pressure rise
+    kGainSet_Plateau,       ///> Inhale pressure plateau
+    kGainSet_Exhale,        ///> Exhale, exhale valve open
+
+    kGainSet_Count
+};
+
 /// \enum eControlMode
 /// \brief Pump pressure control mode
 enum eControlMode
@@ -87,8 +123,27 @@ enum eAlarm
     kAlarm_PressureSensorRedudancyFail  = (1<<2),   ///> Both pressure sensors report different readings
     kAlarm_InvalidConfiguration         = (1<<3),   ///> Loaded configuration is invalid
     kAlarm_BatteryLow                   = (1<<4),   ///> Low battery voltage
+    kAlarm_SensorRange                  = (1<<5),   ///> A sensor reads outside its physical span: open, shorted or saturated
+    kAlarm_PressureRedundancyLost       = (1<<6),   ///> A pressure sensor is voted out, ventilation goes on without redundancy
 };
 
+HXCOMPILATIONASSERT(assertAlarmCountCheck, (kAlarm_PressureRedundancyLost == (1 << (kAlarmCount - 1))));
+
+/// \enum eSensor
+/// \brief Registered analog sensors, described in sensors.cpp. Adding one needs its pin and a descriptor.
+enum eSensor
+{
+    kSensor_Pressure0 = 0,  ///> MPX pressure sensor
+    kSensor_Pressure1,      ///> MPX redundant pressure sensor
+    kSensor_Battery,        ///> Battery voltage
+
+    kSensor_Count
+};
+
+// Pressure sensors come first, fused for control
+HXCOMPILATIONASSERT(assertSensorOrderCheck, (kSensor_Pressure0 == 0 && static_cast<int>(kSensor_Battery) == kPressureChannelCount));
+HXCOMPILATIONASSERT(assertSensorCountCheck, (kSensor_Count <= 8));
+
 const float kMPX5010_MaxPressure_mmH2O          = 1019.78f;
 const float kMPX5010_MaxPressureDelta_mmH2O     = 40.0f;
 const float kMPX5010_Accuracy                   = 0.5f;
@@ -0,0 +1,213 @@
+///
+/// \file       faultinjection.cpp
+/// \brief      The Lung Carburetor Firmware fault injection module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    faultinjection
+#include "faultinjection.h"
+
+#if FAULT_INJECTION
+#include "datamodel.h"
+#include <EEPROM.h>
+
+tFaultInjection gFaultInjection;
+
+static uint16_t gRandom = 0xACE1;   // Deterministic pseudo random sequence, sessions are reproducible
+
+// 16 bits xorshift
+static uint16_t Random()
+{
+    gRandom ^= gRandom << 7;
+    gRandom ^= gRandom >> 9;
+    gRandom ^= gRandom << 8;
+    return gRandom;
+}
+
+bool FaultInjection_Inject(uint8_t nFault, uint16_t nTarget, int32_t nValue)
+{
+    if (nFault >= kFault_Count)
+    {
+        return false;
+    }
+
+    if ((nFault == kFault_AdcStuck || nFault == kFault_AdcOffset || nFault == kFault_AdcNoise || nFault == kFault_AdcDrift) && nTarget >= 3)
+    {
+        return false;
+    }
+
+    switch (nFault)
+    {
+    case kFault_None:
+        memset(&gFaultInjection, 0, sizeof(tFaultInjection));
+        gRandom = 0xACE1;
+        return true;
+
+    case kFault_AdcStuck:
+        gFaultInjection.nAdcStuck[nTarget]  = (uint16_t)constrain(nValue, 0L, 1023L);
+        gFaultInjection.nAdcMask[nTarget]  |= (1 << kFault_AdcStuck);
+        break;
+
+    case kFault_AdcOffset:
+        gFaultInjection.nAdcOffset[nTarget] = (int16_t)constrain(nValue, -1023L, 1023L);
+        gFaultInjection.nAdcMask[nTarget]  |= (1 << kFault_AdcOffset);
+        break;
+
+    case kFault_AdcNoise:
+        gFaultInjection.nAdcNoise[nTarget]  = (uint16_t)constrain(nValue, 0L, 1023L);
+        gFaultInjection.nAdcMask[nTarget]  |= (1 << kFault_AdcNoise);
+        break;
+
+    case kFault_AdcDrift:
+        gFaultInjection.nAdcDrift[nTarget]  = nValue;
+        gFaultInjection.nTickDrift[nTarget] = millis();
+        gFaultInjection.nAdcMask[nTarget]  |= (1 << kFault_AdcDrift);
+        break;
+
+    case kFault_ServoStuck:
+        break;
+
+    case kFault_PumpSaturation:
+        gFaultInjection.nPumpMax        = (uint16_t)constrain(nValue, 0L, 1023L);
+        break;
+
+    case kFault_SerialDrop:
+        gFaultInjection.nSerialDrop     = (uint8_t)constrain(nValue, 0L, 255L);
+        break;
+
+    case kFault_SerialCorrupt:
+        gFaultInjection.nSerialCorrupt  = (uint8_t)constrain(nValue, 0L, 255L);
+        break;
+
+    case kFault_EEPROMBitFlip:
+        if (nTarget >= 1024 || nValue < 0 || nValue > 7)
+        {
+            return false;
+        }
+        EEPROM.write(nTarget, EEPROM.read(nTarget) ^ (1 << nValue));
+        break;
+
+    case kFault_LoopStall:
+        gFaultInjection.nStall_ms       = (uint16_t)constrain(nValue, 0L, 65535L);
+        break;
+
+    default:
+        return false;
+    };
+
+    if (nFault != kFault_EEPROMBitFlip && nFault != kFault_LoopStall)
+    {
+        gFaultInjection.nActive |= (1 << nFault);
+    }
+
+    gFaultInjection.nLastFault      = nFault;
+    gFaultInjection.nTickInjected   = millis();
+    gFaultInjection.nFlagsInjected  = gDataModel.nSafetyFlags;
+    gFaultInjection.nTickFlagged    = 0;
+    gFaultInjection.nFlags          = 0;
+    gFaultInjection.nTickError      = 0;
+
+    return true;
+}
+
+bool FaultInjection_IsActive(uint8_t nFault)
+{
+    return (gFaultInjection.nActive & (1 << nFault)) != 0;
+}
+
+uint16_t FaultInjection_Adc(uint8_t nChannel, uint16_t nRaw)
+{
+    uint16_t mask = gFaultInjection.nAdcMask[nChannel];
+    if (mask == 0)
+    {
+        return nRaw;
+    }
+
+    int16_t value = nRaw;
+    if (mask & (1 << kFault_AdcStuck))
+    {
+        value = gFaultInjection.nAdcStuck[nChannel];
+    }
+    if (mask & (1 << kFault_AdcOffset))
+    {
+        value += gFaultInjection.nAdcOffset[nChannel];
+    }
+    if (mask & (1 << kFault_AdcDrift))
+    {
+        float elapsed = (float)(millis() - gFaultInjection.nTickDrift[nChannel]);
+        value += (int16_t)constrain(gFaultInjection.nAdcDrift[nChannel] * elapsed * 1e-6f, -1023.0f, 1023.0f);
+    }
+    if ((mask & (1 << kFault_AdcNoise)) && gFaultInjection.nAdcNoise[nChannel] > 0)
+    {
+        uint16_t amplitude = gFaultInjection.nAdcNoise[nChannel];
+        value += (int16_t)(Random() % (2 * amplitude + 1)) - (int16_t)amplitude;
+    }
+
+    return (uint16_t)constrain(value, (int16_t)0, (int16_t)1023);
+}
+
+uint16_t FaultInjection_Pump(uint16_t nPWM)
+{
+    if (FaultInjection_IsActive(kFault_PumpSaturation) && nPWM > gFaultInjection.nPumpMax)
+    {
+        return gFaultInjection.nPumpMax;
+    }
+    return nPWM;
+}
+
+int FaultInjection_Serial(uint8_t* pData, int nCount)
+{
+    bool drop    = FaultInjection_IsActive(kFault_SerialDrop);
+    bool corrupt = FaultInjection_IsActive(kFault_SerialCorrupt);
+    if (!drop && !corrupt)
+    {
+        return nCount;
+    }
+
+    int kept = 0;
+    for (int a = 0; a < nCount; ++a)
+    {
+        if (drop && (uint8_t)Random() < gFaultInjection.nSerialDrop)
+        {
+            continue;
+        }
+
+        uint8_t data = pData[a];
+        if (corrupt && (uint8_t)Random() < gFaultInjection.nSerialCorrupt)
+        {
+            data ^= (1 << (Random() & 0x07));
+        }
+        pData[kept++] = data;
+    }
+
+    return kept;
+}
+
+void FaultInjection_Process()
+{
+    if (gFaultInjection.nStall_ms > 0)
+    {
+        uint16_t stall = gFaultInjection.nStall_ms;
+        gFaultInjection.nStall_ms = 0;
+        delay(stall);
+    }
+
+    if (gFaultInjection.nTickInjected == 0)
+    {
+        return;
+    }
+
+    // Only flags raised after the injection, a flag already up when injecting wasn't caused by it
+    uint16_t raised = gDataModel.nSafetyFlags & ~gFaultInjection.nFlagsInjected;
+    if (gFaultInjection.nTickFlagged == 0 && raised != 0)
+    {
+        gFaultInjection.nTickFlagged    = millis();
+        gFaultInjection.nFlags          = raised;
+    }
+
+    if (gFaultInjection.nTickError == 0 && gDataModel.nState == kState_Error)
+    {
+        gFaultInjection.nTickError      = millis();
+    }
+}
+
+#endif // FAULT_INJECTION
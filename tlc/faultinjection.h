@@ -0,0 +1,88 @@
+///
+/// \file       faultinjection.h
+/// \brief      The Lung Carburetor Firmware fault injection module
+///
+/// Test-only fault injector, scripted through the serial port. Every injection is timestamped, with the
+/// tick of the first safety flag and of the first error state that follow, to measure detection latency.
+/// Only built when FAULT_INJECTION is enabled in defs.h, never in a therapy build.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   faultinjection Fault injection
+#ifndef TLC_FAULTINJECTION_H
+#define TLC_FAULTINJECTION_H
+
+#include "common.h"
+
+#if FAULT_INJECTION
+
+/// \enum eFault
+/// \brief Injectable faults
+enum eFault
+{
+    kFault_None = 0,        ///> Clear all faults
+    kFault_AdcStuck,        ///> ADC channel reads a constant value
+    kFault_AdcOffset,       ///> ADC channel reads with an offset in counts
+    kFault_AdcNoise,        ///> ADC channel reads with uniform noise of given amplitude in counts
+    kFault_ServoStuck,      ///> Exhale valve servo ignores commands
+    kFault_PumpSaturation,  ///> Pump pwm saturates at given value
+    kFault_SerialDrop,      ///> Received serial bytes dropped with given probability (/256)
+    kFault_SerialCorrupt,   ///> Received serial bytes get a bit flipped with given probability (/256)
+    kFault_EEPROMBitFlip,   ///> Flip given bit of given EEPROM byte, one shot
+    kFault_LoopStall,       ///> Stall main loop for given milliseconds, one shot
+    kFault_AdcDrift,        ///> ADC channel reads with an offset growing by given counts per 1000 seconds
+
+    kFault_Count
+};
+
+/// \struct tFaultInjection
+/// \brief Active faults and detection timestamps
+struct tFaultInjection
+{
+    uint16_t    nActive;                ///> Bitmask of active faults, (1 << eFault)
+    uint16_t    nAdcStuck[3];           ///> Stuck value per ADC channel: pressure 0, pressure 1, battery
+    int16_t     nAdcOffset[3];          ///> Offset per ADC channel
+    uint16_t    nAdcNoise[3];           ///> Noise amplitude per ADC channel
+    int32_t     nAdcDrift[3];           ///> Drift rate per ADC channel, counts per 1000 seconds
+    uint32_t    nTickDrift[3];          ///> Tick of drift onset per ADC channel
+    uint16_t    nAdcMask[3];            ///> Bitmask of ADC faults active per channel, (1 << eFault)
+    uint16_t    nPumpMax;               ///> Pump pwm saturation
+    uint8_t     nSerialDrop;            ///> Serial byte drop probability /256
+    uint8_t     nSerialCorrupt;         ///> Serial byte corruption probability /256
+    uint16_t    nStall_ms;              ///> Pending loop stall
+
+    uint8_t     nLastFault;             ///> Last injected eFault
+    uint32_t    nTickInjected;          ///> Tick of last injection
+    uint16_t    nFlagsInjected;         ///> Safety flags already raised at nTickInjected
+    uint32_t    nTickFlagged;           ///> Tick of first safety flag raised after last injection, 0 if none yet
+    uint16_t    nFlags;                 ///> Safety flags raised after last injection, at nTickFlagged
+    uint32_t    nTickError;             ///> Tick of first error state after last injection, 0 if none yet
+};
+extern tFaultInjection gFaultInjection;
+
+/// \fn bool FaultInjection_Inject(uint8_t nFault, uint16_t nTarget, int32_t nValue)
+/// \brief Inject a fault, nTarget is the ADC channel or EEPROM address, returns false if invalid
+bool FaultInjection_Inject(uint8_t nFault, uint16_t nTarget, int32_t nValue);
+
+/// \fn bool FaultInjection_IsActive(uint8_t nFault)
+/// \brief Returns true if fault is active
+bool FaultInjection_IsActive(uint8_t nFault);
+
+/// \fn uint16_t FaultInjection_Adc(uint8_t nChannel, uint16_t nRaw)
+/// \brief Apply ADC faults to a raw sample
+uint16_t FaultInjection_Adc(uint8_t nChannel, uint16_t nRaw);
+
+/// \fn uint16_t FaultInjection_Pump(uint16_t nPWM)
+/// \brief Apply pump faults to a pwm command
+uint16_t FaultInjection_Pump(uint16_t nPWM);
+
+/// \fn int FaultInjection_Serial(uint8_t* pData, int nCount)
+/// \brief Apply serial faults to received bytes in place, returns the number of bytes kept
+int FaultInjection_Serial(uint8_t* pData, int nCount);
+
+/// \fn void FaultInjection_Process()
+/// \brief Run one shot faults and timestamp detection, called from main loop
+void FaultInjection_Process();
+
+#endif // FAULT_INJECTION
+
+#endif // TLC_FAULTINJECTION_H
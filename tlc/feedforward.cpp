@@ -0,0 +1,129 @@
+///
+/// \file       feedforward.cpp
+/// \brief      The Lung Carburetor Firmware feed-forward module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    feedforward
+#include "feedforward.h"
+#include "configuration.h"
+
+/// \enum eFeedForwardConsts
+/// \brief Feed-forward table constants
+enum eFeedForwardConsts
+{
+    kFeedForwardBinCount        = 50,   ///> Number of learned bins over a respiration, last bin extends to the end
+    kFeedForwardBinPeriod_ms    = 100,  ///> Duration of a bin, several control ticks to fit in SRAM
+    kFeedForwardLead            = 1,    ///> Bins of phase lead, compensates pump and pressure sensing delay
+    kFeedForwardMaxError_mmH2O  = 1000, ///> Error clamp before accumulation
+};
+
+HXCOMPILATIONASSERT(assertFeedForwardBinCheck, (kFeedForwardBinPeriod_ms % kPeriodControl == 0));
+HXCOMPILATIONASSERT(assertFeedForwardSumCheck, ((kFeedForwardBinPeriod_ms / kPeriodControl) * kFeedForwardMaxError_mmH2O <= 32767));
+
+/// \struct tFeedForward
+/// \brief Iterative learning table
+struct tFeedForward
+{
+    int16_t     nCorrection[kFeedForwardBinCount];  ///> Learned pwm correction of every bin
+    int16_t     nErrorSum[kFeedForwardBinCount];    ///> Sum of pressure errors of current respiration, mmH2O
+    uint16_t    nLastBinCount;                      ///> Number of errors summed in the last bin, it extends to the next trigger
+    bool        bRecording;                         ///> Error sums hold the current respiration since its start
+};
+static tFeedForward gFeedForward;
+
+static inline uint8_t GetBin(uint32_t nTick)
+{
+    uint32_t bin = nTick / kFeedForwardBinPeriod_ms;
+    return (bin < kFeedForwardBinCount) ? (uint8_t)bin : (kFeedForwardBinCount - 1);
+}
+
+bool FeedForward_Init()
+{
+    FeedForward_Reset();
+    return true;
+}
+
+void FeedForward_Reset()
+{
+    memset(&gFeedForward, 0, sizeof(tFeedForward));
+}
+
+void FeedForward_Abort()
+{
+    gFeedForward.bRecording = false;
+}
+
+void FeedForward_EndRespiration()
+{
+    if (gFeedForward.bRecording && gConfiguration.fFeedForwardGain > 0.0f)
+    {
+        const float gainBin  = gConfiguration.fFeedForwardGain * (1.0f / (kFeedForwardBinPeriod_ms / kPeriodControl));
+        const float gainLast = (gFeedForward.nLastBinCount > 0) ? (gConfiguration.fFeedForwardGain / gFeedForward.nLastBinCount) : 0.0f;
+        const float limit    = gConfiguration.fPILimit;
+
+        for (uint8_t a = 0; a < kFeedForwardBinCount; ++a)
+        {
+            // Error later in the respiration is corrected earlier, the pump needs time to act
+            uint8_t lead = (a + kFeedForwardLead < kFeedForwardBinCount) ? (a + kFeedForwardLead) : a;
+            float   gain = (lead == kFeedForwardBinCount - 1) ? gainLast : gainBin;
+
+            float correction = gConfiguration.fFeedForwardForget * gFeedForward.nCorrection[a] + gain * gFeedForward.nErrorSum[lead];
+            if (correction > limit)
+            {
+                correction = limit;
+            }
+            else if (correction < -limit)
+            {
+                correction = -limit;
+            }
+            gFeedForward.nCorrection[a] = (int16_t)correction;
+        }
+    }
+
+    else if (gConfiguration.fFeedForwardGain <= 0.0f)
+    {
+        // Learning disabled, drop corrections learned before
+        memset(gFeedForward.nCorrection, 0, sizeof(gFeedForward.nCorrection));
+    }
+
+    memset(gFeedForward.nErrorSum, 0, sizeof(gFeedForward.nErrorSum));
+    gFeedForward.nLastBinCount  = 0;
+    gFeedForward.bRecording     = true;
+}
+
+void FeedForward_Record(uint32_t nTick, float fError)
+{
+    if (!gFeedForward.bRecording)
+    {
+        return;
+    }
+
+    if (fError > kFeedForwardMaxError_mmH2O)
+    {
+        fError = kFeedForwardMaxError_mmH2O;
+    }
+    else if (fError < -kFeedForwardMaxError_mmH2O)
+    {
+        fError = -kFeedForwardMaxError_mmH2O;
+    }
+
+    uint8_t bin = GetBin(nTick);
+    if (bin == kFeedForwardBinCount - 1)
+    {
+        if (gFeedForward.nLastBinCount == 0xFFFF)
+        {
+            return;
+        }
+        ++gFeedForward.nLastBinCount;
+    }
+
+    // Saturating sum, the last bin keeps accumulating while waiting for the next trigger
+    int16_t& sum = gFeedForward.nErrorSum[bin];
+    int32_t  acc = (int32_t)sum + (int16_t)fError;
+    sum = (acc > 32767) ? 32767 : ((acc < -32767) ? -32767 : (int16_t)acc);
+}
+
+float FeedForward_Get(uint32_t nTick)
+{
+    return gFeedForward.nCorrection[GetBin(nTick)];
+}
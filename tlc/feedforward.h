@@ -0,0 +1,39 @@
+///
+/// \file       feedforward.h
+/// \brief      The Lung Carburetor Firmware feed-forward module
+///
+/// Iterative learning feed-forward: respirations are repetitive, so the pressure error of a
+/// respiration is learned into a pump pwm correction applied at the same time of the next one.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   feedforward Feed-forward
+#ifndef TLC_FEEDFORWARD_H
+#define TLC_FEEDFORWARD_H
+
+#include "common.h"
+
+/// \fn bool FeedForward_Init()
+/// \brief Initialize feed-forward module
+bool FeedForward_Init();
+
+/// \fn void FeedForward_Reset()
+/// \brief Forget learned corrections, used when the respiration curves change
+void FeedForward_Reset();
+
+/// \fn void FeedForward_Abort()
+/// \brief Discard errors recorded for the current respiration, used when respiration stops
+void FeedForward_Abort();
+
+/// \fn void FeedForward_EndRespiration()
+/// \brief Learn the errors of the respiration that just ended and start recording a new one
+void FeedForward_EndRespiration();
+
+/// \fn void FeedForward_Record(uint32_t nTick, float fError)
+/// \brief Record pressure error at nTick milliseconds from the start of the respiration
+void FeedForward_Record(uint32_t nTick, float fError);
+
+/// \fn float FeedForward_Get(uint32_t nTick)
+/// \brief Learned pwm correction at nTick milliseconds from the start of the respiration
+float FeedForward_Get(uint32_t nTick);
+
+#endif // TLC_FEEDFORWARD_H
@@ -11,10 +11,7 @@
 // Set ports direction
 bool GPIO_Init()
 {
-    // Configure pins from defs.h
-    pinMode(PIN_PRESSURE0, INPUT);
-    pinMode(PIN_PRESSURE1, INPUT);
-    pinMode(PIN_BATTERY,   INPUT);
+    // Sensor pins are configured by Sensors_Init from its registry
 
     exhaleValveServo.attach(PIN_OUT_SERVO_EXHALE);
 
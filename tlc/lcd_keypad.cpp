@@ -24,8 +24,8 @@ Adafruit_RGBLCDShield lcd = Adafruit_RGBLCDShield();
 #define VIOLET 0x5
 #define WHITE 0x7
 
-char gLcdMsg[128];
-char gLcdDetail[128];
+char gLcdMsg[kLcdLineSize];
+char gLcdDetail[kLcdLineSize];
 
 bool LcdKeypad_Init()
 {
@@ -56,27 +56,27 @@ void LcdKeypad_Process()
         lcd.setCursor(0,0);
         if (buttons & BUTTON_UP)
         {
-          lcd.print("UP ");
+          lcd.print(F("UP "));
           lcd.setBacklight(RED);
         }
         if (buttons & BUTTON_DOWN)
         {
-          lcd.print("DOWN ");
+          lcd.print(F("DOWN "));
           lcd.setBacklight(YELLOW);
         }
         if (buttons & BUTTON_LEFT)
         {
-          lcd.print("LEFT ");
+          lcd.print(F("LEFT "));
           lcd.setBacklight(GREEN);
         }
         if (buttons & BUTTON_RIGHT)
         {
-          lcd.print("RIGHT ");
+          lcd.print(F("RIGHT "));
           lcd.setBacklight(TEAL);
         }
         if (buttons & BUTTON_SELECT)
         {
-          lcd.print("SELECT ");
+          lcd.print(F("SELECT "));
           lcd.setBacklight(VIOLET);
         }
     }
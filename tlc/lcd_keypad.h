@@ -7,8 +7,10 @@
 #ifndef TLC_LCD_KEYPAD_H
 #define TLC_LCD_KEYPAD_H
 
-extern char gLcdMsg[128];
-extern char gLcdDetail[128];
+#include "defs.h"
+
+extern char gLcdMsg[kLcdLineSize];
+extern char gLcdDetail[kLcdLineSize];
 
 /// \fn bool LcdKeypad_Init()
 /// \brief Initialize lcd and keypad
@@ -0,0 +1,80 @@
+///
+/// \file       leak.cpp
+/// \brief      The Lung Carburetor Firmware leak estimation module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    leak
+#include "leak.h"
+#include "configuration.h"
+
+tLeakEstimator gLeakEstimator;
+
+const float kLeakForget             = 0.995f;   // Forgetting factor, ~1s memory at kPeriodControl
+const float kLeakInitialCovariance  = 1.0f;     // Initial parameters covariance, low confidence
+const float kLeakMaxCovariance      = 10.0f;    // Forgetting stops above this covariance trace, avoids windup without excitation
+const float kLeakMinGain            = 0.01f;    // Below, gain is not identified and no compensation is applied
+
+/// \enum eLeakConsts
+/// \brief Leak estimation constants
+enum eLeakConsts
+{
+    kLeakMinSamples     = 100,  ///> Samples before compensation is applied, 500ms at kPeriodControl
+};
+
+void Leak_Init()
+{
+    memset(&gLeakEstimator, 0, sizeof(tLeakEstimator));
+    gLeakEstimator.fCovariance[0] = kLeakInitialCovariance;
+    gLeakEstimator.fCovariance[2] = kLeakInitialCovariance;
+}
+
+void Leak_Update(float fCommand, float fPressure_mmH2O, float fSlope_mmH2O_s)
+{
+    float* c = gLeakEstimator.fCovariance;
+
+    // Regressors: command and negated pressure
+    float u  = fCommand;
+    float p  = -fPressure_mmH2O;
+
+    float cu = c[0] * u + c[1] * p;
+    float cp = c[1] * u + c[2] * p;
+    float denominator = kLeakForget + u * cu + p * cp;
+    if (denominator <= 0.0f)
+    {
+        return;
+    }
+
+    float ku    = cu / denominator;
+    float kp    = cp / denominator;
+    float error = fSlope_mmH2O_s - (gLeakEstimator.fGain * u + gLeakEstimator.fLeak * p);
+
+    gLeakEstimator.fGain += ku * error;
+    gLeakEstimator.fLeak += kp * error;
+
+    c[0] -= ku * cu;
+    c[1] -= ku * cp;
+    c[2] -= kp * cp;
+    if (c[0] + c[2] < kLeakMaxCovariance)
+    {
+        float forget = 1.0f / kLeakForget;
+        c[0] *= forget;
+        c[1] *= forget;
+        c[2] *= forget;
+    }
+
+    if (gLeakEstimator.nSamples < 0xFFFF)
+    {
+        ++gLeakEstimator.nSamples;
+    }
+}
+
+float Leak_GetCompensation(float fSetPoint_mmH2O)
+{
+    if (gLeakEstimator.nSamples < kLeakMinSamples || gLeakEstimator.fGain < kLeakMinGain || gLeakEstimator.fLeak <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    float compensation = gLeakEstimator.fLeak / gLeakEstimator.fGain * fSetPoint_mmH2O;
+    return constrain(compensation, 0.0f, gConfiguration.fPILimit);
+}
@@ -0,0 +1,42 @@
+///
+/// \file       leak.h
+/// \brief      The Lung Carburetor Firmware leak estimation module
+///
+/// Online leak estimation while pressure is held with the exhale valve closed. Pressure is modelled as
+///     dP/dt = gain * command - leak * P
+/// and both parameters are estimated by recursive least squares with forgetting. The command that balances
+/// the leak at a set-point, leak / gain * P, is added to the controller output as a feed-forward term, so the
+/// integral term no longer has to hold it.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   leak Leak estimation
+#ifndef TLC_LEAK_H
+#define TLC_LEAK_H
+
+#include "common.h"
+
+/// \struct tLeakEstimator
+/// \brief Leak model parameters and least squares state
+struct tLeakEstimator
+{
+    float       fGain;              ///> Pressure slope per unit of command, mmH2O/s
+    float       fLeak;              ///> Pressure decay rate, 1/s
+    float       fCovariance[3];     ///> Parameters covariance: gain, gain-leak, leak
+    uint16_t    nSamples;           ///> Samples since reset, saturates
+};
+extern tLeakEstimator gLeakEstimator;
+
+/// \fn void Leak_Init()
+/// \brief Initialize leak estimation, no leak known
+void Leak_Init();
+
+/// \fn void Leak_Update(float fCommand, float fPressure_mmH2O, float fSlope_mmH2O_s)
+/// \brief Update estimate from the command applied at previous control tick and the resulting pressure and slope.
+/// Only call while the exhale valve is closed.
+void Leak_Update(float fCommand, float fPressure_mmH2O, float fSlope_mmH2O_s);
+
+/// \fn float Leak_GetCompensation(float fSetPoint_mmH2O)
+/// \brief Command balancing the estimated leak at a set-point, 0 until the estimate is usable
+float Leak_GetCompensation(float fSetPoint_mmH2O);
+
+#endif // TLC_LEAK_H
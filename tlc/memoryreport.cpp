@@ -0,0 +1,60 @@
+///
+/// \file       memoryreport.cpp
+/// \brief      The Lung Carburetor Firmware memory report module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    memoryreport
+#include "memoryreport.h"
+
+// Linker symbols, heap starts after .bss and grows up to __brkval, the stack grows down from RAMEND
+extern uint8_t __data_start;
+extern uint8_t __heap_start;
+extern "C" { extern void* __brkval; }
+
+/// \enum eMemoryConsts
+/// \brief Memory report constants
+enum eMemoryConsts
+{
+    kMemoryPaint        = 0xC5, ///> Free RAM fill pattern
+    kMemoryPaintMargin  = 16,   ///> Bytes left unpainted below the stack pointer of the painting call
+};
+
+// Lowest address the stack may reach, end of the heap
+static inline uint8_t* HeapEnd()
+{
+    return (__brkval != nullptr) ? static_cast<uint8_t*>(__brkval) : &__heap_start;
+}
+
+// Addresses of distinct objects are compared as integers, pointer arithmetic across them is undefined
+static inline uintptr_t Address(const void* p)
+{
+    return reinterpret_cast<uintptr_t>(p);
+}
+
+void MemoryReport_Init()
+{
+    uint8_t  top;
+    uint8_t* p = HeapEnd();
+
+    // Local variable address is the stack pointer of this call
+    uintptr_t end = Address(&top) - kMemoryPaintMargin;
+    while (Address(p) < end)
+    {
+        *p++ = kMemoryPaint;
+    }
+}
+
+void MemoryReport_Get(tMemoryReport& report)
+{
+    uint8_t  top;
+    uint8_t* p = HeapEnd();
+
+    report.nStatic  = Address(&__heap_start) - Address(&__data_start);
+    report.nFree    = Address(&top) - Address(p);
+
+    while (Address(p) < Address(&top) && *p == kMemoryPaint)
+    {
+        ++p;
+    }
+    report.nStackUnused = Address(p) - Address(HeapEnd());
+}
@@ -0,0 +1,32 @@
+///
+/// \file       memoryreport.h
+/// \brief      The Lung Carburetor Firmware memory report module
+///
+/// Static RAM usage, free RAM and stack high-water mark, found by painting the free RAM at boot
+/// and looking for the deepest byte the stack overwrote since.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   memoryreport Memory report
+#ifndef TLC_MEMORYREPORT_H
+#define TLC_MEMORYREPORT_H
+
+#include "common.h"
+
+/// \struct tMemoryReport
+/// \brief RAM usage in bytes
+struct tMemoryReport
+{
+    uint16_t    nStatic;        ///> .data and .bss
+    uint16_t    nFree;          ///> Between heap end and current stack pointer
+    uint16_t    nStackUnused;   ///> Never reached by the stack since boot, headroom left
+};
+
+/// \fn void MemoryReport_Init()
+/// \brief Paint free RAM, must be called first thing in setup()
+void MemoryReport_Init();
+
+/// \fn void MemoryReport_Get(tMemoryReport& report)
+/// \brief Measure current RAM usage
+void MemoryReport_Get(tMemoryReport& report);
+
+#endif // TLC_MEMORYREPORT_H
@@ -0,0 +1,174 @@
+///
+/// \file       pumpmap.cpp
+/// \brief      The Lung Carburetor Firmware pump map module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    pumpmap
+#include "pumpmap.h"
+#include "configuration.h"
+#include <EEPROM.h>
+
+/// \enum ePumpMapConsts
+/// \brief Pump map constants
+enum ePumpMapConsts
+{
+    kPumpMapPointCount      = 9,    ///> Breakpoints every kPumpMapPWMStep, 0 to kPumpMapPWMMax
+    kPumpMapPWMStep         = 128,  ///> Pwm between breakpoints
+    kPumpMapPWMMax          = (kPumpMapPointCount - 1) * kPumpMapPWMStep,
+    kPumpMapSteadyTicks     = 40,   ///> Control ticks of steady pwm and pressure before learning
+    kPumpMapSteadyPWMBand   = 8,    ///> Pwm variation allowed in steady state
+    kPumpMapVersion         = 1,    ///> EEPROM pump map version
+};
+
+const float kPumpMapSteadySlope_mmH2O_s = 20.0f;    // Pressure slope allowed in steady state
+const float kPumpMapLearnRate           = 0.05f;    // Learning rate of a steady state sample
+
+/// \struct tPumpMap
+/// \brief Pump map stored in EEPROM after the configuration
+struct tPumpMap
+{
+    uint8_t     nVersion;                               ///> Pump map structure version
+    float       fPressure_mmH2O[kPumpMapPointCount];    ///> Steady state pressure at every pwm breakpoint
+    uint32_t    nCRC;                                   ///> Pump map CRC check
+};
+static tPumpMap gPumpMap;
+
+HXCOMPILATIONASSERT(assertPumpMapEEPROMCheck, (kEEPROM_PumpMapOffset + sizeof(tPumpMap) <= 1024));
+
+static bool     gPumpMapDirty   = false;    // Learned since last save
+static uint16_t gSteadyPWM      = 0;        // Pwm at start of steady state
+static uint8_t  gSteadyTicks    = 0;        // Number of steady control ticks
+
+// Linear map, 1 mmH2O per pwm count, until learned
+static void SetDefaults()
+{
+    gPumpMap.nVersion = kPumpMapVersion;
+    for (uint8_t a = 0; a < kPumpMapPointCount; ++a)
+    {
+        gPumpMap.fPressure_mmH2O[a] = (float)(a * kPumpMapPWMStep);
+    }
+}
+
+bool PumpMap_Init()
+{
+    uint8_t* pMap = (uint8_t*)&gPumpMap;
+    for (size_t a = 0; a < sizeof(tPumpMap); ++a)
+    {
+        pMap[a] = EEPROM[kEEPROM_PumpMapOffset + a];
+    }
+
+    uint32_t oemCRC = gPumpMap.nCRC;
+    gPumpMap.nCRC = 0; // Clear CRC for computation
+    bool bValid = (oemCRC == CRC32(pMap, sizeof(tPumpMap))) && (gPumpMap.nVersion == kPumpMapVersion);
+    if (!bValid)
+    {
+        SetDefaults();
+    }
+
+    gPumpMapDirty   = false;
+    gSteadyTicks    = 0;
+
+    return bValid;
+}
+
+bool PumpMap_Save()
+{
+    if (!gPumpMapDirty)
+    {
+        return true;
+    }
+
+    uint8_t* pMap = (uint8_t*)&gPumpMap;
+    gPumpMap.nVersion   = kPumpMapVersion;
+    gPumpMap.nCRC       = 0; // Clear CRC for computation
+    gPumpMap.nCRC       = CRC32(pMap, sizeof(tPumpMap));
+
+    // Only write bytes that changed, spares EEPROM wear and write time
+    for (size_t a = 0; a < sizeof(tPumpMap); ++a)
+    {
+        EEPROM.update(kEEPROM_PumpMapOffset + a, pMap[a]);
+    }
+    gPumpMap.nCRC   = 0;
+    gPumpMapDirty   = false;
+
+    return true;
+}
+
+void PumpMap_Learn(uint16_t nPWM, float fPressure_mmH2O, float fSlope_mmH2O_s)
+{
+    if (gConfiguration.nPumpMapMode == kPumpMapMode_Disabled || nPWM > kPumpMapPWMMax)
+    {
+        gSteadyTicks = 0;
+        return;
+    }
+
+    // Wait for steady pwm and pressure
+    if (abs((int16_t)nPWM - (int16_t)gSteadyPWM) > kPumpMapSteadyPWMBand || fabs(fSlope_mmH2O_s) > kPumpMapSteadySlope_mmH2O_s)
+    {
+        gSteadyPWM      = nPWM;
+        gSteadyTicks    = 0;
+        return;
+    }
+
+    if (gSteadyTicks < kPumpMapSteadyTicks)
+    {
+        ++gSteadyTicks;
+        return;
+    }
+
+    // Move the two surrounding breakpoints toward the sample, weighted by distance
+    uint8_t index   = nPWM / kPumpMapPWMStep;
+    if (index >= kPumpMapPointCount - 1)
+    {
+        index = kPumpMapPointCount - 2;
+    }
+    float   w       = (float)(nPWM - index * kPumpMapPWMStep) * (1.0f / kPumpMapPWMStep);
+    float   error   = fPressure_mmH2O - ((1.0f - w) * gPumpMap.fPressure_mmH2O[index] + w * gPumpMap.fPressure_mmH2O[index + 1]);
+
+    gPumpMap.fPressure_mmH2O[index]     += kPumpMapLearnRate * (1.0f - w) * error;
+    gPumpMap.fPressure_mmH2O[index + 1] += kPumpMapLearnRate * w * error;
+
+    // Keep the map monotonic so it can be inverted
+    for (uint8_t a = 1; a < kPumpMapPointCount; ++a)
+    {
+        if (gPumpMap.fPressure_mmH2O[a] < gPumpMap.fPressure_mmH2O[a - 1])
+        {
+            gPumpMap.fPressure_mmH2O[a] = gPumpMap.fPressure_mmH2O[a - 1];
+        }
+    }
+
+    gPumpMapDirty = true;
+}
+
+uint16_t PumpMap_Linearize(float fCommand)
+{
+    if (fCommand <= 0.0f)
+    {
+        return 0;
+    }
+
+    const float* pMap   = gPumpMap.fPressure_mmH2O;
+    float        range  = pMap[kPumpMapPointCount - 1] - pMap[0];
+    if (gConfiguration.nPumpMapMode != kPumpMapMode_Linearize || range <= 0.0f)
+    {
+        return (uint16_t)fCommand;
+    }
+
+    // Pressure a linear pump would reach with this command, then pwm reaching it on the learned map
+    float pressure = pMap[0] + fCommand * (range / kPumpMapPWMMax);
+    if (pressure >= pMap[kPumpMapPointCount - 1])
+    {
+        return (uint16_t)fCommand;
+    }
+
+    uint8_t index = 0;
+    while (index < kPumpMapPointCount - 2 && pressure > pMap[index + 1])
+    {
+        ++index;
+    }
+
+    float segment = pMap[index + 1] - pMap[index];
+    float w       = (segment > 0.0f) ? (pressure - pMap[index]) / segment : 0.0f;
+
+    return (uint16_t)((index + w) * kPumpMapPWMStep);
+}
@@ -0,0 +1,42 @@
+///
+/// \file       pumpmap.h
+/// \brief      The Lung Carburetor Firmware pump map module
+///
+/// The pump map is the steady state pressure reached for pump pwm breakpoints. It is learned online
+/// while the exhale valve is closed, persisted in EEPROM, and inverted to linearize the control output.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   pumpmap Pump map
+#ifndef TLC_PUMPMAP_H
+#define TLC_PUMPMAP_H
+
+#include "common.h"
+
+/// \enum ePumpMapMode
+/// \brief Pump map usage
+enum ePumpMapMode
+{
+    kPumpMapMode_Disabled = 0,      ///> Map not learned nor used
+    kPumpMapMode_Learn,             ///> Map learned, control output not linearized
+    kPumpMapMode_Linearize,         ///> Map learned and used to linearize control output
+
+    kPumpMapMode_Count
+};
+
+/// \fn bool PumpMap_Init()
+/// \brief Load pump map from EEPROM, returns false and uses a linear map if invalid
+bool PumpMap_Init();
+
+/// \fn bool PumpMap_Save()
+/// \brief Write pump map to EEPROM if it changed since last save. Blocks while writing, call only when stopped by the operator
+bool PumpMap_Save();
+
+/// \fn void PumpMap_Learn(uint16_t nPWM, float fPressure_mmH2O, float fSlope_mmH2O_s)
+/// \brief Learn from a control tick with exhale valve closed, only steady state samples are used
+void PumpMap_Learn(uint16_t nPWM, float fPressure_mmH2O, float fSlope_mmH2O_s);
+
+/// \fn uint16_t PumpMap_Linearize(float fCommand)
+/// \brief Convert a linear control command in pwm units to the pump pwm reaching the same pressure
+uint16_t PumpMap_Linearize(float fCommand);
+
+#endif // TLC_PUMPMAP_H
@@ -0,0 +1,111 @@
+///
+/// \file       recorder.cpp
+/// \brief      The Lung Carburetor Firmware record and replay module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    recorder
+#include "recorder.h"
+
+/// \struct tRecorder
+/// \brief Record and replay state
+struct tRecorder
+{
+    uint8_t     nMode;                                                  ///> eRecorderMode
+    uint16_t    nReplay[kRecorderReplayQueue][kRecorderChannelCount];   ///> Replay samples ring buffer
+    uint8_t     nReplayHead;                                            ///> Next sample to pop
+    uint8_t     nReplayCount;                                           ///> Number of queued samples
+};
+static tRecorder gRecorder;
+
+// Frame header: sync, type, tick, payload size
+static void WriteHeader(uint8_t nType, uint8_t nSize)
+{
+    uint32_t tick = millis();
+
+    Serial.write(kRecorderSync);
+    Serial.write(nType);
+    Serial.write((const uint8_t*)&tick, sizeof(tick));
+    Serial.write(nSize);
+}
+
+bool Recorder_Init()
+{
+    memset(&gRecorder, 0, sizeof(tRecorder));
+    return true;
+}
+
+bool Recorder_SetMode(uint8_t nMode)
+{
+    if (nMode >= kRecorderMode_Count)
+    {
+        return false;
+    }
+
+#if !RECORDER_REPLAY
+    if (nMode == kRecorderMode_Replay)
+    {
+        return false;
+    }
+#endif
+
+    gRecorder.nMode         = nMode;
+    gRecorder.nReplayHead   = 0;
+    gRecorder.nReplayCount  = 0;
+
+    return true;
+}
+
+uint8_t Recorder_GetMode()
+{
+    return gRecorder.nMode;
+}
+
+void Recorder_CaptureAdc(const uint16_t* pRaw)
+{
+    if (gRecorder.nMode != kRecorderMode_Capture)
+    {
+        return;
+    }
+
+    WriteHeader('A', kRecorderChannelCount * sizeof(uint16_t));
+    Serial.write((const uint8_t*)pRaw, kRecorderChannelCount * sizeof(uint16_t));
+}
+
+void Recorder_CaptureCommand(const uint8_t* pData, uint8_t length)
+{
+    if (gRecorder.nMode != kRecorderMode_Capture)
+    {
+        return;
+    }
+
+    WriteHeader('C', length);
+    Serial.write(pData, length);
+}
+
+bool Recorder_PushReplay(const uint16_t* pRaw)
+{
+    if (gRecorder.nMode != kRecorderMode_Replay || gRecorder.nReplayCount >= kRecorderReplayQueue)
+    {
+        return false;
+    }
+
+    uint8_t index = (gRecorder.nReplayHead + gRecorder.nReplayCount) % kRecorderReplayQueue;
+    memcpy(gRecorder.nReplay[index], pRaw, sizeof(gRecorder.nReplay[index]));
+    ++gRecorder.nReplayCount;
+
+    return true;
+}
+
+bool Recorder_PopReplay(uint16_t* pRaw)
+{
+    if (gRecorder.nReplayCount == 0)
+    {
+        return false;
+    }
+
+    memcpy(pRaw, gRecorder.nReplay[gRecorder.nReplayHead], sizeof(gRecorder.nReplay[0]));
+    gRecorder.nReplayHead = (gRecorder.nReplayHead + 1) % kRecorderReplayQueue;
+    --gRecorder.nReplayCount;
+
+    return true;
+}
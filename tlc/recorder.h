@@ -0,0 +1,71 @@
+///
+/// \file       recorder.h
+/// \brief      The Lung Carburetor Firmware record and replay module
+///
+/// Capture streams every ADC sample and every received command on the serial port as binary frames,
+/// interleaved with the text protocol. A frame is:
+///     kRecorderSync, type ('A' ADC or 'C' command), tick (uint32 ms), payload size (uint8), payload
+/// ADC payload is the 3 raw channels (uint16: pressure 0, pressure 1, battery), command payload is the
+/// command line as received. The sync byte is never part of the text protocol.
+///
+/// Replay feeds ADC samples received with the RPS command to Sensors_Process() in place of the ADC,
+/// recorded commands are replayed by sending them back as received. Replay is only built when RECORDER_REPLAY
+/// is enabled in defs.h and only accepted while respiration is stopped. Control still runs on millis(), so a
+/// replay reproduces the sample sequence, not the exact timing of the recording.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   recorder Record and replay
+#ifndef TLC_RECORDER_H
+#define TLC_RECORDER_H
+
+#include "common.h"
+
+/// \enum eRecorderMode
+/// \brief Record and replay mode
+enum eRecorderMode
+{
+    kRecorderMode_Off = 0,      ///> ADC sampled, nothing recorded
+    kRecorderMode_Capture,      ///> ADC sampled, samples and commands streamed
+    kRecorderMode_Replay,       ///> ADC samples come from the replay queue, RECORDER_REPLAY builds only
+
+    kRecorderMode_Count
+};
+
+/// \enum eRecorderConsts
+/// \brief Record and replay constants
+enum eRecorderConsts
+{
+    kRecorderSync           = 0xA5, ///> Frame start, outside of the text protocol
+    kRecorderChannelCount   = kSensor_Count,    ///> ADC channels per sample, every registered sensor
+    kRecorderReplayQueue    = 8,    ///> Replay samples buffered ahead of Sensors_Process
+};
+
+/// \fn bool Recorder_Init()
+/// \brief Initialize record and replay module
+bool Recorder_Init();
+
+/// \fn bool Recorder_SetMode(uint8_t nMode)
+/// \brief Select eRecorderMode, returns false if invalid or replay isn't built
+bool Recorder_SetMode(uint8_t nMode);
+
+/// \fn uint8_t Recorder_GetMode()
+/// \brief Current eRecorderMode
+uint8_t Recorder_GetMode();
+
+/// \fn void Recorder_CaptureAdc(const uint16_t* pRaw)
+/// \brief Stream an ADC sample when capturing
+void Recorder_CaptureAdc(const uint16_t* pRaw);
+
+/// \fn void Recorder_CaptureCommand(const uint8_t* pData, uint8_t length)
+/// \brief Stream a received command when capturing
+void Recorder_CaptureCommand(const uint8_t* pData, uint8_t length);
+
+/// \fn bool Recorder_PushReplay(const uint16_t* pRaw)
+/// \brief Queue a replay ADC sample, returns false if queue is full
+bool Recorder_PushReplay(const uint16_t* pRaw);
+
+/// \fn bool Recorder_PopReplay(uint16_t* pRaw)
+/// \brief Next replay ADC sample, returns false if queue is empty
+bool Recorder_PopReplay(uint16_t* pRaw);
+
+#endif // TLC_RECORDER_H
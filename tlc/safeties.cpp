@@ -7,23 +7,173 @@
 #include "safeties.h"
 #include "configuration.h"
 #include "datamodel.h"
+#include "sensors.h"
+#include "sensorfusion.h"
 
 tSafeties gSafeties;
 
+/// \enum eSafetySignal
+/// \brief Signals checked by safety rules, in raw ADC counts
+enum eSafetySignal
+{
+    kSafetySignal_Pressure = 0,             ///> Pressure estimate from healthy sensors, offset removed
+    kSafetySignal_PressureSpread,           ///> Largest difference between healthy pressure sensors
+    kSafetySignal_Battery,                  ///> Battery level
+    kSafetySignal_ConfigurationInvalid,     ///> 1 if loaded configuration is invalid
+    kSafetySignal_SensorRange,              ///> 1 if a sensor, pressure sensors included, reads outside its physical span
+    kSafetySignal_PressureRedundancyLost,   ///> 1 if a pressure channel is left out of the fused estimate
+};
+
+/// \enum eSafetyCompare
+/// \brief Rule violation test of signal against threshold
+enum eSafetyCompare
+{
+    kSafetyCompare_AtLeast = 0,             ///> Violated when signal >= threshold
+    kSafetyCompare_AtMost,                  ///> Violated when signal <= threshold
+};
+
+/// \struct tSafetyRule
+/// \brief Safety rule, alarm is raised when N of the last M samples violate the threshold
+///
+/// A latched alarm stops ventilation (kState_Error) until Safeties_Clear(). A non-latched alarm is a warning:
+/// ventilation goes on and the alarm clears by itself once the window has no violation.
+struct tSafetyRule
+{
+    uint8_t         nSignal;                ///> Checked signal (eSafetySignal)
+    uint8_t         nCompare;               ///> Violation test (eSafetyCompare)
+    uint16_t        nAlarm;                 ///> Raised eAlarm bit
+    uint8_t         nPersistN;              ///> Violating samples needed to raise alarm
+    uint8_t         nPersistM;              ///> Window of samples, 8 maximum
+    bool            bLatch;                 ///> Alarm stops ventilation and stays raised until Safeties_Clear(), otherwise warns while window has a violation
+    const float*    pLimit;                 ///> Threshold in configuration, signal unit, nullptr for 1
+};
+
+// Persistence bounds the detection latency to nPersistM samples of kPeriodSensors
+// Spread is taken over the healthy channels only: a channel the fusion can blame is voted out first, the
+// latched redundancy failure is left for disagreements no channel can be blamed for.
+static const tSafetyRule gSafetyRules[] PROGMEM =
+{
+    { kSafetySignal_Pressure,               kSafetyCompare_AtLeast, kAlarm_MaxPressureLimit,            2, 3, true,  &gConfiguration.fMaxPressureLimit_mmH2O },
+    { kSafetySignal_Pressure,               kSafetyCompare_AtMost,  kAlarm_MinPressureLimit,            2, 3, true,  &gConfiguration.fMinPressureLimit_mmH2O },
+    { kSafetySignal_PressureSpread,         kSafetyCompare_AtLeast, kAlarm_PressureSensorRedudancyFail, 3, 4, true,  &gConfiguration.fMaxPressureDelta_mmH2O },
+    { kSafetySignal_ConfigurationInvalid,   kSafetyCompare_AtLeast, kAlarm_InvalidConfiguration,        1, 1, true,  nullptr },
+    { kSafetySignal_Battery,                kSafetyCompare_AtMost,  kAlarm_BatteryLow,                  8, 8, false, &gConfiguration.fMinBatteryLevel },
+    { kSafetySignal_SensorRange,            kSafetyCompare_AtLeast, kAlarm_SensorRange,                 2, 3, true,  nullptr },
+    { kSafetySignal_PressureRedundancyLost, kSafetyCompare_AtLeast, kAlarm_PressureRedundancyLost,      2, 3, false, nullptr },
+};
+
+enum eSafetyConsts
+{
+    kSafetyRuleCount    = sizeof(gSafetyRules) / sizeof(tSafetyRule),
+    kSafetyWarmupAlarms = kAlarm_PressureSensorRedudancyFail | kAlarm_InvalidConfiguration | kAlarm_SensorRange, ///> Alarms recovered through a full warmup
+};
+
+HXCOMPILATIONASSERT(assertSafetyRuleCountCheck, (static_cast<int>(kSafetyRuleCount) == kAlarmCount));
+
+/// \struct tSafetyRuleState
+/// \brief Run-time state of a safety rule
+struct tSafetyRuleState
+{
+    float           fLimit;                 ///> Configuration threshold nRawThreshold was converted from
+    int16_t         nRawThreshold;          ///> Threshold in raw ADC counts
+    uint8_t         nHistory;               ///> Violation of last samples, bit 0 is the newest
+};
+static tSafetyRuleState gSafetyRuleStates[kSafetyRuleCount];
+static uint8_t          gLastSampleCount;
+
+// Convert threshold from signal unit to raw ADC counts, inverse of the sensors transfer functions
+static int16_t ToRaw(uint8_t nSignal, float fLimit)
+{
+    float fRaw;
+    if (nSignal == kSafetySignal_Battery)
+    {
+        fRaw = Sensors_InverseTransfer(kSensor_Battery, fLimit);
+    }
+    else
+    {
+        fRaw = Sensors_PressureInverseTransfer(fLimit);
+    }
+
+    return static_cast<int16_t>(constrain(fRaw, -32768.0f, 32767.0f));
+}
+
+static int16_t ReadSignal(uint8_t nSignal)
+{
+    switch (nSignal)
+    {
+    case kSafetySignal_Pressure:                return gDataModel.nRawPressureFused;
+    case kSafetySignal_PressureSpread:          return min(gDataModel.nRawPressureSpread, (uint16_t)0x7FFF);
+    case kSafetySignal_Battery:                 return gDataModel.nSensorRaw[kSensor_Battery];
+    case kSafetySignal_ConfigurationInvalid:    return gSafeties.bConfigurationInvalid ? 1 : 0;
+    case kSafetySignal_SensorRange:             return (gDataModel.nSensorRangeFlags != 0) ? 1 : 0;
+    case kSafetySignal_PressureRedundancyLost:  return (gSensorFusion.nHealthyCount < kPressureChannelCount) ? 1 : 0;
+    default:                                    return 0;
+    }
+}
+
+static void ClearRuleStates()
+{
+    for (uint8_t a = 0; a < kSafetyRuleCount; ++a)
+    {
+        // NAN never equals a configuration value, forces threshold conversion on next sample
+        gSafetyRuleStates[a].fLimit     = NAN;
+        gSafetyRuleStates[a].nHistory   = 0;
+    }
+}
+
 // Initialize safeties
 bool Safeties_Init()
 {
     gSafeties.bEnabled              = true;
     gSafeties.bCritical             = false;
     gSafeties.bConfigurationInvalid = false;
+    gSafeties.nErrorFlags           = 0;
+    gSafeties.nTickError            = 0;
+    Safeties_ClearStatistics();
+    ClearRuleStates();
+    gLastSampleCount                = gDataModel.nSampleCount;
 
     return true;
 }
 
+void Safeties_ClearStatistics()
+{
+    memset(gSafeties.nTripCount, 0, sizeof(gSafeties.nTripCount));
+    memset(gSafeties.nTickTrip, 0, sizeof(gSafeties.nTickTrip));
+    gSafeties.nRecoveryGap_ms       = 0;
+    gSafeties.nRecoveryGapMax_ms    = 0;
+}
+
+// Count and timestamp alarm bits that were just raised
+static void UpdateStatistics(uint16_t nRaised)
+{
+    uint32_t now = millis();
+    for (uint8_t a = 0; a < kAlarmCount; ++a)
+    {
+        if (nRaised & (1 << a))
+        {
+            if (gSafeties.nTripCount[a] < 0xFFFF)
+            {
+                ++gSafeties.nTripCount[a];
+            }
+            gSafeties.nTickTrip[a] = now;
+        }
+    }
+}
+
 void Safeties_Clear()
 {
     gSafeties.bCritical             = false;
     gDataModel.nSafetyFlags         = 0;
+    ClearRuleStates();
+}
+
+bool Safeties_BeginRecovery()
+{
+    bool bWarmup            = (gSafeties.nErrorFlags & kSafetyWarmupAlarms) != 0 || gSafeties.bConfigurationInvalid;
+    gSafeties.nErrorFlags   = 0;
+
+    return bWarmup;
 }
 
 bool Safeties_Enable()
@@ -38,7 +188,38 @@ bool Safeties_Disable()
     return true;
 }
 
-// Process safeties checks
+// Evaluate rule on latest sample, returns true if its alarm is raised
+static bool EvaluateRule(const tSafetyRule& rule, tSafetyRuleState& state, bool bRaised)
+{
+    float fLimit = (rule.pLimit != nullptr) ? *rule.pLimit : 1.0f;
+    if (fLimit != state.fLimit)
+    {
+        state.fLimit        = fLimit;
+        state.nRawThreshold = (rule.pLimit != nullptr) ? ToRaw(rule.nSignal, fLimit) : 1;
+    }
+
+    int16_t nValue  = ReadSignal(rule.nSignal);
+    bool bViolated  = (rule.nCompare == kSafetyCompare_AtLeast) ? (nValue >= state.nRawThreshold) : (nValue <= state.nRawThreshold);
+
+    uint8_t nWindow = (rule.nPersistM >= 8) ? 0xFF : ((1 << rule.nPersistM) - 1);
+    state.nHistory  = ((state.nHistory << 1) | (bViolated ? 1 : 0)) & nWindow;
+
+    uint8_t nCount = 0;
+    for (uint8_t history = state.nHistory; history != 0; history &= history - 1)
+    {
+        ++nCount;
+    }
+
+    if (nCount >= rule.nPersistN)
+    {
+        return true;
+    }
+
+    // Raised alarm is kept while the window has a violation, or until cleared when latched
+    return bRaised && (rule.bLatch || nCount > 0);
+}
+
+// Process safeties checks, rules are evaluated once per new sensors sample
 void Safeties_Process()
 {
     if (gDataModel.nState != kState_Process)
@@ -46,40 +227,50 @@ void Safeties_Process()
         return;
     }
 
+    if (gDataModel.nSampleCount == gLastSampleCount)
+    {
+        return;
+    }
+    gLastSampleCount = gDataModel.nSampleCount;
+
     // If any safety issue, set bCritical in global safeties structure
     if (gSafeties.bEnabled)
     {
-        float fPressureDelta = gDataModel.fPressure_mmH2O[0] - gDataModel.fPressure_mmH2O[1];
+        uint16_t nPreviousFlags = gDataModel.nSafetyFlags;
+        uint16_t nFlags         = 0;
+        uint16_t nStopFlags     = 0;
 
-        gDataModel.nSafetyFlags = 0;
-        if (gDataModel.fPressure_mmH2O[0] >= gConfiguration.fMaxPressureLimit_mmH2O)
+        for (uint8_t a = 0; a < kSafetyRuleCount; ++a)
         {
-            gDataModel.nSafetyFlags |= kAlarm_MaxPressureLimit;
-        }
-
-        if (gDataModel.fPressure_mmH2O[1] <= gConfiguration.fMinPressureLimit_mmH2O)
-        {
-            gDataModel.nSafetyFlags |= kAlarm_MinPressureLimit;
-        }
+            tSafetyRule rule;
+            memcpy_P(&rule, &gSafetyRules[a], sizeof(tSafetyRule));
 
-        if (fabs(fPressureDelta) >= gConfiguration.fMaxPressureDelta_mmH2O)
-        {
-            gDataModel.nSafetyFlags |= kAlarm_PressureSensorRedudancyFail;
-        }
-
-        if (gSafeties.bConfigurationInvalid)
-        {
-            gDataModel.nSafetyFlags |= kAlarm_InvalidConfiguration;
+            if (EvaluateRule(rule, gSafetyRuleStates[a], (nPreviousFlags & rule.nAlarm) != 0))
+            {
+                nFlags |= rule.nAlarm;
+                if (rule.bLatch)
+                {
+                    nStopFlags |= rule.nAlarm;
+                }
+            }
         }
+        gDataModel.nSafetyFlags = nFlags;
 
-        if (gDataModel.fBatteryLevel < gConfiguration.fMinBatteryLevel)
+        uint16_t nRaised = gDataModel.nSafetyFlags & ~nPreviousFlags;
+        if (nRaised != 0)
         {
-            gDataModel.nSafetyFlags |= kAlarm_BatteryLow;
+            UpdateStatistics(nRaised);
         }
 
-        if (gDataModel.nSafetyFlags != 0)
+        // Warnings are left raised while ventilating, only latched alarms stop it
+        if (nStopFlags != 0)
         {
             gSafeties.bCritical     = true;
+            gSafeties.nErrorFlags  |= nStopFlags;
+            if (gDataModel.bStartFlag)
+            {
+                gSafeties.nTickError = millis();
+            }
             gDataModel.nState       = kState_Error;
         }
     }
@@ -16,6 +16,14 @@ struct tSafeties
     bool    bEnabled;               ///> Safeties are enabled
     bool    bCritical;              ///> Critical safety, details in this structure
     bool    bConfigurationInvalid;  ///> Configuration is invalid
+
+    uint16_t nTripCount[kAlarmCount];   ///> Number of times every eAlarm bit was raised, saturates
+    uint32_t nTickTrip[kAlarmCount];    ///> Tick when every eAlarm bit was last raised
+
+    uint16_t nErrorFlags;               ///> eAlarm bits raised since last recovery from error
+    uint32_t nTickError;                ///> Tick when ventilation was stopped by an error, 0 when not stopped
+    uint32_t nRecoveryGap_ms;           ///> Last time between an error and the next respiration
+    uint32_t nRecoveryGapMax_ms;        ///> Worst time between an error and the next respiration
 };
 extern tSafeties gSafeties;
 
@@ -27,6 +35,13 @@ bool Safeties_Init();
 /// \brief Clear alarms
 void Safeties_Clear();
 
+/// \fn bool Safeties_BeginRecovery()
+/// \brief Leave error once alarms are cleared, returns true if alarms raised since last recovery need a full warmup
+///
+/// Sensor and configuration faults need a full warmup to trust readings again. Other alarms, already
+/// resolved, resume ventilation at the next respiration with sensors kept sampling through the error.
+bool Safeties_BeginRecovery();
+
 /// \fn bool Safeties_Enable()
 /// \brief Enable safeties
 bool Safeties_Enable();
@@ -35,6 +50,10 @@ bool Safeties_Enable();
 /// \brief Disable safeties
 bool Safeties_Disable();
 
+/// \fn void Safeties_ClearStatistics()
+/// \brief Clear alarm trip statistics
+void Safeties_ClearStatistics();
+
 /// \fn bool Safeties_Process()
 /// \brief Process safeties and raise alarms if needed
 void Safeties_Process();
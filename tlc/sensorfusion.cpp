@@ -0,0 +1,163 @@
+///
+/// \file       sensorfusion.cpp
+/// \brief      The Lung Carburetor Firmware pressure sensor fusion module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    sensorfusion
+#include "sensorfusion.h"
+#include "configuration.h"
+#include "sensors.h"
+
+tSensorFusion gSensorFusion;
+
+const float kFusionVarianceGain     = 0.02f;    // Running mean and variance filter gain, ~250ms at kPeriodSensors
+const float kFusionResidualGain     = 0.01f;    // Running residual filter gain, ~500ms at kPeriodSensors
+
+/// \enum eFusionConsts
+/// \brief Sensor fusion constants
+enum eFusionConsts
+{
+    kFusionHeldTolerance    = 2,    ///> Reading change in counts still holding, ADC noise is ~1 count
+    kFusionHeldWindow       = 40,   ///> Samples the others must move within, 200ms at kPeriodSensors: respiration, not drift
+};
+
+void SensorFusion_Init()
+{
+    memset(&gSensorFusion, 0, sizeof(tSensorFusion));
+    gSensorFusion.nHealthyCount = kPressureChannelCount;
+}
+
+// Median of count values, sorted in place, mean of the middle ones for an even count
+static float Median(float* pValues, uint8_t count)
+{
+    for (uint8_t a = 1; a < count; ++a)
+    {
+        for (uint8_t b = a; b > 0 && pValues[b - 1] > pValues[b]; --b)
+        {
+            float t         = pValues[b];
+            pValues[b]      = pValues[b - 1];
+            pValues[b - 1]  = t;
+        }
+    }
+
+    return (count & 1) ? pValues[count / 2] : 0.5f * (pValues[count / 2 - 1] + pValues[count / 2]);
+}
+
+// Flag channels holding their reading while the other healthy ones move by half the redundancy delta within
+// kFusionHeldWindow, a healthy channel seeing the same pressure change moves with them. Recover when they move again.
+static void UpdateStuck(const uint16_t* pRaw, uint8_t nOutOfRange)
+{
+    float fLimit = Sensors_PressureInverseTransfer(gConfiguration.fMaxPressureDelta_mmH2O * 0.5f);
+
+    for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+    {
+        float   fOthers = 0.0f;
+        uint8_t nMask   = 0;
+        uint8_t nCount  = 0;
+        for (uint8_t b = 0; b < kPressureChannelCount; ++b)
+        {
+            if (b != a && gSensorFusion.nHealth[b] == kPressureHealth_Ok && !(nOutOfRange & (1 << b)))
+            {
+                fOthers += pRaw[b];
+                nMask   |= (1 << b);
+                ++nCount;
+            }
+        }
+
+        // Hold restarts when the channel moves, or when the channels it is compared with change
+        bool bMoved = abs((int)pRaw[a] - (int)gSensorFusion.nHeld[a]) > kFusionHeldTolerance;
+        if (bMoved && gSensorFusion.nHealth[a] == kPressureHealth_Stuck)
+        {
+            gSensorFusion.nHealth[a] = kPressureHealth_Ok;
+        }
+
+        if (bMoved || nMask != gSensorFusion.nOthersMask[a] || nCount == 0)
+        {
+            gSensorFusion.nHeld[a]          = pRaw[a];
+            gSensorFusion.fOthersHeld[a]    = (nCount > 0) ? fOthers / nCount : 0.0f;
+            gSensorFusion.nOthersMask[a]    = nMask;
+            gSensorFusion.nHeldSamples[a]   = 0;
+            continue;
+        }
+
+        // Others are compared over a sliding window, a slow drift never adds up to the limit
+        if (++gSensorFusion.nHeldSamples[a] >= kFusionHeldWindow)
+        {
+            gSensorFusion.fOthersHeld[a]    = fOthers / nCount;
+            gSensorFusion.nHeldSamples[a]   = 0;
+        }
+
+        if (gSensorFusion.nHealth[a] == kPressureHealth_Ok && fabs(fOthers / nCount - gSensorFusion.fOthersHeld[a]) > fLimit)
+        {
+            gSensorFusion.nHealth[a] = kPressureHealth_Stuck;
+        }
+    }
+}
+
+// Flag channels far from the estimate, only when a majority of healthy channels can out-vote them.
+// Two channels disagreeing can't tell which one drifts, the redundancy safety stops ventilation then.
+static void UpdateDrift(const uint16_t* pRaw, float fEstimate)
+{
+    float fLimit = Sensors_PressureInverseTransfer(gConfiguration.fMaxPressureDelta_mmH2O * 0.5f);
+
+    for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+    {
+        float& residual = gSensorFusion.fResidual[a];
+        residual += kFusionResidualGain * (((float)pRaw[a] - fEstimate) - residual);
+
+        if (gSensorFusion.nHealth[a] == kPressureHealth_Ok && gSensorFusion.nHealthyCount >= 3 && fabs(residual) > fLimit)
+        {
+            gSensorFusion.nHealth[a] = kPressureHealth_Drift;
+        }
+        else if (gSensorFusion.nHealth[a] == kPressureHealth_Drift && fabs(residual) < 0.5f * fLimit)
+        {
+            gSensorFusion.nHealth[a] = kPressureHealth_Ok;
+        }
+    }
+}
+
+bool SensorFusion_Process(const uint16_t* pRaw, uint8_t nOutOfRange, float& fEstimate, uint16_t& nSpread)
+{
+    for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+    {
+        float delta = (float)pRaw[a] - gSensorFusion.fMean[a];
+        gSensorFusion.fMean[a]      += kFusionVarianceGain * delta;
+        gSensorFusion.fVariance[a]  += kFusionVarianceGain * (delta * delta - gSensorFusion.fVariance[a]);
+    }
+
+    UpdateStuck(pRaw, nOutOfRange);
+
+    float    values[kPressureChannelCount];
+    uint8_t  count  = 0;
+    uint16_t nMin   = 0xFFFF;
+    uint16_t nMax   = 0;
+    for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+    {
+        if (gSensorFusion.nHealth[a] == kPressureHealth_Ok && !(nOutOfRange & (1 << a)))
+        {
+            values[count++] = pRaw[a];
+            nMin = min(nMin, pRaw[a]);
+            nMax = max(nMax, pRaw[a]);
+        }
+    }
+    gSensorFusion.nHealthyCount = count;
+
+    if (count == 0)
+    {
+        // No healthy channel, keep control fed but let the redundancy safety trip
+        for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+        {
+            values[a] = pRaw[a];
+        }
+        fEstimate   = Median(values, kPressureChannelCount);
+        nSpread     = 0xFFFF;
+        return false;
+    }
+
+    fEstimate   = Median(values, count);
+    nSpread     = nMax - nMin;
+
+    UpdateDrift(pRaw, fEstimate);
+
+    return true;
+}
@@ -0,0 +1,57 @@
+///
+/// \file       sensorfusion.h
+/// \brief      The Lung Carburetor Firmware pressure sensor fusion module
+///
+/// Fuse the redundant pressure channels into the estimate driving control. A channel holding its reading
+/// while the others move by half the redundancy delta within kFusionHeldWindow is stuck, voted out before
+/// the spread reaches the delta. The window keeps a slow drift of the others from blaming a healthy channel. Every channel tracks a running residual against the estimate, to detect a drifting sensor. With
+/// 3 channels the median out-votes a drifting one; with 2 channels a drift can't be attributed and is left
+/// to the redundancy safety.
+/// A channel left out of the estimate raises the redundancy lost warning: the spread of the remaining healthy
+/// channels can't show a later drift of a lone survivor.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   sensorfusion Sensor fusion
+#ifndef TLC_SENSORFUSION_H
+#define TLC_SENSORFUSION_H
+
+#include "common.h"
+
+/// \enum ePressureHealth
+/// \brief Health of a pressure channel
+enum ePressureHealth
+{
+    kPressureHealth_Ok = 0,     ///> Channel used in the estimate
+    kPressureHealth_Stuck,      ///> Channel doesn't move while others do
+    kPressureHealth_Drift,      ///> Channel out-voted by the others
+};
+
+/// \struct tSensorFusion
+/// \brief Pressure sensor fusion state, in raw ADC counts
+struct tSensorFusion
+{
+    float       fMean[kPressureChannelCount];       ///> Running mean
+    float       fVariance[kPressureChannelCount];   ///> Running variance around the mean
+    float       fResidual[kPressureChannelCount];   ///> Running difference with the estimate
+    uint16_t    nHeld[kPressureChannelCount];       ///> Reading the channel holds, within kFusionHeldTolerance
+    float       fOthersHeld[kPressureChannelCount]; ///> Mean of the other healthy channels when the hold started
+    uint8_t     nOthersMask[kPressureChannelCount]; ///> Other healthy channels when the hold started, bit mask
+    uint8_t     nHeldSamples[kPressureChannelCount];///> Samples since fOthersHeld was taken
+    uint8_t     nHealth[kPressureChannelCount];     ///> Channel health (ePressureHealth)
+    uint8_t     nHealthyCount;                      ///> Number of channels used in the estimate
+};
+extern tSensorFusion gSensorFusion;
+
+/// \fn void SensorFusion_Init()
+/// \brief Initialize sensor fusion, every channel healthy
+void SensorFusion_Init();
+
+/// \fn bool SensorFusion_Process(const uint16_t* pRaw, uint8_t nOutOfRange, float& fEstimate, uint16_t& nSpread)
+/// \brief Update channel health from a new sample of every channel, offset removed
+/// \param nOutOfRange Channels outside their valid range, bit mask, left out of this estimate
+/// \param fEstimate Median of the healthy channels, median of all when none is healthy
+/// \param nSpread Largest difference between healthy channels, 0xFFFF when none is healthy
+/// \return true if at least one channel is healthy
+bool SensorFusion_Process(const uint16_t* pRaw, uint8_t nOutOfRange, float& fEstimate, uint16_t& nSpread);
+
+#endif // TLC_SENSORFUSION_H
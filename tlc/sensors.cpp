@@ -8,15 +8,353 @@
 #include "datamodel.h"
 #include "configuration.h"
 #include "lcd_keypad.h"
+#include "faultinjection.h"
+#include "recorder.h"
+#include "sensorfusion.h"
+#include "calibration.h"
 
 #define AUTO_PRESSURE_CALIB_AT_BOOT     0
 
+// Sample analog inputs in phase with the pump PWM (Timer1) instead of at an arbitrary phase,
+// so the pump ripple does not alias into the pressure readings.
+#define PWM_SYNC_SAMPLING               1
+
+// Number of PWM phases sampled per period when PWM_SYNC_SAMPLING is enabled.
+// 1: sample at the bottom of the PWM period only.
+// 2: average samples at the bottom and at the top of the period, cancelling the ripple fundamental.
+#define PWM_SYNC_PHASES                 2
+
+#if PWM_SYNC_SAMPLING
+#include "TimerOne.h"
+#endif
+
+/// \enum eAdcConsts
+/// \brief Constants of the ADC channel sequencer
+enum eAdcConsts
+{
+    kAdcChannelCount    = kSensor_Count,            ///> Every registered sensor
+    kAdcChannelIdle     = 0xFF,                     ///> No conversion sequence in progress
+    kAdcMaxConversions  = 64,                       ///> Maximum accumulated conversions per channel, keeps the 16 bits sums from overflowing
+    kAdcFullScale       = 1023,                     ///> Highest conversion of the 10 bits ADC
+#if PWM_SYNC_SAMPLING
+    kAdcTriggerRate_Hz  = PWM_SYNC_PHASES * (1000000L / kPeriodPumpPWM_us), ///> Sequences per second, at every sampled PWM phase
+#else
+    kAdcTriggerRate_Hz  = 1000 / kPeriodSensors,    ///> Sequences per second, at every Sensors_Process
+#endif
+};
+
+HXCOMPILATIONASSERT(assertAdcSumCheck, (kAdcMaxConversions * 1023L <= 0xFFFF));
+
+/// \enum eStabilityConsts
+/// \brief Constants of the warmup sensors stability check
+enum eStabilityConsts
+{
+    kStableSamples      = 20,   ///> Consecutive stable samples before sensors are stable, 100ms at kPeriodSensors
+};
+
+const float kStableVariance         = 2.0f;     // Pressure channel running variance below which it is quiet (counts^2, ADC noise is ~1 count)
+const float kStableOffset_mmH2O     = 20.0f;    // Fused pressure within this of atmosphere, pump stopped
+
+const float kPressureGain_mmH2O = 5000.0f / 1024.0f / kMPX5010_Sensitivity_mV_mmH2O;  // Pressure per count, ADC millivolt per count over sensitivity
+const float kBatteryGain_V      = kBatteryLevelGain * 5.0f / 1024.0f;                   // Battery voltage per count
+
+static const char kNamePressure0[]  PROGMEM = "Pressure0";
+static const char kNamePressure1[]  PROGMEM = "Pressure1";
+static const char kNameBattery[]    PROGMEM = "Battery";
+static const char kUnitsmmH2O[]     PROGMEM = "mmH2O";
+static const char kUnitsVolt[]      PROGMEM = "V";
+
+// Sensor registry, in eSensor order. Future flow and O2 inputs only need a row here, an eSensor and a pin.
+// Pressure sensors read at an ADC rail when open, shorted or past their span; the battery divider spans the whole ADC.
+static const tSensorDescriptor gSensorDescriptors[kSensor_Count] PROGMEM =
+{
+    // Pin              Rate    Filter  Gain                Bias    Offset  Range                   Name            Units
+    { PIN_PRESSURE0,    1000,   1.0f,   kPressureGain_mmH2O, 0.0f,  0,      1,  kAdcFullScale - 1,  kNamePressure0, kUnitsmmH2O },  // Oversampled for control
+    { PIN_PRESSURE1,    1000,   1.0f,   kPressureGain_mmH2O, 0.0f,  1,      1,  kAdcFullScale - 1,  kNamePressure1, kUnitsmmH2O },  // Oversampled for control
+    { PIN_BATTERY,      1,      0.1f,   kBatteryGain_V,     0.0f,   -1,     0,  kAdcFullScale,      kNameBattery,   kUnitsVolt  },  // Changes over minutes, ~10s average
+};
+
+// Pressure counts before calibration, for calibration capture
+static uint16_t gUncalibratedPressure[kPressureChannelCount];
+
+uint16_t Sensors_GetUncalibratedPressure(uint8_t nChannel)
+{
+    return gUncalibratedPressure[nChannel];
+}
+
+// Consecutive stable samples, saturates at kStableSamples
+static uint8_t gStableSamples = 0;
+
+// Pressure channels quiet, in agreement and near atmosphere on the current sample
+static bool IsSampleStable()
+{
+    for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+    {
+        if (gSensorFusion.fVariance[a] >= kStableVariance)
+        {
+            return false;
+        }
+    }
+
+    if (gDataModel.nSensorRangeFlags != 0 ||
+        Sensors_PressureTransfer(gDataModel.nRawPressureSpread) > gConfiguration.fMaxPressureDelta_mmH2O)
+    {
+        return false;
+    }
+
+    return fabs(gDataModel.fPressureFused_mmH2O) <= kStableOffset_mmH2O;
+}
+
+bool Sensors_IsStable()
+{
+    return gStableSamples >= kStableSamples;
+}
+
+void Sensors_GetDescriptor(uint8_t nSensor, tSensorDescriptor& descriptor)
+{
+    memcpy_P(&descriptor, &gSensorDescriptors[nSensor], sizeof(tSensorDescriptor));
+}
+
+/// \struct tAdcSequencer
+/// \brief ADC conversions accumulated per channel
+struct tAdcSequencer
+{
+    uint8_t             nMux[kAdcChannelCount];         ///> ADC multiplexer input of every channel
+    uint8_t             nOversample[kAdcChannelCount];  ///> Conversions per sequence of every channel
+    uint16_t            nDivider[kAdcChannelCount];     ///> Sequences between conversions of every channel
+    uint16_t            nCountdown[kAdcChannelCount];   ///> Sequences left before next conversion of every channel
+    uint8_t             nActive;                        ///> Channels converted in current sequence, bit mask
+
+    volatile uint16_t   nSum[kAdcChannelCount];         ///> Sum of converted samples per channel
+    volatile uint8_t    nCount[kAdcChannelCount];       ///> Number of converted samples in the sums
+    volatile uint8_t    nChannel;                       ///> Channel being converted, kAdcChannelIdle when idle
+    volatile uint8_t    nRepeat;                        ///> Conversions left on nChannel
+
+    float               fFilterGain[kAdcChannelCount];  ///> Filter gain of every channel
+    float               fFiltered[kAdcChannelCount];    ///> Filtered channel readings
+    uint8_t             nPrimed;                        ///> Channels with a filtered reading, bit mask
+};
+static tAdcSequencer gAdcSequencer;
+
+// Next channel of the sequence from channel, kAdcChannelIdle when done
+static inline uint8_t NextChannel(uint8_t channel)
+{
+    while (channel < kAdcChannelCount && !(gAdcSequencer.nActive & (1 << channel)))
+    {
+        ++channel;
+    }
+
+    return channel < kAdcChannelCount ? channel : static_cast<uint8_t>(kAdcChannelIdle);
+}
+
+#if PWM_SYNC_SAMPLING
+// Select the channel multiplexer (AVcc reference, as analogRead) and start a conversion
+static inline void StartConversion(uint8_t channel)
+{
+    gAdcSequencer.nChannel = channel;
+    gAdcSequencer.nRepeat  = gAdcSequencer.nOversample[channel];
+    ADMUX   = _BV(REFS0) | gAdcSequencer.nMux[channel];
+    ADCSRA |= _BV(ADSC);
+}
+#endif
+
+// Select channels due in this sequence, returns false if sums are full
+static bool BeginSequence()
+{
+    for (uint8_t a = 0; a < kAdcChannelCount; ++a)
+    {
+        if (gAdcSequencer.nCount[a] + gAdcSequencer.nOversample[a] > kAdcMaxConversions)
+        {
+            return false;
+        }
+    }
+
+    gAdcSequencer.nActive = 0;
+    for (uint8_t a = 0; a < kAdcChannelCount; ++a)
+    {
+        if (gAdcSequencer.nCountdown[a] == 0)
+        {
+            gAdcSequencer.nActive       |= (1 << a);
+            gAdcSequencer.nCountdown[a]  = gAdcSequencer.nDivider[a];
+        }
+        --gAdcSequencer.nCountdown[a];
+    }
+
+    return gAdcSequencer.nActive != 0;
+}
+
+#if PWM_SYNC_SAMPLING
+// Called at a fixed phase of the pump PWM, starts a conversion sequence over due channels
+static void SyncSampleTrigger()
+{
+    if (gAdcSequencer.nChannel != kAdcChannelIdle || !BeginSequence())
+    {
+        return;
+    }
+
+    StartConversion(NextChannel(0));
+}
+
+// Timer1 compare B matches at the top of the PWM period
+ISR(TIMER1_COMPB_vect)
+{
+    SyncSampleTrigger();
+}
+
+// Conversion complete, accumulate and chain the next conversion of the sequence
+ISR(ADC_vect)
+{
+    uint8_t channel = gAdcSequencer.nChannel;
+    gAdcSequencer.nSum[channel] += ADC;
+    ++gAdcSequencer.nCount[channel];
+
+    if (--gAdcSequencer.nRepeat > 0)
+    {
+        ADCSRA |= _BV(ADSC);
+        return;
+    }
+
+    channel = NextChannel(channel + 1);
+    if (channel != kAdcChannelIdle)
+    {
+        StartConversion(channel);
+    }
+    else
+    {
+        gAdcSequencer.nChannel = kAdcChannelIdle;
+    }
+}
+#else
+// Convert due channels in place, at every Sensors_Process
+static void PollSequence()
+{
+    if (!BeginSequence())
+    {
+        return;
+    }
+
+    for (uint8_t channel = NextChannel(0); channel != kAdcChannelIdle; channel = NextChannel(channel + 1))
+    {
+        for (uint8_t a = 0; a < gAdcSequencer.nOversample[channel]; ++a)
+        {
+            gAdcSequencer.nSum[channel] += analogRead(A0 + gAdcSequencer.nMux[channel]);
+            ++gAdcSequencer.nCount[channel];
+        }
+    }
+}
+#endif
+
+static void AdcSequencer_Init()
+{
+    memset((void*)&gAdcSequencer, 0, sizeof(tAdcSequencer));
+    gAdcSequencer.nChannel = kAdcChannelIdle;
+
+    for (uint8_t a = 0; a < kAdcChannelCount; ++a)
+    {
+        tSensorDescriptor descriptor;
+        Sensors_GetDescriptor(a, descriptor);
+        pinMode(descriptor.nPin, INPUT);
+
+        uint16_t rate = descriptor.nRate_Hz;
+        gAdcSequencer.nMux[a]           = (descriptor.nPin - A0) & 0x07;
+        gAdcSequencer.fFilterGain[a]    = descriptor.fFilterGain;
+        gAdcSequencer.nOversample[a]    = constrain(rate / kAdcTriggerRate_Hz, 1, kAdcMaxConversions);
+        gAdcSequencer.nDivider[a]       = max(kAdcTriggerRate_Hz / rate, 1);
+    }
+}
+
+// Fetch the filtered average of conversions accumulated since last call, held for channels without new conversions.
+// Returns false if pressure channels have no new conversion.
+static bool ReadAdc(uint16_t* pRaw)
+{
+    uint16_t sum[kAdcChannelCount];
+    uint8_t  count[kAdcChannelCount];
+
+#if PWM_SYNC_SAMPLING
+    noInterrupts();
+#else
+    PollSequence();
+#endif
+    for (uint8_t a = 0; a < kAdcChannelCount; ++a)
+    {
+        sum[a]   = gAdcSequencer.nSum[a];
+        count[a] = gAdcSequencer.nCount[a];
+        gAdcSequencer.nSum[a]   = 0;
+        gAdcSequencer.nCount[a] = 0;
+    }
+#if PWM_SYNC_SAMPLING
+    interrupts();
+#endif
+
+    for (uint8_t a = 0; a < kAdcChannelCount; ++a)
+    {
+        if (count[a] > 0)
+        {
+            float average = (float)sum[a] / count[a];
+            if (gAdcSequencer.nPrimed & (1 << a))
+            {
+                gAdcSequencer.fFiltered[a] += gAdcSequencer.fFilterGain[a] * (average - gAdcSequencer.fFiltered[a]);
+            }
+            else
+            {
+                gAdcSequencer.fFiltered[a] = average;
+                gAdcSequencer.nPrimed |= (1 << a);
+            }
+        }
+
+        pRaw[a] = static_cast<uint16_t>(gAdcSequencer.fFiltered[a] + 0.5f);
+    }
+
+    return count[0] > 0;
+}
+
 // Initialize sensor devices
 bool Sensors_Init()
 {
+    AdcSequencer_Init();
+
+#if PWM_SYNC_SAMPLING
+    // Pump PWM timer must be initialized (Control_Init) before attaching to it.
+    // The overflow interrupt happens at the bottom of the phase and frequency correct PWM.
+    Timer1.attachInterrupt(SyncSampleTrigger);
+
+#if PWM_SYNC_PHASES > 1
+    // Compare B at TOP gives a second sampling phase, half a period later. Pin 10 output stays disconnected.
+    noInterrupts();
+    OCR1B   = ICR1;
+    TIMSK1 |= _BV(OCIE1B);
+    interrupts();
+#endif
+
+    ADCSRA |= _BV(ADIE);
+#endif
+
+    SensorFusion_Init();
+
     return true;
 }
 
+float Sensors_Transfer(uint8_t nSensor, float fRaw)
+{
+    return fRaw * pgm_read_float(&gSensorDescriptors[nSensor].fGain) + pgm_read_float(&gSensorDescriptors[nSensor].fBias);
+}
+
+float Sensors_InverseTransfer(uint8_t nSensor, float fValue)
+{
+    return (fValue - pgm_read_float(&gSensorDescriptors[nSensor].fBias)) / pgm_read_float(&gSensorDescriptors[nSensor].fGain);
+}
+
+// Transfer function for raw pressure, offset already removed, same for every pressure sensor
+float Sensors_PressureTransfer(float fRaw)
+{
+    return fRaw * kPressureGain_mmH2O;
+}
+
+float Sensors_PressureInverseTransfer(float fPressure_mmH2O)
+{
+    return fPressure_mmH2O * (1.0f / kPressureGain_mmH2O);
+}
+
 #if AUTO_PRESSURE_CALIB_AT_BOOT
 // Set zero counter, when activating auto-pressure sensor setzero at boot
 static int gSetZero = 100;
@@ -25,59 +363,98 @@ static int gSetZero = 100;
 // Process sensors sampling
 void Sensors_Process()
 {
-    if (!(gDataModel.nState == kState_Process || gDataModel.nState == kState_Warmup))
+    // Sampling goes on through an error, sensors are warm on a fast recovery
+    if (!(gDataModel.nState == kState_Process || gDataModel.nState == kState_Warmup || gDataModel.nState == kState_Error))
     {
+      // Samples before a new warmup are not trusted for its stability
+      gStableSamples = 0;
       return;
     }
 
 
-    gDataModel.nRawPressure[0] = analogRead(PIN_PRESSURE0);
-    gDataModel.nRawPressure[1] = analogRead(PIN_PRESSURE1);
+    uint16_t nRaw[kSensor_Count];
+    bool bSampled = ReadAdc(nRaw);
 
-    if (gDataModel.nRawPressure[0] > gConfiguration.nPressureSensorOffset[0])
+#if RECORDER_REPLAY
+    if (Recorder_GetMode() == kRecorderMode_Replay)
     {
-      gDataModel.nRawPressure[0] -= gConfiguration.nPressureSensorOffset[0];
-    }
-    else
-    {
-      gDataModel.nRawPressure[0] = 0;
+        // Replayed samples stand in for the ADC, sensors wait for the replay driver
+        bSampled = Recorder_PopReplay(nRaw);
     }
+#endif
 
-    if (gDataModel.nRawPressure[1] > gConfiguration.nPressureSensorOffset[1])
+    if (!bSampled)
     {
-      gDataModel.nRawPressure[1] -= gConfiguration.nPressureSensorOffset[1];
+        // No new sample since last call, keep previous readings
+        return;
     }
-    else
+
+#if FAULT_INJECTION
+    for (uint8_t a = 0; a < kSensor_Count; ++a)
     {
-      gDataModel.nRawPressure[1] = 0;
+        nRaw[a] = FaultInjection_Adc(a, nRaw[a]);
     }
+#endif
+
+    Recorder_CaptureAdc(nRaw);
 
     // Debug code for automatically setting pressure at Zero on boot
 #if AUTO_PRESSURE_CALIB_AT_BOOT
     if (gSetZero > 0)
     {
         --gSetZero;
-        gConfiguration.nPressureSensorOffset[0] = analogRead(PIN_PRESSURE0);
+        gConfiguration.nPressureSensorOffset[0] = nRaw[0];
     }
 #endif
 
-    // Transfer function for raw pressure.
-    float mV    = (float)gDataModel.nRawPressure[0] * (1.0f/1024.0f) * 5000.0f; // Voltage in millivolt measured on ADC
-    float mmH2O = mV * (1.0f / kMPX5010_Sensitivity_mV_mmH2O);
+    // Every registered sensor: offset, transfer function and valid range
+    uint8_t nRangeFlags = 0;
+    for (uint8_t a = 0; a < kSensor_Count; ++a)
+    {
+        tSensorDescriptor descriptor;
+        Sensors_GetDescriptor(a, descriptor);
+
+        uint16_t offset = (descriptor.nOffset >= 0) ? gConfiguration.nPressureSensorOffset[descriptor.nOffset] : 0;
+        uint16_t raw    = (nRaw[a] > offset) ? nRaw[a] - offset : 0;
 
-    gDataModel.fPressure_mmH2O[0] = mmH2O;
+        if (descriptor.nOffset >= 0)
+        {
+            gUncalibratedPressure[descriptor.nOffset] = raw;
+            raw = Calibration_Apply(descriptor.nOffset, raw);
+        }
+        float    value  = raw * descriptor.fGain + descriptor.fBias;
 
-    // Redundant pressure reading, for safeties
-    mV      = (float)gDataModel.nRawPressure[1] * (1.0f/1024.0f) * 5000.0f; // Voltage in millivolt measured on ADC
-    mmH2O   = mV * (1.0f / kMPX5010_Sensitivity_mV_mmH2O);
+        if (nRaw[a] < descriptor.nRangeMin || nRaw[a] > descriptor.nRangeMax)
+        {
+            nRangeFlags |= (1 << a);
+        }
 
-    gDataModel.fPressure_mmH2O[1] = mmH2O;
+        gDataModel.nSensorRaw[a]    = raw;
+        gDataModel.fSensor[a]       = value;
+    }
+    gDataModel.nSensorRangeFlags = nRangeFlags;
 
+    // Control is fed from the healthy sensors, a degraded one is voted out instead of stopping ventilation
+    float fRawFused;
+    SensorFusion_Process(&gDataModel.nSensorRaw[kSensor_Pressure0], nRangeFlags, fRawFused, gDataModel.nRawPressureSpread);
+    gDataModel.nRawPressureFused    = static_cast<uint16_t>(fRawFused + 0.5f);
+    gDataModel.fPressureFused_mmH2O = Sensors_PressureTransfer(fRawFused);
 
-    char szPressure[6];
+    // What fits on the Lcd line after the label, the pressure span of the sensors takes at most 8 characters
+    char szPressure[kLcdLineSize - (sizeof("mmH2O:") - 1)];
     // 4 is mininum width, 2 is precision; float value is copied onto str_temp
-    dtostrf(gDataModel.fPressure_mmH2O[0], 4, 2, szPressure);
-    sprintf(gLcdMsg,"mmH2O:%s", szPressure);
+    dtostrf(gDataModel.fPressureFused_mmH2O, 4, 2, szPressure);
+    snprintf_P(gLcdMsg, kLcdLineSize, PSTR("mmH2O:%s"), szPressure);
+
+    if (!IsSampleStable())
+    {
+        gStableSamples = 0;
+    }
+    else if (gStableSamples < kStableSamples)
+    {
+        ++gStableSamples;
+    }
 
-    gDataModel.fBatteryLevel = (float)analogRead(PIN_BATTERY) * (1.0f/1024.0f) * (kBatteryLevelGain * 5.0f);
+    // Safeties are evaluated once per new sample
+    ++gDataModel.nSampleCount;
 }
@@ -9,6 +9,30 @@
 
 #include "common.h"
 
+/// \struct tSensorDescriptor
+/// \brief Registered analog sensor: sampling, conversion and valid range
+///
+/// Sensors sampled faster than the ADC sequence rate are oversampled, slower ones are converted every few sequences.
+/// Conversions are averaged between reads and filtered, then converted: (raw - offset) * gain + bias.
+/// A conversion outside the valid range means a disconnected, shorted or saturated sensor, not a limit of therapy.
+struct tSensorDescriptor
+{
+    uint8_t     nPin;           ///> Analog input pin
+    uint16_t    nRate_Hz;       ///> Conversions per second
+    float       fFilterGain;    ///> First order filter gain applied on every new average, 1 for none
+    float       fGain;          ///> Transfer function gain, units per count
+    float       fBias;          ///> Transfer function bias, units
+    int8_t      nOffset;        ///> Pressure channel of the zero offset and calibration in configuration, -1 for none
+    uint16_t    nRangeMin;      ///> Lowest valid conversion, ADC counts before offset, physical span of the sensor
+    uint16_t    nRangeMax;      ///> Highest valid conversion, ADC counts before offset, physical span of the sensor
+    const char* szName;         ///> Name in telemetry, in flash
+    const char* szUnits;        ///> Units in telemetry, in flash
+};
+
+/// \fn void Sensors_GetDescriptor(uint8_t nSensor, tSensorDescriptor& descriptor)
+/// \brief Copy descriptor of sensor nSensor (eSensor) from flash
+void Sensors_GetDescriptor(uint8_t nSensor, tSensorDescriptor& descriptor);
+
 /// \fn bool Sensors_Init()
 /// \brief Initialize sensors
 bool Sensors_Init();
@@ -17,4 +41,30 @@ bool Sensors_Init();
 /// \brief Process sensors readings
 void Sensors_Process();
 
+/// \fn bool Sensors_IsStable()
+/// \brief True when the pressure sensors have been quiet, in agreement and near atmosphere for the last samples
+///
+/// Lets warmup end as soon as readings are valid instead of waiting its full period.
+bool Sensors_IsStable();
+
+/// \fn uint16_t Sensors_GetUncalibratedPressure(uint8_t nChannel)
+/// \brief Last counts of pressure channel nChannel, offset removed, before calibration
+uint16_t Sensors_GetUncalibratedPressure(uint8_t nChannel);
+
+/// \fn float Sensors_Transfer(uint8_t nSensor, float fRaw)
+/// \brief Convert raw counts of sensor nSensor (eSensor), offset removed, to its units
+float Sensors_Transfer(uint8_t nSensor, float fRaw);
+
+/// \fn float Sensors_InverseTransfer(uint8_t nSensor, float fValue)
+/// \brief Convert a value in units of sensor nSensor (eSensor) to raw counts, offset removed
+float Sensors_InverseTransfer(uint8_t nSensor, float fValue);
+
+/// \fn float Sensors_PressureTransfer(float fRaw)
+/// \brief Convert raw pressure sensor counts, offset removed, to mmH2O
+float Sensors_PressureTransfer(float fRaw);
+
+/// \fn float Sensors_PressureInverseTransfer(float fPressure_mmH2O)
+/// \brief Convert mmH2O to raw pressure sensor counts, offset removed
+float Sensors_PressureInverseTransfer(float fPressure_mmH2O);
+
 #endif // TLC_SENSORS_H
\ No newline at end of file
@@ -10,6 +10,17 @@
 #include "configuration.h"
 #include "datamodel.h"
 #include "safeties.h"
+#include "control.h"
+#include "pumpmap.h"
+#include "faultinjection.h"
+#include "recorder.h"
+#include "benchmark.h"
+#include "tasktiming.h"
+#include "memoryreport.h"
+#include "sensorfusion.h"
+#include "sensors.h"
+#include "calibration.h"
+#include "leak.h"
 
 namespace
 {
@@ -44,10 +55,39 @@ namespace
         Commands_ConfigLoad,
         Commands_SetGainPID,
         Commands_SetLimitPID,
+        Commands_Schedule,
+        Commands_SetTrigger,
+        Commands_SetFeedForward,
+        Commands_SetPumpMap,
+        Commands_SafetyStatistics,
+        Commands_FaultInject,
+        Commands_FaultResult,
+        Commands_Record,
+        Commands_ReplaySample,
+        Commands_Benchmark,
+        Commands_TaskTiming,
+        Commands_Memory,
+        Commands_SensorFusion,
+        Commands_Sensors,
+        Commands_Calibration,
+        Commands_CalibrationCapture,
+        Commands_Leak,
+        Commands_Boot,
         Commands_Count
     };
 
-    const char* CommandsData[] = {
+    // Scratch Buffer to work on Array parsing, sized for the largest array command (CAL with every point)
+    enum eConsts
+    {
+        kCommandSize        = 3,
+        kScratchBufferSize  = (1 + 2 * kCalibrationPointCount) * sizeof(float),
+        kParseBufferSize    = 24
+    };
+
+    HXCOMPILATIONASSERT(assertScratchBufferSizeCheck, (kScratchBufferSize >= 3 * kGainSet_Count * sizeof(float)));
+
+    // Command names stay in flash, compared with strncmp_P
+    const char CommandsData[][kCommandSize + 1] PROGMEM = {
         "UNK",
         "CFG",
         "STA",
@@ -76,16 +116,27 @@ namespace
         "CLD",
         "SGP",
         "SLP",
+        "SCH",
+        "STR",
+        "SFF",
+        "SPM",
+        "SST",
+        "FIJ",
+        "FIR",
+        "REC",
+        "RPS",
+        "BEN",
+        "WCT",
+        "MEM",
+        "FUS",
+        "SEN",
+        "CAL",
+        "CAP",
+        "SLK",
+        "BOT",
         "UNK"
     };
 
-    // Scratch Buffer to work on Array parsing
-    enum eConsts
-    {
-        kCommandSize        = 3,
-        kScratchBufferSize  = 128,
-        kParseBufferSize    = 24
-    };
     static uint8_t gScratchBuffer[kScratchBufferSize];
     static char    gParseBuffer[kParseBufferSize];
 
@@ -169,6 +220,20 @@ namespace
         Serial.print(gParseBuffer);
     }
 
+    template <>
+    void serialPrint(long t)
+    {
+        ltoa(t, gParseBuffer, 10);
+        Serial.print(gParseBuffer);
+    }
+
+    template <>
+    void serialPrint(unsigned long t)
+    {
+        ultoa(t, gParseBuffer, 10);
+        Serial.print(gParseBuffer);
+    }
+
     // DEBUG function
     #if 0
     void printValue(const char* str, int f)
@@ -182,31 +247,44 @@ namespace
 
 bool updateCurve()
 {
-    if (gDataModel.nRespirationPerMinute > 0)
+    if (gDataModel.fRespirationPerMinute > 0.0f)
     {
         // Updating Data model
-        float breatheTime = 1.0f/gDataModel.nRespirationPerMinute; //TODO: Pass breathe time instead of breathre Rate - or better yet, separate inhale and exhale times
+        float breatheTime = 1.0f/gDataModel.fRespirationPerMinute; //TODO: Pass breathe time instead of breathre Rate - or better yet, separate inhale and exhale times
+
+        // Fill the shadow curves, control swaps them in at the next respiration cycle
+        tRespirationCurves* pCurves = DataModel_BeginCurvesUpdate();
 
         //Inhale curve
-        gDataModel.pInhaleCurve.nCount = 3; //Initial point, flex point, end point
-        gDataModel.pInhaleCurve.nSetPoint_TickMs[0] = 0;
-        gDataModel.pInhaleCurve.nSetPoint_TickMs[2] = static_cast<uint32_t>((breatheTime*gDataModel.fInhaleRatio) * 1000); //Assumes inhaleRatio + exhaleRatio = 1
-        gDataModel.pInhaleCurve.nSetPoint_TickMs[1] = gDataModel.pInhaleCurve.nSetPoint_TickMs[2] / 2; //I don't know if it's better to convert or to round.
-
-        gDataModel.pInhaleCurve.fSetPoint_mmH2O[0] = gDataModel.fExhalePressureTarget_mmH2O;
-        gDataModel.pInhaleCurve.fSetPoint_mmH2O[1] = gDataModel.fInhalePressureTarget_mmH2O;
-        gDataModel.pInhaleCurve.fSetPoint_mmH2O[2] = gDataModel.fInhalePressureTarget_mmH2O;
+        pCurves->pInhaleCurve.nCount = 3; //Initial point, flex point, end point
+        pCurves->pInhaleCurve.nSetPoint_TickMs[0] = 0;
+        pCurves->pInhaleCurve.nSetPoint_TickMs[2] = static_cast<uint32_t>((breatheTime*gDataModel.fInhaleRatio) * 1000); //Assumes inhaleRatio + exhaleRatio = 1
+        pCurves->pInhaleCurve.nSetPoint_TickMs[1] = pCurves->pInhaleCurve.nSetPoint_TickMs[2] / 2; //I don't know if it's better to convert or to round.
+
+        pCurves->pInhaleCurve.fSetPoint_mmH2O[0] = gDataModel.fExhalePressureTarget_mmH2O;
+        pCurves->pInhaleCurve.fSetPoint_mmH2O[1] = gDataModel.fInhalePressureTarget_mmH2O;
+        pCurves->pInhaleCurve.fSetPoint_mmH2O[2] = gDataModel.fInhalePressureTarget_mmH2O;
+
+        pCurves->pInhaleCurve.nGainSet[0] = kGainSet_Rise;
+        pCurves->pInhaleCurve.nGainSet[1] = kGainSet_Rise;
+        pCurves->pInhaleCurve.nGainSet[2] = kGainSet_Plateau;
         //TODO: Add more intermediary points if curve is not smooth enough
 
         //Exhale curve
-        gDataModel.pExhaleCurve.nCount = 3;
-        gDataModel.pExhaleCurve.nSetPoint_TickMs[0] = 0;
-        gDataModel.pExhaleCurve.nSetPoint_TickMs[2] = static_cast<uint32_t>((breatheTime*gDataModel.fExhaleRatio) * 1000); //Assumes inhaleRatio + exhaleRatio = 1
-        gDataModel.pExhaleCurve.nSetPoint_TickMs[1] = gDataModel.pExhaleCurve.nSetPoint_TickMs[2] / 2; //I don't know if it's better to convert or to round.
-
-        gDataModel.pExhaleCurve.fSetPoint_mmH2O[0] = gDataModel.fInhalePressureTarget_mmH2O;
-        gDataModel.pExhaleCurve.fSetPoint_mmH2O[1] = gDataModel.fExhalePressureTarget_mmH2O;
-        gDataModel.pExhaleCurve.fSetPoint_mmH2O[2] = gDataModel.fExhalePressureTarget_mmH2O;
+        pCurves->pExhaleCurve.nCount = 3;
+        pCurves->pExhaleCurve.nSetPoint_TickMs[0] = 0;
+        pCurves->pExhaleCurve.nSetPoint_TickMs[2] = static_cast<uint32_t>((breatheTime*gDataModel.fExhaleRatio) * 1000); //Assumes inhaleRatio + exhaleRatio = 1
+        pCurves->pExhaleCurve.nSetPoint_TickMs[1] = pCurves->pExhaleCurve.nSetPoint_TickMs[2] / 2; //I don't know if it's better to convert or to round.
+
+        pCurves->pExhaleCurve.fSetPoint_mmH2O[0] = gDataModel.fInhalePressureTarget_mmH2O;
+        pCurves->pExhaleCurve.fSetPoint_mmH2O[1] = gDataModel.fExhalePressureTarget_mmH2O;
+        pCurves->pExhaleCurve.fSetPoint_mmH2O[2] = gDataModel.fExhalePressureTarget_mmH2O;
+
+        pCurves->pExhaleCurve.nGainSet[0] = kGainSet_Exhale;
+        pCurves->pExhaleCurve.nGainSet[1] = kGainSet_Exhale;
+        pCurves->pExhaleCurve.nGainSet[2] = kGainSet_Exhale;
+
+        DataModel_CommitCurves();
         return true;
     }
 
@@ -239,6 +317,34 @@ bool updateCurve()
     */
 }
 
+uint8_t FindCommand(const uint8_t* pData)
+{
+    const char command[kCommandSize] = { (char)pData[0], (char)pData[1], (char)pData[2] };
+
+    uint8_t commandIndex = 0;
+    for (commandIndex = 1; commandIndex < Commands_Count; ++commandIndex)
+    {
+        if (strncmp_P(command, CommandsData[commandIndex], kCommandSize) == 0)
+        {
+            // we found our command!
+            return commandIndex;
+        }
+    }
+
+    return Commands_Unknown;
+}
+
+bool GetCommandName(uint8_t index, char* szName)
+{
+    if (index >= Commands_Count)
+    {
+        return false;
+    }
+
+    strcpy_P(szName, CommandsData[index]);
+    return true;
+}
+
 bool ParseCommand(uint8_t* pData, uint8_t length)
 {
     // replace the end of the string with 0s so it's compatible with the strcmp function
@@ -250,67 +356,58 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
         return false;
     }
 
-    uint8_t command[kCommandSize + 1] = { pData[dataIndex++], pData[dataIndex++], pData[dataIndex++], '\0' };
-
-    uint8_t commandIndex = 0;
-    for (commandIndex = 1; commandIndex < Commands_Count; ++commandIndex)
-    {
-        if (strcmp(reinterpret_cast<char*>(command), CommandsData[commandIndex]) == 0)
-        {
-            // we found our command!
-            break;
-        }
-    }
+    uint8_t commandIndex = FindCommand(pData);
+    dataIndex += kCommandSize;
 
     switch (commandIndex)
     {
     case Commands_Configs:
     {
         serialPrint(0.0f); // FIO
-        Serial.print(","); serialPrint(0.0f);//serialPrint(gConfiguration.fTakeOverThreshold_ms);
-        float breatheRate = static_cast<float>(gDataModel.nRespirationPerMinute);
-        Serial.print(","); serialPrint(breatheRate);
-        Serial.print(","); serialPrint(gDataModel.fInhalePressureTarget_mmH2O);
-        Serial.print(","); serialPrint(gDataModel.fExhalePressureTarget_mmH2O);
-        Serial.print(","); serialPrint(gDataModel.fInhaleRatio);
-        Serial.print(","); serialPrint(gDataModel.fExhaleRatio);
-        Serial.print(","); serialPrint(gConfiguration.fMinBatteryLevel);
-        Serial.print(","); serialPrint(0.0f); // ALT - alarm low tidal
-        Serial.print(","); serialPrint(0.0f); // AHT - alarm high tidal
-        Serial.print(","); serialPrint(gConfiguration.fMinPressureLimit_mmH2O);
-        Serial.print(","); serialPrint(gConfiguration.fMaxPressureLimit_mmH2O);
-        Serial.print(","); serialPrint(gConfiguration.fMaxPressureDelta_mmH2O);
-        Serial.print(","); serialPrint(0.0f); // ALF - alarm low fio mix
-        Serial.print(","); serialPrint(0.0f); // AHF - alarm high fio mix
-        Serial.print(","); serialPrint(0.0f); // ANR - alarm non rebreathing value
-
-        Serial.print("\r\n");
+        Serial.print(','); serialPrint(0.0f);//serialPrint(gConfiguration.fTakeOverThreshold_ms);
+        Serial.print(','); serialPrint(gDataModel.fRespirationPerMinute);
+        Serial.print(','); serialPrint(gDataModel.fInhalePressureTarget_mmH2O);
+        Serial.print(','); serialPrint(gDataModel.fExhalePressureTarget_mmH2O);
+        Serial.print(','); serialPrint(gDataModel.fInhaleRatio);
+        Serial.print(','); serialPrint(gDataModel.fExhaleRatio);
+        Serial.print(','); serialPrint(gConfiguration.fMinBatteryLevel);
+        Serial.print(','); serialPrint(0.0f); // ALT - alarm low tidal
+        Serial.print(','); serialPrint(0.0f); // AHT - alarm high tidal
+        Serial.print(','); serialPrint(gConfiguration.fMinPressureLimit_mmH2O);
+        Serial.print(','); serialPrint(gConfiguration.fMaxPressureLimit_mmH2O);
+        Serial.print(','); serialPrint(gConfiguration.fMaxPressureDelta_mmH2O);
+        Serial.print(','); serialPrint(0.0f); // ALF - alarm low fio mix
+        Serial.print(','); serialPrint(0.0f); // AHF - alarm high fio mix
+        Serial.print(','); serialPrint(0.0f); // ANR - alarm non rebreathing value
+
+        Serial.print(F("\r\n"));
     }
     break;
 
     case Commands_Alive:
-        Serial.println("ACK");
+        Serial.println(F("ACK"));
         break;
 
     case Commands_Status:
     {
-        serialPrint(gDataModel.fPressure_mmH2O[0]);
-        Serial.print(","); serialPrint(gDataModel.fPressure_mmH2O[1]);
-        Serial.print(","); serialPrint(gDataModel.fRequestPressure_mmH2O);
-        Serial.print(","); serialPrint(gDataModel.fBatteryLevel);
-        Serial.print(","); serialPrint(static_cast<int>(gDataModel.nPWMPump));
-        Serial.print(","); serialPrint(static_cast<int>(gDataModel.nState));
-        Serial.print(","); serialPrint(static_cast<int>(gDataModel.nControlMode));
-        Serial.print(","); serialPrint(static_cast<int>(gDataModel.nTriggerMode));
-        Serial.print(","); serialPrint(static_cast<int>(gDataModel.nCycleState));
+        serialPrint(gDataModel.fSensor[kSensor_Pressure0]);
+        Serial.print(','); serialPrint(gDataModel.fSensor[kSensor_Pressure1]);
+        Serial.print(','); serialPrint(gDataModel.fRequestPressure_mmH2O);
+        Serial.print(','); serialPrint(gDataModel.fSensor[kSensor_Battery]);
+        Serial.print(','); serialPrint(static_cast<int>(gDataModel.nPWMPump));
+        Serial.print(','); serialPrint(static_cast<int>(gDataModel.nState));
+        Serial.print(','); serialPrint(static_cast<int>(gDataModel.nControlMode));
+        Serial.print(','); serialPrint(static_cast<int>(gDataModel.nTriggerMode));
+        Serial.print(','); serialPrint(static_cast<int>(gDataModel.nCycleState));
 
         // Alarms
-        (gDataModel.nSafetyFlags & kAlarm_MinPressureLimit) ? Serial.print(",1") : Serial.print(",0");
-        (gDataModel.nSafetyFlags & kAlarm_MaxPressureLimit) ? Serial.print(",1") : Serial.print(",0");
-        (gDataModel.nSafetyFlags & kAlarm_PressureSensorRedudancyFail) ? Serial.print(",1") : Serial.print(",0");
-        (gDataModel.nSafetyFlags & kAlarm_InvalidConfiguration) ? Serial.print(",1") : Serial.print(",0");
+        (gDataModel.nSafetyFlags & kAlarm_MinPressureLimit) ? Serial.print(F(",1")) : Serial.print(F(",0"));
+        (gDataModel.nSafetyFlags & kAlarm_MaxPressureLimit) ? Serial.print(F(",1")) : Serial.print(F(",0"));
+        (gDataModel.nSafetyFlags & kAlarm_PressureSensorRedudancyFail) ? Serial.print(F(",1")) : Serial.print(F(",0"));
+        (gDataModel.nSafetyFlags & kAlarm_InvalidConfiguration) ? Serial.print(F(",1")) : Serial.print(F(",0"));
+        (gDataModel.nSafetyFlags & kAlarm_PressureRedundancyLost) ? Serial.print(F(",1")) : Serial.print(F(",0"));
 
-        Serial.print("\r\n");
+        Serial.print(F("\r\n"));
     }
     break;
 
@@ -323,10 +420,10 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
         if (ok)
         {
             gDataModel.nControlMode = static_cast<eControlMode>(temp);
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         }
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -339,10 +436,10 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
         if (ok)
         {
             gDataModel.nTriggerMode = static_cast<eTriggerMode>(temp);
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         }
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -353,10 +450,16 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
         if (ok)
         {
             gDataModel.bStartFlag = temp != 0;
-            Serial.println("ACK");
+
+            // Respiration always runs on the ADC, never on replayed samples
+            if (gDataModel.bStartFlag && Recorder_GetMode() == kRecorderMode_Replay)
+            {
+                Recorder_SetMode(kRecorderMode_Off);
+            }
+            Serial.println(F("ACK"));
         }
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -364,9 +467,9 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
     {
         float fio;
         if (getValue(pData, dataIndex, length, fio) && fio >= 20.0f && fio <= 100.0f)
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -396,7 +499,7 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
 
         if (ok)
         {
-            gDataModel.nRespirationPerMinute = static_cast<uint8_t>(breatheRate);
+            Control_SetRespirationRate(breatheRate);
             gDataModel.fInhalePressureTarget_mmH2O = inhaleMmH2O;
             gDataModel.fExhalePressureTarget_mmH2O = exhaleMmH2O;
             gDataModel.fInhaleRatio             = inhaleRatio;
@@ -405,9 +508,9 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
         }
 
         if (ok)
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -419,13 +522,13 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
             if (temp >= 0.0f)
             {
                 //gConfiguration.fTakeOverThreshold_ms = temp;
-                Serial.println("ACK");
+                Serial.println(F("ACK"));
             }
             else
-                Serial.println("NACK");
+                Serial.println(F("NACK"));
         }
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -437,13 +540,13 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
             if (temp >= 0.0f)
             {
                 gConfiguration.fMinBatteryLevel = temp;
-                Serial.println("ACK");
+                Serial.println(F("ACK"));
             }
             else
-                Serial.println("NACK");
+                Serial.println(F("NACK"));
         }
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -451,9 +554,9 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
     {
         float temp;
         if (getValue(pData, dataIndex, length, temp))
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -461,36 +564,36 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
     {
         float temp;
         if (getValue(pData, dataIndex, length, temp))
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
     case Commands_AlarmLowPressure:
     {
         if (getValue(pData, dataIndex, length, gConfiguration.fMinPressureLimit_mmH2O))
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
     case Commands_AlarmHighPressure:
     {
         if (getValue(pData, dataIndex, length, gConfiguration.fMaxPressureLimit_mmH2O))
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
     case Commands_AlarmHighDeltaPressure:
     {
         if (getValue(pData, dataIndex, length, gConfiguration.fMaxPressureDelta_mmH2O))
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -498,9 +601,9 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
     {
         float temp;
         if (getValue(pData, dataIndex, length, temp))
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -508,9 +611,9 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
     {
         float temp;
         if (getValue(pData, dataIndex, length, temp))
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -518,36 +621,38 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
     {
         float temp;
         if (getValue(pData, dataIndex, length, temp))
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
     case Commands_InitializePressureSensor:
     {
-        gConfiguration.nPressureSensorOffset[0] = gDataModel.nRawPressure[0];
-        gConfiguration.nPressureSensorOffset[1] = gDataModel.nRawPressure[1];
-        Serial.println("ACK");
+        for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+        {
+            gConfiguration.nPressureSensorOffset[a] = gDataModel.nSensorRaw[kSensor_Pressure0 + a];
+        }
+        Serial.println(F("ACK"));
     }
     break;
 
     case Commands_InitializePeepValue:
     {
-        Serial.println("ACK");
+        Serial.println(F("ACK"));
     }
     break;
 
     case Commands_InitializeTidalVolume:
     {
-        Serial.println("ACK");
+        Serial.println(F("ACK"));
     }
     break;
     
     case Commands_AlarmReset:
     {
         Safeties_Clear();
-        Serial.println("ACK");
+        Serial.println(F("ACK"));
     }
     break;
 
@@ -564,24 +669,25 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
             {
                 Safeties_Enable();
             }
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
         }
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
     }
     break;
 
     case Commands_ConfigSave:
     {
         Configuration_Write();
-        Serial.println("ACK");
+        PumpMap_Save();
+        Serial.println(F("ACK"));
     }
     break;
 
     case Commands_ConfigLoad:
     {
         Configuration_Read();
-        Serial.println("ACK");
+        Serial.println(F("ACK"));
     }
     break;
 
@@ -589,15 +695,44 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
     {
         float* fp;
         int32_t count;
-        if (getValueArray(pData, dataIndex, length, fp, count) && count == 3)
+        bool ok = getValueArray(pData, dataIndex, length, fp, count);
+        if (ok && count == 3)
         {
-            gConfiguration.fGainP = fp[0];
-            gConfiguration.fGainI = fp[1];
-            gConfiguration.fGainD = fp[2];
-            Serial.println("ACK");
+            // P, I, D applied to every gain set
+            for (int a = 0; a < kGainSet_Count; ++a)
+            {
+                gConfiguration.pGains[a].fP = fp[0];
+                gConfiguration.pGains[a].fI = fp[1];
+                gConfiguration.pGains[a].fD = fp[2];
+            }
+        }
+        else if (ok && count == 4 && fp[0] >= 0.0f && fp[0] < kGainSet_Count)
+        {
+            // Gain set index (eGainSet), P, I, D
+            tGains& gains = gConfiguration.pGains[static_cast<int>(fp[0])];
+            gains.fP = fp[1];
+            gains.fI = fp[2];
+            gains.fD = fp[3];
+        }
+        else if (ok && count == 3 * kGainSet_Count)
+        {
+            // P, I, D of every gain set, in eGainSet order
+            for (int a = 0; a < kGainSet_Count; ++a)
+            {
+                gConfiguration.pGains[a].fP = fp[a*3 + 0];
+                gConfiguration.pGains[a].fI = fp[a*3 + 1];
+                gConfiguration.pGains[a].fD = fp[a*3 + 2];
+            }
         }
         else
-            Serial.println("NACK");
+        {
+            ok = false;
+        }
+
+        if (ok)
+            Serial.println(F("ACK"));
+        else
+            Serial.println(F("NACK"));
     }
     break;
 
@@ -609,15 +744,363 @@ bool ParseCommand(uint8_t* pData, uint8_t length)
         {
             gConfiguration.fILimit = fp[0];
             gConfiguration.fPILimit= fp[1];
-            Serial.println("ACK");
+            Serial.println(F("ACK"));
+        }
+        else
+            Serial.println(F("NACK"));
+    }
+    break;
+
+    case Commands_SetTrigger:
+    {
+        float* fp;
+        int32_t count;
+        if (getValueArray(pData, dataIndex, length, fp, count) && count == 3 && fp[1] >= 0.0f && fp[2] >= 0.0f && fp[2] <= 65535.0f)
+        {
+            gConfiguration.fPatientTrigger_mmH2O        = fp[0];
+            gConfiguration.fPatientTriggerSlope_mmH2O_s = fp[1];
+            gConfiguration.nPatientTriggerRefractory_ms = static_cast<uint16_t>(fp[2]);
+            Serial.println(F("ACK"));
         }
         else
-            Serial.println("NACK");
+            Serial.println(F("NACK"));
+    }
+    break;
+
+    case Commands_SetFeedForward:
+    {
+        float* fp;
+        int32_t count;
+        if (getValueArray(pData, dataIndex, length, fp, count) && count == 2 && fp[0] >= 0.0f && fp[1] >= 0.0f && fp[1] <= 1.0f)
+        {
+            gConfiguration.fFeedForwardGain     = fp[0];
+            gConfiguration.fFeedForwardForget   = fp[1];
+            Serial.println(F("ACK"));
+        }
+        else
+            Serial.println(F("NACK"));
+    }
+    break;
+
+    case Commands_SetPumpMap:
+    {
+        uint8_t temp;
+        if (getValue(pData, dataIndex, length, temp) && temp < kPumpMapMode_Count)
+        {
+            gConfiguration.nPumpMapMode = temp;
+            Serial.println(F("ACK"));
+        }
+        else
+            Serial.println(F("NACK"));
+    }
+    break;
+
+    case Commands_SafetyStatistics:
+    {
+        // Current tick, then trip count and last trip tick of every eAlarm bit, last and worst ventilation gap of errors in ms.
+        // Optional non zero byte clears them after reporting.
+        serialPrint(static_cast<unsigned long>(millis()));
+        for (uint8_t a = 0; a < kAlarmCount; ++a)
+        {
+            Serial.print(','); serialPrint(static_cast<unsigned long>(gSafeties.nTripCount[a]));
+            Serial.print(','); serialPrint(static_cast<unsigned long>(gSafeties.nTickTrip[a]));
+        }
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gSafeties.nRecoveryGap_ms));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gSafeties.nRecoveryGapMax_ms));
+        Serial.print(F("\r\n"));
+
+        uint8_t clear = 0;
+        if (getValue(pData, dataIndex, length, clear) && clear != 0)
+        {
+            Safeties_ClearStatistics();
+        }
+    }
+    break;
+
+#if FAULT_INJECTION
+    case Commands_FaultInject:
+    {
+        float* fp;
+        int32_t count;
+        // eFault, target (ADC channel or EEPROM address), value
+        if (getValueArray(pData, dataIndex, length, fp, count) && count == 3 && fp[0] >= 0.0f && fp[1] >= 0.0f &&
+            FaultInjection_Inject(static_cast<uint8_t>(fp[0]), static_cast<uint16_t>(fp[1]), static_cast<int32_t>(fp[2])))
+        {
+            Serial.println(F("ACK"));
+        }
+        else
+            Serial.println(F("NACK"));
+    }
+    break;
+
+    case Commands_FaultResult:
+    {
+        // Current tick, last fault, injection tick, first flag tick and flags, first error tick
+        serialPrint(static_cast<unsigned long>(millis()));
+        Serial.print(','); serialPrint(static_cast<int>(gFaultInjection.nLastFault));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gFaultInjection.nTickInjected));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gFaultInjection.nTickFlagged));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gFaultInjection.nFlags));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gFaultInjection.nTickError));
+
+        Serial.print(F("\r\n"));
+    }
+    break;
+#endif
+
+    case Commands_Record:
+    {
+        // Replay only while respiration is stopped
+        uint8_t temp;
+        if (getValue(pData, dataIndex, length, temp) && (temp != kRecorderMode_Replay || !gDataModel.bStartFlag) && Recorder_SetMode(temp))
+            Serial.println(F("ACK"));
+        else
+            Serial.println(F("NACK"));
+    }
+    break;
+
+#if RECORDER_REPLAY
+    case Commands_ReplaySample:
+    {
+        // Raw counts of every sensor. NACK when the queue is full, resend later, or while respiration is started.
+        uint16_t raw[kRecorderChannelCount];
+        bool ok = !gDataModel.bStartFlag;
+        for (uint8_t a = 0; ok && a < kRecorderChannelCount; ++a)
+        {
+            ok = getValue(pData, dataIndex, length, raw[a]);
+        }
+
+        if (ok && Recorder_PushReplay(raw))
+            Serial.println(F("ACK"));
+        else
+            Serial.println(F("NACK"));
+    }
+    break;
+#endif
+
+    case Commands_TaskTiming:
+    {
+        // Budget, worst time of every eTask in us, overrun count, last overrun tick. Optional non zero byte clears them after reporting.
+        serialPrint(static_cast<unsigned long>(kTaskBudget_us));
+        for (uint8_t a = 0; a < kTask_Count; ++a)
+        {
+            Serial.print(','); serialPrint(static_cast<unsigned long>(gTaskTiming.nWorst_us[a]));
+        }
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gTaskTiming.nOverrunCount));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gTaskTiming.nTickOverrun));
+        Serial.print(F("\r\n"));
+
+        uint8_t clear = 0;
+        if (getValue(pData, dataIndex, length, clear) && clear != 0)
+        {
+            TaskTiming_Clear();
+        }
+    }
+    break;
+
+    case Commands_Memory:
+    {
+        // RAM size, static RAM, free RAM and stack headroom left since boot, in bytes
+        tMemoryReport report;
+        MemoryReport_Get(report);
+
+        serialPrint(static_cast<unsigned long>(RAMEND + 1 - RAMSTART));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(report.nStatic));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(report.nFree));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(report.nStackUnused));
+        Serial.print(F("\r\n"));
+    }
+    break;
+
+    case Commands_SensorFusion:
+    {
+        // Fused pressure, healthy channel count, then health (ePressureHealth), variance and residual of every channel in ADC counts
+        serialPrint(gDataModel.fPressureFused_mmH2O);
+        Serial.print(','); serialPrint(static_cast<int>(gSensorFusion.nHealthyCount));
+        for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+        {
+            Serial.print(','); serialPrint(static_cast<int>(gSensorFusion.nHealth[a]));
+            Serial.print(','); serialPrint(gSensorFusion.fVariance[a]);
+            Serial.print(','); serialPrint(gSensorFusion.fResidual[a]);
+        }
+        Serial.print(F("\r\n"));
+    }
+    break;
+
+    case Commands_Sensors:
+    {
+        // Reading of every registered sensor (eSensor) in its units, then out of range flags.
+        // Optional non zero byte prints "name[units]" of every sensor instead.
+        uint8_t header = 0;
+        getValue(pData, dataIndex, length, header);
+
+        for (uint8_t a = 0; a < kSensor_Count; ++a)
+        {
+            if (a > 0)
+            {
+                Serial.print(',');
+            }
+
+            if (header != 0)
+            {
+                tSensorDescriptor descriptor;
+                Sensors_GetDescriptor(a, descriptor);
+                Serial.print(reinterpret_cast<const __FlashStringHelper*>(descriptor.szName));
+                Serial.print('[');
+                Serial.print(reinterpret_cast<const __FlashStringHelper*>(descriptor.szUnits));
+                Serial.print(']');
+            }
+            else
+            {
+                serialPrint(gDataModel.fSensor[a]);
+            }
+        }
+
+        if (header == 0)
+        {
+            Serial.print(','); serialPrint(static_cast<int>(gDataModel.nSensorRangeFlags));
+        }
+        Serial.print(F("\r\n"));
+    }
+    break;
+
+    case Commands_Calibration:
+    {
+        float* fp;
+        int32_t count;
+        bool ok = getValueArray(pData, dataIndex, length, fp, count) && fp[0] >= 0.0f && fp[0] < kPressureChannelCount;
+        uint8_t channel = ok ? static_cast<uint8_t>(fp[0]) : 0;
+        tCalibration& calibration = gConfiguration.pCalibration[channel];
+
+        if (ok && count == 1)
+        {
+            // Sensor only: report point count, then counts and pressure of every point
+            uint8_t points = min(calibration.nCount, (uint8_t)kCalibrationPointCount);
+            serialPrint(static_cast<int>(points));
+            for (uint8_t a = 0; a < points; ++a)
+            {
+                Serial.print(','); serialPrint(static_cast<int>(calibration.pPoints[a].nRaw));
+                Serial.print(','); serialPrint(calibration.pPoints[a].fPressure_mmH2O);
+            }
+            Serial.print(F("\r\n"));
+            break;
+        }
+
+        if (ok && count == 2)
+        {
+            // Sensor, then 0: clear every point, sensor uses the nominal transfer
+            if (fp[1] == 0.0f)
+            {
+                Calibration_Clear(channel);
+                Serial.println(F("ACK"));
+            }
+            else
+                Serial.println(F("NACK"));
+            break;
+        }
+
+        // Sensor, then counts and pressure of every point sorted by increasing counts, at least 2 points
+        int32_t points = (count - 1) / 2;
+        ok = ok && (count & 1) && points >= 2 && points <= kCalibrationPointCount;
+        for (int32_t a = 0; ok && a < points; ++a)
+        {
+            float raw = fp[1 + a*2];
+            ok = raw >= 0.0f && raw <= 1023.0f && (a == 0 || raw > fp[1 + (a-1)*2]);
+        }
+
+        if (ok)
+        {
+            calibration.nCount = points;
+            for (int32_t a = 0; a < points; ++a)
+            {
+                calibration.pPoints[a].nRaw             = static_cast<uint16_t>(fp[1 + a*2]);
+                calibration.pPoints[a].fPressure_mmH2O  = fp[2 + a*2];
+            }
+            Calibration_Build();
+            Serial.println(F("ACK"));
+        }
+        else
+            Serial.println(F("NACK"));
+    }
+    break;
+
+    case Commands_CalibrationCapture:
+    {
+        float* fp;
+        int32_t count;
+        // Sensor, reference pressure applied now: adds a point at the current reading
+        if (getValueArray(pData, dataIndex, length, fp, count) && count == 2 && fp[0] >= 0.0f && fp[0] < kPressureChannelCount &&
+            Calibration_AddPoint(static_cast<uint8_t>(fp[0]), Sensors_GetUncalibratedPressure(static_cast<uint8_t>(fp[0])), fp[1]))
+        {
+            Serial.println(F("ACK"));
+        }
+        else
+            Serial.println(F("NACK"));
+    }
+    break;
+
+    case Commands_Leak:
+    {
+        // Optional compensation gain (0..1), then report gain, estimated pressure gain and leak rate, samples and current compensation
+        float temp;
+        if (getValue(pData, dataIndex, length, temp))
+        {
+            if (temp < 0.0f || temp > 1.0f)
+            {
+                Serial.println(F("NACK"));
+                break;
+            }
+            gConfiguration.fLeakCompensationGain = temp;
+        }
+
+        serialPrint(gConfiguration.fLeakCompensationGain);
+        Serial.print(','); serialPrint(gLeakEstimator.fGain);
+        Serial.print(','); serialPrint(gLeakEstimator.fLeak);
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gLeakEstimator.nSamples));
+        Serial.print(','); serialPrint(gDataModel.fLeak);
+        Serial.print(F("\r\n"));
+    }
+    break;
+
+    case Commands_Boot:
+    {
+        // Reset cause flags (MCUSR), warm restart, end of first warmup and first respiration in ms since reset, 0 until reached
+        serialPrint(static_cast<unsigned long>(gDataModel.nResetFlags));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gDataModel.bWarmRestart));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gDataModel.nTickWarmupDone));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gDataModel.nTickFirstBreath));
+        Serial.print(F("\r\n"));
+    }
+    break;
+
+#if BENCHMARK
+    case Commands_Benchmark:
+    {
+        if (!gDataModel.bStartFlag)
+        {
+            Benchmark_Run();
+            Serial.println(F("ACK"));
+        }
+        else
+            Serial.println(F("NACK"));
+    }
+    break;
+#endif
+
+    case Commands_Schedule:
+    {
+        serialPrint(static_cast<unsigned long>(gDataModel.nRespirationPeriod_us));
+        Serial.print(','); serialPrint(static_cast<unsigned long>(gDataModel.nRespirationCount));
+        Serial.print(','); serialPrint(static_cast<long>(gDataModel.nRespirationLateness_us));
+        Serial.print(','); serialPrint(static_cast<long>(gDataModel.nRespirationLatenessMax_us));
+        Serial.print(','); serialPrint(static_cast<long>(gDataModel.nRespirationTimingError_us));
+
+        Serial.print(F("\r\n"));
     }
     break;
 
     default:
-        Serial.println("NACK");
+        Serial.println(F("NACK"));
         break;
     }
 
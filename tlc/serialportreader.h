@@ -10,9 +10,17 @@
 
 #include <stdint.h>
 
-/// \fn bool UpdateCurve()
+/// \fn bool updateCurve()
 /// \brief Update curve
-bool UpdateCurve();
+bool updateCurve();
+
+/// \fn uint8_t FindCommand(const uint8_t* pData)
+/// \brief Return index of the 3 characters command in pData, 0 when unknown
+uint8_t FindCommand(const uint8_t* pData);
+
+/// \fn bool GetCommandName(uint8_t index, char* szName)
+/// \brief Copy 3 characters name of command index to szName (4 bytes), returns false past last command
+bool GetCommandName(uint8_t index, char* szName);
 
 /// \fn bool ParseCommand()
 /// \brief Parse command receive from serial port
@@ -0,0 +1,33 @@
+///
+/// \file       tasktiming.cpp
+/// \brief      The Lung Carburetor Firmware task timing module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    tasktiming
+#include "tasktiming.h"
+
+tTaskTiming gTaskTiming;
+
+void TaskTiming_Clear()
+{
+    memset(&gTaskTiming, 0, sizeof(tTaskTiming));
+}
+
+void TaskTiming_Update(uint8_t nTask, uint32_t nStart_us)
+{
+    uint32_t elapsed = micros() - nStart_us;
+
+    if (elapsed > gTaskTiming.nWorst_us[nTask])
+    {
+        gTaskTiming.nWorst_us[nTask] = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+    }
+
+    if (nTask == kTask_Loop && elapsed > kTaskBudget_us)
+    {
+        if (gTaskTiming.nOverrunCount < 0xFFFF)
+        {
+            ++gTaskTiming.nOverrunCount;
+        }
+        gTaskTiming.nTickOverrun = millis();
+    }
+}
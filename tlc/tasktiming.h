@@ -0,0 +1,55 @@
+///
+/// \file       tasktiming.h
+/// \brief      The Lung Carburetor Firmware task timing module
+///
+/// Worst-case execution time of every task of the main loop and of whole loop iterations, measured
+/// on the target with micros(), so soft-float and EEPROM costs are included. A loop iteration longer
+/// than the control period counts as an overrun.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   tasktiming Task timing
+#ifndef TLC_TASKTIMING_H
+#define TLC_TASKTIMING_H
+
+#include "common.h"
+
+/// \enum eTask
+/// \brief Timed tasks of the main loop
+enum eTask
+{
+    kTask_Communications = 0,   ///> Communications_Process
+    kTask_Sensors,              ///> Sensors_Process
+    kTask_Control,              ///> Control_Process
+    kTask_LcdKeypad,            ///> LcdKeypad_Process
+    kTask_Safeties,             ///> Safeties_Process
+    kTask_Loop,                 ///> Whole loop iteration
+
+    kTask_Count
+};
+
+/// \enum eTaskTimingConsts
+/// \brief Task timing constants
+enum eTaskTimingConsts
+{
+    kTaskBudget_us          = kPeriodControl * 1000L,   ///> Loop iteration budget, one control period
+};
+
+/// \struct tTaskTiming
+/// \brief Task execution time statistics
+struct tTaskTiming
+{
+    uint16_t    nWorst_us[kTask_Count];     ///> Worst execution time of every task, saturates
+    uint16_t    nOverrunCount;              ///> Loop iterations over kTaskBudget_us, saturates
+    uint32_t    nTickOverrun;               ///> Tick of last overrun
+};
+extern tTaskTiming gTaskTiming;
+
+/// \fn void TaskTiming_Clear()
+/// \brief Clear task timing statistics
+void TaskTiming_Clear();
+
+/// \fn void TaskTiming_Update(uint8_t nTask, uint32_t nStart_us)
+/// \brief Account execution time of task nTask (eTask) started at nStart_us
+void TaskTiming_Update(uint8_t nTask, uint32_t nStart_us);
+
+#endif // TLC_TASKTIMING_H
@@ -14,28 +14,77 @@
 #include "gpio.h"
 #include "configuration.h"
 #include "lcd_keypad.h"
+#include "feedforward.h"
+#include "leak.h"
+#include "pumpmap.h"
+#include "faultinjection.h"
+#include "recorder.h"
+#include "tasktiming.h"
+#include "memoryreport.h"
+#include "warmrestart.h"
+#include "buzzer.h"
 
 static uint32_t gStartTick = 0;
 
+// Reset cause handed over by the bootloader. Optiboot clears MCUSR before starting the sketch and passes it in r2.
+static uint8_t gBootResetFlags __attribute__((section(".noinit")));
+
+#if defined(__AVR__)
+// Runs first after reset, before the C runtime initialization uses r2. Left out of host simulator builds.
+static void CaptureResetFlags() __attribute__((naked, used, section(".init0")));
+static void CaptureResetFlags()
+{
+    __asm__ __volatile__ ("sts %0, r2\n" : "=m" (gBootResetFlags) :);
+}
+#endif
+
 void setup() 
 {
-    wdt_enable(WDTO_4S);
+    // First, everything below the stack is painted to measure its high-water mark
+    MemoryReport_Init();
+
+    // Reset cause is kept to tell a watchdog reboot from a power up. MCUSR still holds it without a bootloader,
+    // or with one that doesn't clear it; otherwise it comes from the bootloader hand-off.
+    // The watchdog flag must be cleared before enabling it.
+    uint8_t resetFlags = (MCUSR != 0) ? MCUSR : gBootResetFlags;
+    MCUSR = 0;
+
+    // Interrupt then reset, 4s in total once WarmRestart_Save() arms the interrupt
+    wdt_enable(WDTO_2S);
     
     GPIO_Init();    
 
+    Buzzer_Init();
+
     DataModel_Init();
+    gDataModel.nResetFlags = resetFlags;
+
+    Recorder_Init();
+
+    TaskTiming_Clear();
         
     Communications_Init();
 
-    Sensors_Init();
-
     Control_Init();
 
+    // After Control_Init defaults, a watchdog reset resumes ventilation with the settings it had
+    gDataModel.bWarmRestart = WarmRestart_Restore(resetFlags);
+
+    FeedForward_Init();
+
+    Leak_Init();
+
+    // After Control_Init, sensors sampling may synchronize on the pump PWM timer
+    Sensors_Init();
+
     Safeties_Init();
 
     LcdKeypad_Init();
         
     bool cfgSuccess = Configuration_Init();
+
+    // Invalid pump map falls back to a linear map, learned again while ventilating
+    PumpMap_Init();
     
     // If loading fails, we are probably using an uninitialized device, or we are faced with eeprom corruption, force safety error after warmup.
     if (!cfgSuccess)
@@ -47,10 +96,7 @@ void setup()
     gDataModel.nState   = kState_Warmup;
     gStartTick          = millis();
 
-	digitalWrite(PIN_OUT_BUZZER, LOW);
-    delay(100);
-    digitalWrite(PIN_OUT_BUZZER, HIGH);
-    delay(100);
+    Buzzer_Chirp();
 }
 
 // Main processing loop
@@ -58,6 +104,9 @@ void loop()
 {   
     wdt_reset();
 
+    uint32_t loopStart = micros();
+    uint32_t taskStart;
+
     // Process state machine
     switch (gDataModel.nState)
     {
@@ -69,13 +118,20 @@ void loop()
         
     // Warmup system and sensors to have valid readings when going in process state
     case kState_Warmup:
-        digitalWrite(PIN_OUT_BUZZER, HIGH);
-		
-        if ((millis() - gStartTick) >= kPeriodWarmup)
+    {
+        uint32_t warmupTime = millis() - gStartTick;
+
+        // Leave as soon as sensors are stable, or at most after kPeriodWarmup to let safeties judge the readings
+        if ((warmupTime >= kPeriodWarmupMin && Sensors_IsStable()) || warmupTime >= kPeriodWarmup)
         {
+            if (gDataModel.nTickWarmupDone == 0)
+            {
+                gDataModel.nTickWarmupDone = millis();
+            }
             gDataModel.nState = kState_Process;
         }
-        break;
+    }
+    break;
         
     // Normal processing
     case kState_Process:    
@@ -83,13 +139,19 @@ void loop()
         
     // Error state in case of safeties issues
     case kState_Error:    
-        digitalWrite(PIN_OUT_BUZZER, LOW);
-	       
-        // Stay in error until recovery
+        // Stay in error until recovery, sensor and configuration faults go through a full warmup
 		if (!gSafeties.bCritical)
 		{			
-			gDataModel.nState   = kState_Warmup;
-			gStartTick          = millis();
+            if (Safeties_BeginRecovery())
+            {
+                gDataModel.nState   = kState_Warmup;
+                gStartTick          = millis();
+            }
+            else
+            {
+                // Resolved alarm, control resumes at the next respiration
+                gDataModel.nState   = kState_Process;
+            }
 		}
         break;
         
@@ -100,26 +162,54 @@ void loop()
     if ((millis() - gDataModel.nTickCommunications) >= kPeriodCommunications)
     {
         gDataModel.nTickCommunications = millis();
+        taskStart = micros();
 		Communications_Process();        
+        TaskTiming_Update(kTask_Communications, taskStart);
     }
         
     if ((millis() - gDataModel.nTickSensors) >= kPeriodSensors)
     {
         gDataModel.nTickSensors = millis();
+        taskStart = micros();
 		Sensors_Process();        
+        TaskTiming_Update(kTask_Sensors, taskStart);
     }
     
     if ((millis() - gDataModel.nTickControl) >= kPeriodControl)
     {
         gDataModel.nTickControl = millis();
+        taskStart = micros();
 		Control_Process();        
+        TaskTiming_Update(kTask_Control, taskStart);
     }
 
     if ((millis() - gDataModel.nTickLcdKeypad) >= kPeriodLcdKeypad)
     {
         gDataModel.nTickLcdKeypad = millis();
+        taskStart = micros();
 		LcdKeypad_Process();
+        TaskTiming_Update(kTask_LcdKeypad, taskStart);
     }
     
+    if ((millis() - gDataModel.nTickBuzzer) >= kPeriodBuzzer)
+    {
+        gDataModel.nTickBuzzer = millis();
+		Buzzer_Process();
+    }
+
+    if ((millis() - gDataModel.nTickWarmRestart) >= kPeriodWarmRestart)
+    {
+        gDataModel.nTickWarmRestart = millis();
+		WarmRestart_Save();
+    }
+    
+    taskStart = micros();
     Safeties_Process();
+    TaskTiming_Update(kTask_Safeties, taskStart);
+
+#if FAULT_INJECTION
+    FaultInjection_Process();
+#endif
+
+    TaskTiming_Update(kTask_Loop, loopStart);
 }
@@ -0,0 +1,144 @@
+///
+/// \file       warmrestart.cpp
+/// \brief      The Lung Carburetor Firmware warm restart module
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    warmrestart
+#include "warmrestart.h"
+#include "datamodel.h"
+#include "configuration.h"
+#include "control.h"
+
+/// \enum eWarmRestartConsts
+/// \brief Warm restart constants
+enum eWarmRestartConsts
+{
+    kWarmRestartMaxCount    = 3,    ///> Consecutive restores without a respiration before defaults are used, breaks reset loops
+    kWatchdogMark           = 0xA5C3,   ///> Main loop stalled until the watchdog interrupt
+};
+
+/// \struct tWarmRestart
+/// \brief Ventilation settings and cycle state kept across resets
+struct tWarmRestart
+{
+    uint16_t            nSize;                      ///> sizeof(tWarmRestart), rejects a snapshot of another firmware layout
+    uint8_t             nRestoreCount;              ///> Consecutive restores without a respiration
+    bool                bStartFlag;                 ///> Respiration cycle started
+    uint8_t             nControlMode;               ///> eControlMode
+    uint8_t             nTriggerMode;               ///> eTriggerMode
+    float               fRespirationPerMinute;      ///> Respiration rate
+    float               fInhalePressureTarget_mmH2O;///> Inhale pressure target
+    float               fExhalePressureTarget_mmH2O;///> Exhale pressure target
+    float               fInhaleRatio;               ///> Inhale ratio
+    float               fExhaleRatio;               ///> Exhale ratio
+    uint32_t            nRespirationCount;          ///> Respirations since ventilation start
+    tRespirationCurves  pCurves;                    ///> Active curves
+    uint32_t            nCRC;                       ///> CRC32 of the snapshot, computed with this field cleared
+};
+
+// Not cleared by the C runtime at reset, content is random at power up
+static tWarmRestart gWarmRestart __attribute__((section(".noinit")));
+
+// Set by the watchdog interrupt, the reset that follows is a stall of the main loop
+static uint16_t gWatchdogMark __attribute__((section(".noinit")));
+
+// Respiration count restored at boot, restores are counted until ventilation goes past it
+static uint32_t gRestoredRespirationCount = 0;
+static uint8_t  gRestoreCount = 0;
+
+static uint32_t ComputeCRC()
+{
+    uint32_t crc        = gWarmRestart.nCRC;
+    gWarmRestart.nCRC   = 0; // Clear CRC for computation
+    uint32_t newCRC     = CRC32(reinterpret_cast<uint8_t*>(&gWarmRestart), sizeof(tWarmRestart));
+    gWarmRestart.nCRC   = crc;
+
+    return newCRC;
+}
+
+// First watchdog timeout: main loop stalled, the next timeout resets
+ISR(WDT_vect)
+{
+    gWatchdogMark = kWatchdogMark;
+}
+
+bool WarmRestart_Restore(uint8_t nResetFlags)
+{
+    // The watchdog alone, and after its interrupt. Optiboot also ends with a watchdog reset after an external
+    // or serial port reset, without the interrupt since the sketch wasn't running.
+    bool bWatchdog  = (nResetFlags & (_BV(WDRF) | _BV(EXTRF) | _BV(PORF) | _BV(BORF))) == _BV(WDRF) &&
+                      gWatchdogMark == kWatchdogMark;
+    gWatchdogMark   = 0;
+
+    bool bValid = bWatchdog &&
+                  gWarmRestart.nSize == sizeof(tWarmRestart) &&
+                  gWarmRestart.nCRC == ComputeCRC() &&
+                  gWarmRestart.nRestoreCount < kWarmRestartMaxCount &&
+                  gWarmRestart.nControlMode < kControlMode_Count &&
+                  gWarmRestart.nTriggerMode < kTriggerMode_Count &&
+                  gWarmRestart.pCurves.pInhaleCurve.nCount <= kMaxCurveCount &&
+                  gWarmRestart.pCurves.pExhaleCurve.nCount <= kMaxCurveCount;
+
+    if (!bValid)
+    {
+        WarmRestart_Invalidate();
+        return false;
+    }
+
+    gDataModel.bStartFlag                   = gWarmRestart.bStartFlag;
+    gDataModel.nControlMode                 = static_cast<eControlMode>(gWarmRestart.nControlMode);
+    gDataModel.nTriggerMode                 = static_cast<eTriggerMode>(gWarmRestart.nTriggerMode);
+    gDataModel.fInhalePressureTarget_mmH2O  = gWarmRestart.fInhalePressureTarget_mmH2O;
+    gDataModel.fExhalePressureTarget_mmH2O  = gWarmRestart.fExhalePressureTarget_mmH2O;
+    gDataModel.fInhaleRatio                 = gWarmRestart.fInhaleRatio;
+    gDataModel.fExhaleRatio                 = gWarmRestart.fExhaleRatio;
+    gDataModel.nRespirationCount            = gWarmRestart.nRespirationCount;
+    gDataModel.pCurves[gDataModel.nActiveCurves] = gWarmRestart.pCurves;
+
+    gDataModel.fRespirationPerMinute        = gWarmRestart.fRespirationPerMinute;
+    Control_SetRespirationRate(gDataModel.fRespirationPerMinute);
+    gDataModel.nRespirationDeadline_us      = micros() + gDataModel.nRespirationPeriod_us;
+
+    // The interrupted respiration is not resumed, pressure was lost during reset; a new cycle starts after warmup
+    gRestoredRespirationCount   = gWarmRestart.nRespirationCount;
+    gRestoreCount               = gWarmRestart.nRestoreCount + 1;
+
+    // Counted now, a reset before the next snapshot still counts this restore
+    gWarmRestart.nRestoreCount  = gRestoreCount;
+    gWarmRestart.nCRC           = ComputeCRC();
+
+    return true;
+}
+
+void WarmRestart_Save()
+{
+    // Main loop is running, a watchdog interrupt before a stall is not one; arm it again for the next stall
+    gWatchdogMark   = 0;
+    WDTCSR         |= _BV(WDIE);
+
+    // Restores are not counted anymore once ventilation went on after one
+    if (gRestoreCount > 0 && gDataModel.nRespirationCount != gRestoredRespirationCount)
+    {
+        gRestoreCount = 0;
+    }
+
+    gWarmRestart.nSize                          = sizeof(tWarmRestart);
+    gWarmRestart.nRestoreCount                  = gRestoreCount;
+    gWarmRestart.bStartFlag                     = gDataModel.bStartFlag;
+    gWarmRestart.nControlMode                   = gDataModel.nControlMode;
+    gWarmRestart.nTriggerMode                   = gDataModel.nTriggerMode;
+    gWarmRestart.fRespirationPerMinute          = gDataModel.fRespirationPerMinute;
+    gWarmRestart.fInhalePressureTarget_mmH2O    = gDataModel.fInhalePressureTarget_mmH2O;
+    gWarmRestart.fExhalePressureTarget_mmH2O    = gDataModel.fExhalePressureTarget_mmH2O;
+    gWarmRestart.fInhaleRatio                   = gDataModel.fInhaleRatio;
+    gWarmRestart.fExhaleRatio                   = gDataModel.fExhaleRatio;
+    gWarmRestart.nRespirationCount              = gDataModel.nRespirationCount;
+    gWarmRestart.pCurves                        = *DataModel_GetActiveCurves();
+    gWarmRestart.nCRC                           = 0;
+    gWarmRestart.nCRC                           = ComputeCRC();
+}
+
+void WarmRestart_Invalidate()
+{
+    memset(&gWarmRestart, 0, sizeof(tWarmRestart));
+}
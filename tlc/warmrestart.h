@@ -0,0 +1,38 @@
+///
+/// \file       warmrestart.h
+/// \brief      The Lung Carburetor Firmware warm restart module
+///
+/// Ventilation settings and cycle state are kept in a RAM snapshot the C runtime doesn't clear at reset
+/// (.noinit). After a watchdog or external reset a valid snapshot is restored in place, so ventilation resumes
+/// after warmup without waiting for the controller to send every setting again. The snapshot is guarded by a
+/// CRC32 and its size.
+///
+/// Only a watchdog reset caused by a stalled main loop restores it. The watchdog runs in interrupt and reset
+/// mode: its first timeout interrupt marks the stall, the second one resets. An external reset, the serial port
+/// auto-reset, a power up or a brown-out boot with defaults, even when the bootloader ends with its own watchdog
+/// timeout.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   warmrestart Warm restart
+#ifndef TLC_WARMRESTART_H
+#define TLC_WARMRESTART_H
+
+#include "common.h"
+
+/// \fn bool WarmRestart_Restore(uint8_t nResetFlags)
+/// \brief Restore the snapshot into the datamodel if valid after a watchdog reset, after Control_Init
+/// \param nResetFlags MCUSR at boot, only a watchdog reset flag keeps the snapshot
+/// \return true if ventilation settings were restored
+bool WarmRestart_Restore(uint8_t nResetFlags);
+
+/// \fn void WarmRestart_Save()
+/// \brief Snapshot current ventilation settings and cycle state, called periodically from the main loop
+///
+/// Also arms the watchdog interrupt marking a stall of the main loop.
+void WarmRestart_Save();
+
+/// \fn void WarmRestart_Invalidate()
+/// \brief Discard the snapshot, next reset boots with defaults
+void WarmRestart_Invalidate();
+
+#endif // TLC_WARMRESTART_H
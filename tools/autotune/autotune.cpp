@@ -0,0 +1,523 @@
+///
+/// \file       autotune.cpp
+/// \brief      Offline pressure PID auto-tuner on the host simulator
+///
+/// Searches fGainP, fGainI and fGainD of every gain set (eGainSet), fILimit and fPILimit against the
+/// plant model over a set of lungs. Every candidate runs the firmware control code on every lung for a
+/// few respirations and is scored by its pressure tracking error. A coarse log-spaced grid of gains
+/// shared by every gain set is refined by a pattern search on the gains of each gain set and the limits.
+/// Sessions run in parallel child processes, one worker thread per core. The result is a tracking error
+/// report and the SGP (P, I, D of every gain set), SLP and CSV command frames to apply it.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "simulator.h"
+#include "runner.h"
+
+#include "configuration.h"
+#include "control.h"
+#include "datamodel.h"
+#include "serialportreader.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// \struct tLung
+/// \brief Lung of the tuning set
+struct tLung
+{
+    const char* szName;             ///> Report name
+    float       fCompliance;        ///> mL/mmH2O
+    float       fResistance;        ///> mmH2O/(mL/s)
+    float       fLeakResistance;    ///> mmH2O/(mL/s), 0 for none
+};
+
+static const tLung kLungs[] =
+{
+    { "normal",         5.0f,   0.10f,  0.0f },     // 50 mL/cmH2O, 10 cmH2O/(L/s)
+    { "stiff",          2.0f,   0.10f,  0.0f },     // ARDS
+    { "obstructive",    6.0f,   0.25f,  0.0f },     // COPD
+    { "leaky",          5.0f,   0.10f,  2.5f },     // Mask or cuff leak
+    { "small",          1.5f,   0.20f,  0.0f },     // Pediatric
+};
+static const int kLungCount = sizeof(kLungs) / sizeof(kLungs[0]);
+
+/// \struct tProfile
+/// \brief Respiration profile of the sessions
+struct tProfile
+{
+    float       fInhale_mmH2O;      ///> Inhale pressure target
+    float       fExhale_mmH2O;      ///> Exhale pressure target (PEEP)
+    float       fRate;              ///> Respirations per minute
+    float       fExhaleRatio;       ///> Exhale time over inhale time
+    int         nSettleBreaths;     ///> Respirations before measuring
+    int         nMeasureBreaths;    ///> Measured respirations
+};
+
+/// \struct tCandidate
+/// \brief Tuned parameters
+struct tCandidate
+{
+    tGains      pGains[kGainSet_Count];     ///> Gains of every eGainSet
+    float       fILimit;                    ///> Integral limit
+    float       fPILimit;                   ///> Output limit
+};
+
+/// \enum eAutotuneConsts
+/// \brief Tuner constants
+enum eAutotuneConsts
+{
+    kGainParameterCount = 3 * kGainSet_Count,           ///> P, I, D of every gain set
+    kParameterCount     = kGainParameterCount + 2,      ///> Gains, then fILimit and fPILimit
+};
+
+static const char* const kGainSetNames[kGainSet_Count] = { "hold", "rise", "plateau", "exhale" };
+
+/// \struct tScore
+/// \brief Tracking error of a candidate on a lung, or over every lung
+struct tScore
+{
+    float       fRms_mmH2O;         ///> RMS pressure tracking error
+    float       fOvershoot_mmH2O;   ///> Worst overshoot past the target in the direction of the step
+    float       fPeak_mmH2O;        ///> Worst absolute tracking error
+    int         nErrors;            ///> Sessions that stopped ventilating in kState_Error, or failed
+    float       fCost;              ///> Search objective
+};
+
+/// \struct tResult
+/// \brief Scored candidate
+struct tResult
+{
+    tCandidate  candidate;
+    tScore      total;
+    tScore      pLungs[kLungCount];
+};
+
+const float kOvershootWeight    = 0.5f;     // Cost of a mmH2O of overshoot, in mmH2O of RMS error
+const float kErrorCost          = 1000.0f;  // Cost of a session stopped by safeties
+const float kDerivativeSeed     = 0.1f;     // First fGainD tried from 0, as a fraction of fGainP of the gain set
+
+/// \struct tTracking
+/// \brief Tracking error accumulated by the session observer
+struct tTracking
+{
+    const tProfile* pProfile;
+    uint32_t        nLastControlTick;
+    double          fSumSquares;
+    uint32_t        nSamples;
+    float           fOvershoot;
+    float           fPeak;
+    bool            bError;
+};
+
+// Tuned parameter by index: P, I, D of every gain set in eGainSet order, then fILimit and fPILimit
+static float& Parameter(tCandidate& candidate, int nParameter)
+{
+    if (nParameter < kGainParameterCount)
+    {
+        tGains& gains = candidate.pGains[nParameter / 3];
+        float* pGains[] = { &gains.fP, &gains.fI, &gains.fD };
+        return *pGains[nParameter % 3];
+    }
+    return nParameter == kGainParameterCount ? candidate.fILimit : candidate.fPILimit;
+}
+
+static float Parameter(const tCandidate& candidate, int nParameter)
+{
+    return Parameter(const_cast<tCandidate&>(candidate), nParameter);
+}
+
+static bool SameCandidate(const tCandidate& a, const tCandidate& b)
+{
+    for (int parameter = 0; parameter < kParameterCount; ++parameter)
+    {
+        if (Parameter(a, parameter) != Parameter(b, parameter))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Gains of every gain set, in eGainSet order, as the extended SGP takes them
+static std::vector<float> GainValues(const tCandidate& candidate)
+{
+    std::vector<float> values;
+    for (int parameter = 0; parameter < kGainParameterCount; ++parameter)
+    {
+        values.push_back(Parameter(candidate, parameter));
+    }
+    return values;
+}
+
+// Called after every loop iteration, samples the plant pressure against the set-point at every control tick
+static void Observe(void* pContext)
+{
+    tTracking& tracking = *static_cast<tTracking*>(pContext);
+    if (gDataModel.nState == kState_Error)
+    {
+        tracking.bError = true;
+    }
+
+    if (gDataModel.nTickControl == tracking.nLastControlTick)
+    {
+        return;
+    }
+    tracking.nLastControlTick = gDataModel.nTickControl;
+
+    const tProfile& profile = *tracking.pProfile;
+    uint32_t breaths = gDataModel.nRespirationCount;
+    if (breaths <= (uint32_t)profile.nSettleBreaths || breaths > (uint32_t)(profile.nSettleBreaths + profile.nMeasureBreaths))
+    {
+        return;
+    }
+
+    float error = gPlant.fPressure_mmH2O - gDataModel.fRequestPressure_mmH2O;
+    tracking.fSumSquares += (double)error * error;
+    ++tracking.nSamples;
+    tracking.fPeak = std::max(tracking.fPeak, fabsf(error));
+
+    if (gDataModel.nCycleState == kCycleState_Inhale)
+    {
+        tracking.fOvershoot = std::max(tracking.fOvershoot, gPlant.fPressure_mmH2O - profile.fInhale_mmH2O);
+    }
+    else if (gDataModel.nCycleState == kCycleState_Exhale)
+    {
+        tracking.fOvershoot = std::max(tracking.fOvershoot, profile.fExhale_mmH2O - gPlant.fPressure_mmH2O);
+    }
+}
+
+// Send a command and require its ACK
+static bool Command(const std::string& szFrame)
+{
+    std::string reply;
+    return Simulator_Command(szFrame, reply) && reply == "ACK";
+}
+
+// Child process: one session of a candidate on a lung, prints its score
+static int RunSession(int nLung, const tCandidate& candidate, const tProfile& profile)
+{
+    const tLung& lung = kLungs[nLung];
+    tPlantParams params = Plant_DefaultParams();
+    params.fCompliance          = lung.fCompliance;
+    params.fAirwayResistance    = lung.fResistance;
+    params.fLeakResistance      = lung.fLeakResistance;
+
+    Simulator_Init(params, 1 + nLung);
+    Simulator_Run(kPeriodWarmup, nullptr, nullptr);
+
+    // Profile is set in the data model as CUR does once validated, CUR bounds don't cover therapy pressures in mmH2O
+    Control_SetRespirationRate(profile.fRate);
+    gDataModel.fInhalePressureTarget_mmH2O = profile.fInhale_mmH2O;
+    gDataModel.fExhalePressureTarget_mmH2O = profile.fExhale_mmH2O;
+    gDataModel.fInhaleRatio                = 1.0f;
+    gDataModel.fExhaleRatio                = profile.fExhaleRatio;
+    updateCurve();
+
+    int8_t start = 1;
+    if (!Command(Simulator_Frame("SGP", GainValues(candidate))) ||
+        !Command(Simulator_Frame("SLP", { candidate.fILimit, candidate.fPILimit })) ||
+        !Command(Simulator_FrameBytes("CYC", &start, sizeof(start))))
+    {
+        return 1;
+    }
+
+    tTracking tracking = {};
+    tracking.pProfile = &profile;
+    float period_ms = 60000.0f / profile.fRate;
+    Simulator_Run((uint32_t)(period_ms * (profile.nSettleBreaths + profile.nMeasureBreaths + 1)), Observe, &tracking);
+
+    float rms = tracking.nSamples > 0 ? (float)sqrt(tracking.fSumSquares / tracking.nSamples) : kErrorCost;
+    printf("%f %f %f %d\n", rms, tracking.fOvershoot, tracking.fPeak, (tracking.bError || tracking.nSamples == 0) ? 1 : 0);
+    return 0;
+}
+
+static std::string SessionCommand(const std::string& szSelf, int nLung, const tCandidate& candidate, const tProfile& profile)
+{
+    std::string command = "'" + szSelf + "' --run " + std::to_string(nLung);
+    char value[32];
+    for (int parameter = 0; parameter < kParameterCount; ++parameter)
+    {
+        snprintf(value, sizeof(value), " %.9g", Parameter(candidate, parameter));
+        command += value;
+    }
+
+    char options[160];
+    snprintf(options, sizeof(options), " --inhale %g --exhale %g --rate %g --ie %g --settle %d --measure %d",
+             profile.fInhale_mmH2O, profile.fExhale_mmH2O, profile.fRate, profile.fExhaleRatio, profile.nSettleBreaths, profile.nMeasureBreaths);
+    return command + options;
+}
+
+static void FinishScore(tScore& score)
+{
+    score.fCost = score.fRms_mmH2O + kOvershootWeight * std::max(score.fOvershoot_mmH2O, 0.0f) + kErrorCost * score.nErrors;
+}
+
+// Score candidates on every lung in parallel sessions
+static std::vector<tResult> Evaluate(const std::vector<tCandidate>& candidates, const tProfile& profile, unsigned nThreads)
+{
+    std::string self = Runner_Self();
+    std::vector<std::string> commands;
+    for (const tCandidate& candidate : candidates)
+    {
+        for (int lung = 0; lung < kLungCount; ++lung)
+        {
+            commands.push_back(SessionCommand(self, lung, candidate, profile));
+        }
+    }
+
+    std::vector<std::string> outputs = Runner_Map(commands, nThreads);
+
+    std::vector<tResult> results(candidates.size());
+    for (size_t c = 0; c < candidates.size(); ++c)
+    {
+        tResult& result = results[c];
+        result.candidate = candidates[c];
+        result.total = tScore();
+        for (int lung = 0; lung < kLungCount; ++lung)
+        {
+            tScore& score = result.pLungs[lung];
+            int error = 1;
+            if (sscanf(outputs[c * kLungCount + lung].c_str(), "%f %f %f %d", &score.fRms_mmH2O, &score.fOvershoot_mmH2O, &score.fPeak_mmH2O, &error) != 4)
+            {
+                score = tScore();
+                score.fRms_mmH2O = kErrorCost;
+            }
+            score.nErrors = error;
+            FinishScore(score);
+
+            result.total.fRms_mmH2O       += score.fRms_mmH2O / kLungCount;
+            result.total.fOvershoot_mmH2O += std::max(score.fOvershoot_mmH2O, 0.0f) / kLungCount;
+            result.total.fPeak_mmH2O       = std::max(result.total.fPeak_mmH2O, score.fPeak_mmH2O);
+            result.total.nErrors          += score.nErrors;
+        }
+        FinishScore(result.total);
+    }
+
+    return results;
+}
+
+// Log-spaced values from fLow to fHigh
+static std::vector<float> LogSpace(float fLow, float fHigh, int nCount)
+{
+    std::vector<float> values;
+    for (int a = 0; a < nCount; ++a)
+    {
+        values.push_back(nCount > 1 ? fLow * powf(fHigh / fLow, (float)a / (nCount - 1)) : fLow);
+    }
+    return values;
+}
+
+static void PrintResult(const char* szLabel, const tResult& result)
+{
+    printf("%-10s ILimit=%-7.4g PILimit=%-7.4g  rms=%7.2f overshoot=%7.2f peak=%7.2f errors=%d cost=%.2f\n",
+           szLabel, result.candidate.fILimit, result.candidate.fPILimit,
+           result.total.fRms_mmH2O, result.total.fOvershoot_mmH2O, result.total.fPeak_mmH2O, result.total.nErrors, result.total.fCost);
+    for (int set = 0; set < kGainSet_Count; ++set)
+    {
+        const tGains& gains = result.candidate.pGains[set];
+        printf("%-10s   %-8s P=%-9.4g I=%-9.4g D=%-9.4g\n", "", kGainSetNames[set], gains.fP, gains.fI, gains.fD);
+    }
+}
+
+static void PrintFrame(const char* szText, const std::string& szFrame)
+{
+    printf("%-40s", szText);
+    for (unsigned char byte : szFrame)
+    {
+        printf(" %02X", byte);
+    }
+    printf("\n");
+
+    // The parser splits frames at CRLF, a value whose bytes contain it can't be sent as is
+    if (szFrame.find("\r\n") != szFrame.size() - 2)
+    {
+        printf("%-40s warning: a value encodes a CRLF, nudge it before sending\n", "");
+    }
+}
+
+static void Usage()
+{
+    printf("usage: tlc_autotune [--threads N] [--quick] [--refine N] [--emit FILE]\n"
+           "                    [--inhale mmH2O] [--exhale mmH2O] [--rate BPM] [--ie RATIO] [--settle N] [--measure N]\n");
+}
+
+int main(int argc, char** argv)
+{
+    tProfile profile = { 250.0f, 50.0f, 20.0f, 2.0f, 2, 3 };
+    unsigned threads = Runner_DefaultThreads();
+    int refine = 12;
+    bool quick = false;
+    const char* szEmit = nullptr;
+    int runLung = -1;
+    tCandidate runCandidate = {};
+
+    for (int a = 1; a < argc; ++a)
+    {
+        bool bValue = a + 1 < argc;
+        if (!strcmp(argv[a], "--run") && a + 1 + kParameterCount < argc)
+        {
+            runLung = atoi(argv[++a]);
+            for (int parameter = 0; parameter < kParameterCount; ++parameter)
+            {
+                Parameter(runCandidate, parameter) = atof(argv[++a]);
+            }
+        }
+        else if (!strcmp(argv[a], "--threads") && bValue)   threads = std::max(atoi(argv[++a]), 1);
+        else if (!strcmp(argv[a], "--refine") && bValue)    refine = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "--emit") && bValue)      szEmit = argv[++a];
+        else if (!strcmp(argv[a], "--inhale") && bValue)    profile.fInhale_mmH2O = atof(argv[++a]);
+        else if (!strcmp(argv[a], "--exhale") && bValue)    profile.fExhale_mmH2O = atof(argv[++a]);
+        else if (!strcmp(argv[a], "--rate") && bValue)      profile.fRate = atof(argv[++a]);
+        else if (!strcmp(argv[a], "--ie") && bValue)        profile.fExhaleRatio = atof(argv[++a]);
+        else if (!strcmp(argv[a], "--settle") && bValue)    profile.nSettleBreaths = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "--measure") && bValue)   profile.nMeasureBreaths = std::max(atoi(argv[++a]), 1);
+        else if (!strcmp(argv[a], "--quick"))               quick = true;
+        else
+        {
+            Usage();
+            return 2;
+        }
+    }
+
+    if (runLung >= 0)
+    {
+        return runLung < kLungCount ? RunSession(runLung, runCandidate, profile) : 2;
+    }
+
+    // Firmware defaults, the reference of the report
+    Configuration_SetDefaults();
+    tCandidate defaultCandidate = {};
+    for (int set = 0; set < kGainSet_Count; ++set)
+    {
+        defaultCandidate.pGains[set] = gConfiguration.pGains[set];
+    }
+    defaultCandidate.fILimit  = gConfiguration.fILimit;
+    defaultCandidate.fPILimit = gConfiguration.fPILimit;
+
+    // Coarse grid around the firmware defaults (P 250.5, I 0.01, ILimit 5, PILimit 1000), same gains on every gain set
+    std::vector<tCandidate> grid;
+    for (float p : LogSpace(1.0f, 500.0f, quick ? 3 : 6))
+        for (float i : LogSpace(0.001f, 1.0f, quick ? 3 : 5))
+            for (float iLimit : LogSpace(5.0f, 500.0f, quick ? 2 : 3))
+                for (float piLimit : LogSpace(quick ? 1023.0f : 400.0f, 1023.0f, quick ? 1 : 2))
+                {
+                    tCandidate candidate = {};
+                    for (tGains& gains : candidate.pGains)
+                    {
+                        gains = { p, i, 0.0f };
+                    }
+                    candidate.fILimit  = iLimit;
+                    candidate.fPILimit = piLimit;
+                    grid.push_back(candidate);
+                }
+
+    printf("Profile: inhale %g mmH2O, exhale %g mmH2O, %g/min, I:E 1:%g, %d settling and %d measured respirations\n",
+           profile.fInhale_mmH2O, profile.fExhale_mmH2O, profile.fRate, profile.fExhaleRatio, profile.nSettleBreaths, profile.nMeasureBreaths);
+    printf("Grid: %zu candidates x %d lungs on %u workers\n", grid.size(), kLungCount, threads);
+    fflush(stdout);
+
+    std::vector<tResult> results = Evaluate(grid, profile, threads);
+    std::vector<tResult> defaults = Evaluate({ defaultCandidate }, profile, threads);
+
+    auto byCost = [](const tResult& a, const tResult& b) { return a.total.fCost < b.total.fCost; };
+    tResult best = *std::min_element(results.begin(), results.end(), byCost);
+
+    // Pattern search: scale every parameter of every gain set up and down around the best, halve the step when
+    // nothing improves. A zero fGainD is first tried at kDerivativeSeed of the gain set fGainP.
+    float step = 2.0f;
+    for (int iteration = 0; iteration < refine; ++iteration)
+    {
+        std::vector<tCandidate> neighbours;
+        for (int parameter = 0; parameter < kParameterCount; ++parameter)
+        {
+            for (float factor : { step, 1.0f / step })
+            {
+                tCandidate candidate = best.candidate;
+                float& value = Parameter(candidate, parameter);
+                value *= factor;
+                if (value == 0.0f && parameter < kGainParameterCount && parameter % 3 == 2 && factor > 1.0f)
+                {
+                    value = kDerivativeSeed * candidate.pGains[parameter / 3].fP;
+                }
+                candidate.fPILimit = std::min(candidate.fPILimit, 1023.0f);
+
+                // Don't evaluate a candidate twice, the limit clamp, a zero fGainD and step halving revisit points
+                bool bSeen = std::any_of(results.begin(), results.end(), [&](const tResult& result)
+                {
+                    return SameCandidate(result.candidate, candidate);
+                });
+                if (!bSeen)
+                {
+                    neighbours.push_back(candidate);
+                }
+            }
+        }
+
+        if (neighbours.empty())
+        {
+            step = sqrtf(step);
+            continue;
+        }
+
+        std::vector<tResult> refined = Evaluate(neighbours, profile, threads);
+        results.insert(results.end(), refined.begin(), refined.end());
+        tResult candidate = *std::min_element(refined.begin(), refined.end(), byCost);
+        if (candidate.total.fCost < best.total.fCost)
+        {
+            best = candidate;
+        }
+        else
+        {
+            step = sqrtf(step);
+        }
+    }
+
+    std::sort(results.begin(), results.end(), byCost);
+    printf("\nBest candidates (%zu evaluated):\n", results.size());
+    for (size_t a = 0; a < std::min<size_t>(results.size(), 5); ++a)
+    {
+        std::string label = "#" + std::to_string(a + 1);
+        PrintResult(label.c_str(), results[a]);
+    }
+    PrintResult("defaults", defaults[0]);
+
+    printf("\nTracking error per lung, mmH2O:\n");
+    printf("%-12s %12s %12s %12s %12s\n", "lung", "rms", "overshoot", "peak", "defaults rms");
+    for (int lung = 0; lung < kLungCount; ++lung)
+    {
+        const tScore& score = best.pLungs[lung];
+        printf("%-12s %12.2f %12.2f %12.2f %12.2f%s\n", kLungs[lung].szName, score.fRms_mmH2O, score.fOvershoot_mmH2O, score.fPeak_mmH2O,
+               defaults[0].pLungs[lung].fRms_mmH2O, score.nErrors ? "  (stopped by safeties)" : "");
+    }
+
+    // Command set: P, I, D of every gain set, limits, then save to EEPROM
+    std::string sgp = Simulator_Frame("SGP", GainValues(best.candidate));
+    std::string slp = Simulator_Frame("SLP", { best.candidate.fILimit, best.candidate.fPILimit });
+    std::string csv = Simulator_Frame("CSV", {});
+
+    char text[64];
+    printf("\nCommand set:\n");
+    PrintFrame("SGP P I D x hold rise plateau exhale", sgp);
+    snprintf(text, sizeof(text), "SLP %.6g %.6g", best.candidate.fILimit, best.candidate.fPILimit);
+    PrintFrame(text, slp);
+    PrintFrame("CSV", csv);
+
+    if (szEmit != nullptr)
+    {
+        FILE* pFile = fopen(szEmit, "wb");
+        if (pFile == nullptr)
+        {
+            fprintf(stderr, "tlc_autotune: can't write %s\n", szEmit);
+            return 1;
+        }
+        std::string frames = sgp + slp + csv;
+        fwrite(frames.data(), 1, frames.size(), pFile);
+        fclose(pFile);
+        printf("Frames written to %s\n", szEmit);
+    }
+
+    return 0;
+}
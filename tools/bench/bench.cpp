@@ -0,0 +1,275 @@
+///
+/// \file       bench.cpp
+/// \brief      Micro-benchmarks of the firmware hot paths on the host
+///
+/// Times the hot paths the BEN command times on the device, plus the sensor fusion, with the host clock.
+/// Host numbers don't give the AVR cost, they track its trend between revisions: a change that slows a
+/// path here slows it on the device. Every path runs from the state of a warmed up simulator, restored
+/// after every sample. Iterations are scaled until a sample takes --min-time, the median of --repeat
+/// samples is reported in ns/op. --json writes the results for a benchmark tracker, as a list of
+/// { "name", "unit", "value" } entries, smaller is better.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "simulator.h"
+
+#include "buzzer.h"
+#include "configuration.h"
+#include "control.h"
+#include "datamodel.h"
+#include "safeties.h"
+#include "sensorfusion.h"
+#include "sensors.h"
+#include "serialportreader.h"
+#include "warmrestart.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// \struct tBenchCase
+/// \brief Benchmarked path
+struct tBenchCase
+{
+    const char* szName;                         ///> Report name, as printed by BEN
+    void        (*pRun)(uint32_t nIterations);  ///> Calls the path nIterations times
+};
+
+/// \struct tBenchResult
+/// \brief Timing of a path
+struct tBenchResult
+{
+    double      fMedian_ns;         ///> Median of the samples, ns per call
+    double      fMin_ns;            ///> Fastest sample, ns per call
+    uint32_t    nIterations;        ///> Calls per sample
+};
+
+static volatile float gSink;        // Keeps results of pure functions from being optimized out
+
+static void BenchControlPID(uint32_t nIterations)
+{
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        Control_PID();
+    }
+}
+
+// Respiration set-point while waiting for a timed trigger, never starts a respiration
+static void BenchComputeRespirationSetPoint(uint32_t nIterations)
+{
+    gDataModel.nTriggerMode             = kTriggerMode_Timed;
+    gDataModel.nCycleState              = kCycleState_WaitTrigger;
+    gDataModel.nRespirationDeadline_us  = micros() + 60000000UL;
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        Control_ComputeRespirationSetPoint();
+    }
+}
+
+// Lookup of every opcode in turn, time per lookup
+static void BenchFindCommand(uint32_t nIterations)
+{
+    static char szNames[64][4];
+    static uint8_t nCount = 0;
+    for (bool bLoad = nCount == 0; bLoad && nCount < 64 && GetCommandName(nCount + 1, szNames[nCount]); )
+    {
+        ++nCount;
+    }
+
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        gSink = FindCommand(reinterpret_cast<const uint8_t*>(szNames[a % nCount]));
+    }
+}
+
+// Curve update from current settings, fills and commits the same shadow curves again
+static void BenchUpdateCurve(uint32_t nIterations)
+{
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        updateCurve();
+    }
+}
+
+static void BenchPressureTransfer(uint32_t nIterations)
+{
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        gSink = Sensors_PressureTransfer(static_cast<float>(a & 0x3FF));
+    }
+}
+
+// Safeties evaluate rules on new samples only, every call sees a new one
+static void BenchSafeties(uint32_t nIterations)
+{
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        ++gDataModel.nSampleCount;
+        Safeties_Process();
+    }
+}
+
+// Healthy channels with the noise of the ADC, every sample runs the attribution tests
+static void BenchSensorFusion(uint32_t nIterations)
+{
+    float fused;
+    uint16_t spread;
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        uint16_t raw[kPressureChannelCount];
+        for (uint8_t b = 0; b < kPressureChannelCount; ++b)
+        {
+            raw[b] = static_cast<uint16_t>(200 + ((a + b) & 0x03));
+        }
+        SensorFusion_Process(raw, 0, fused, spread);
+        gSink = fused;
+    }
+}
+
+static void BenchCRC32(uint32_t nIterations)
+{
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        gSink = CRC32(reinterpret_cast<uint8_t*>(&gConfiguration), sizeof(tConfiguration));
+    }
+}
+
+static void BenchWarmRestartSave(uint32_t nIterations)
+{
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        WarmRestart_Save();
+    }
+}
+
+static void BenchBuzzer(uint32_t nIterations)
+{
+    for (uint32_t a = 0; a < nIterations; ++a)
+    {
+        Buzzer_Process();
+    }
+}
+
+static const tBenchCase kBenchCases[] =
+{
+    { "Control_PID",                BenchControlPID },
+    { "ComputeRespirationSetPoint", BenchComputeRespirationSetPoint },
+    { "FindCommand",                BenchFindCommand },
+    { "updateCurve",                BenchUpdateCurve },
+    { "Sensors_PressureTransfer",   BenchPressureTransfer },
+    { "Safeties_Process",           BenchSafeties },
+    { "SensorFusion_Process",       BenchSensorFusion },
+    { "CRC32",                      BenchCRC32 },
+    { "WarmRestart_Save",           BenchWarmRestartSave },
+    { "Buzzer_Process",             BenchBuzzer },
+};
+
+// Firmware state the paths run from, restored before every sample so each one sees the same work
+static tDataModel gSnapshot;
+
+static void Restore()
+{
+    memcpy(static_cast<void*>(&gDataModel), &gSnapshot, sizeof(tDataModel));
+}
+
+// Elapsed ns of nIterations calls from the snapshot
+static double Sample(const tBenchCase& bench, uint32_t nIterations)
+{
+    Restore();
+    auto start = std::chrono::steady_clock::now();
+    bench.pRun(nIterations);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+static tBenchResult Measure(const tBenchCase& bench, double fMinTime_ns, int nRepeat)
+{
+    // Double the iterations until a sample takes the minimum time
+    uint32_t iterations = 1;
+    while (iterations < (1u << 30) && Sample(bench, iterations) < fMinTime_ns)
+    {
+        iterations *= 2;
+    }
+
+    std::vector<double> samples;
+    for (int a = 0; a < nRepeat; ++a)
+    {
+        samples.push_back(Sample(bench, iterations) / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    tBenchResult result;
+    result.fMedian_ns   = samples[samples.size() / 2];
+    result.fMin_ns      = samples.front();
+    result.nIterations  = iterations;
+    return result;
+}
+
+static void Usage()
+{
+    printf("usage: tlc_bench [--min-time MS] [--repeat N] [--filter TEXT] [--json FILE]\n");
+}
+
+int main(int argc, char** argv)
+{
+    double minTime_ms = 50.0;
+    int repeat = 5;
+    const char* szFilter = nullptr;
+    const char* szJson = nullptr;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        bool bValue = a + 1 < argc;
+        if (!strcmp(argv[a], "--min-time") && bValue)       minTime_ms = std::max(atof(argv[++a]), 0.001);
+        else if (!strcmp(argv[a], "--repeat") && bValue)    repeat = std::max(atoi(argv[++a]), 1);
+        else if (!strcmp(argv[a], "--filter") && bValue)    szFilter = argv[++a];
+        else if (!strcmp(argv[a], "--json") && bValue)      szJson = argv[++a];
+        else
+        {
+            Usage();
+            return 2;
+        }
+    }
+
+    // Warmed up device, waiting to start respiration
+    Simulator_Init(Plant_DefaultParams(), 1);
+    Simulator_Run(kPeriodWarmup, nullptr, nullptr);
+    memcpy(&gSnapshot, static_cast<const void*>(&gDataModel), sizeof(tDataModel));
+
+    std::string json = "[\n";
+    printf("%-28s %12s %12s %12s\n", "path", "ns/op", "min ns/op", "iterations");
+    for (const tBenchCase& bench : kBenchCases)
+    {
+        if (szFilter != nullptr && strstr(bench.szName, szFilter) == nullptr)
+        {
+            continue;
+        }
+
+        tBenchResult result = Measure(bench, minTime_ms * 1e6, repeat);
+        printf("%-28s %12.1f %12.1f %12u\n", bench.szName, result.fMedian_ns, result.fMin_ns, result.nIterations);
+        fflush(stdout);
+
+        char entry[256];
+        snprintf(entry, sizeof(entry), "%s  { \"name\": \"%s\", \"unit\": \"ns/op\", \"value\": %.2f, \"range\": \"min %.2f\", \"extra\": \"%u iterations x %d\" }",
+                 json.size() > 2 ? ",\n" : "", bench.szName, result.fMedian_ns, result.fMin_ns, result.nIterations, repeat);
+        json += entry;
+    }
+    json += "\n]\n";
+    Restore();
+
+    if (szJson != nullptr)
+    {
+        FILE* pFile = fopen(szJson, "w");
+        if (pFile == nullptr)
+        {
+            fprintf(stderr, "tlc_bench: can't write %s\n", szJson);
+            return 1;
+        }
+        fputs(json.c_str(), pFile);
+        fclose(pFile);
+    }
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+#!/bin/sh
+#
+# Per-symbol RAM and flash usage of the firmware, from the ELF exported by the Arduino IDE
+# (Sketch > Export compiled Binary) or arduino-cli compile --output-dir build. Needs the AVR binutils.
+#
+# Usage: footprint.sh build/tlc.ino.elf [MCU]
+
+ELF=$1
+MCU=${2:-atmega328p}
+
+if [ -z "$ELF" ] || [ ! -f "$ELF" ]; then
+    echo "usage: footprint.sh ELF [MCU], firmware ELF not found: '$ELF'" >&2
+    exit 2
+fi
+
+for TOOL in avr-size avr-nm; do
+    if ! command -v $TOOL >/dev/null 2>&1; then
+        echo "$TOOL not found, install the AVR binutils (bundled with the Arduino AVR core)" >&2
+        exit 2
+    fi
+done
+
+avr-size -C --mcu="$MCU" "$ELF" || exit 1
+
+# Symbols by decreasing size: address size type name, name can hold spaces once demangled
+SYMBOLS=$(avr-nm -C -S --size-sort -r --radix=d "$ELF") || exit 1
+
+echo "RAM symbols (.data, .bss)"
+echo "$SYMBOLS" | awk '$3 ~ /^[bBdD]$/ { name = $0; sub(/^[^ ]+ [^ ]+ [^ ]+ /, "", name); total += $2; printf "%8d  %s\n", $2, name }
+                      END { printf "%8d  total\n\n", total }'
+
+echo "Flash symbols (.text, PROGMEM)"
+echo "$SYMBOLS" | awk '$3 ~ /^[tTrR]$/ { name = $0; sub(/^[^ ]+ [^ ]+ [^ ]+ /, "", name); total += $2; printf "%8d  %s\n", $2, name }
+                      END { printf "%8d  total\n", total }'
@@ -0,0 +1,381 @@
+///
+/// \file       recovery.cpp
+/// \brief      Ventilation gap of the recovery from kState_Error on the host simulator
+///
+/// Runs ventilation sessions with randomized lung and profile, each stopped once by a latched alarm:
+/// a transient over pressure (high pressure limit lowered under the inhale target with AHP) or a sensor
+/// fault (pressure channel stuck on the high rail through the firmware fault injector). Once the alarm
+/// is raised the cause is removed, and the operator resets the alarm with ART after a random delay.
+/// The ventilation gap runs from the alarm to the first respiration after recovery: a resolved
+/// transient alarm resumes at the next respiration, a sensor fault goes through a warmup first. The
+/// gap the firmware reports with SST is checked against the one seen from the host. Sessions run in
+/// parallel child processes, one worker thread per core.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "simulator.h"
+#include "runner.h"
+#include "host.h"
+
+#include "configuration.h"
+#include "control.h"
+#include "datamodel.h"
+#include "faultinjection.h"
+#include "safeties.h"
+#include "serialportreader.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// \enum eRecoveryScenario
+/// \brief Cause of the error in a session
+enum eRecoveryScenario
+{
+    kRecovery_Pressure = 0,     ///> High pressure limit lowered under the inhale target, restored at the alarm
+    kRecovery_Sensor,           ///> Pressure channel stuck on the high rail, released at the alarm
+
+    kRecovery_Count
+};
+
+static const char* const kRecoveryNames[kRecovery_Count] = { "pressure", "sensor" };
+
+/// \enum eRecoveryConsts
+/// \brief Harness constants
+enum eRecoveryConsts
+{
+    kEventMin_ms        = 3000,     ///> Earliest error cause after ventilation starts
+    kEventSpread_ms     = 5000,     ///> Error cause is drawn within this time after the earliest
+    kResetMin_ms        = 200,      ///> Earliest operator reset after the alarm
+    kResetSpread_ms     = 3000,     ///> Operator reset is drawn within this time after the earliest
+};
+
+/// \struct tRecoveryScenario
+/// \brief Randomized session
+struct tRecoveryScenario
+{
+    int             nScenario;              ///> eRecoveryScenario
+    tPlantParams    params;                 ///> Plant
+    float           fInhale_mmH2O;          ///> Inhale pressure target
+    float           fExhale_mmH2O;          ///> Exhale pressure target
+    float           fRate;                  ///> Respirations per minute
+    uint32_t        nEvent_ms;              ///> Error cause, after ventilation starts
+    uint32_t        nResetDelay_ms;         ///> Operator reset, after the alarm
+};
+
+/// \struct tRecoverySession
+/// \brief Session observer state
+struct tRecoverySession
+{
+    const tRecoveryScenario* pScenario;
+    float           fLimit_mmH2O;           ///> High pressure limit to restore
+    uint32_t        nStart_ms;              ///> Ventilation start
+    bool            bCaused;                ///> Error cause applied
+    int64_t         nAlarm_ms;              ///> Alarm raised, -1 before
+    int64_t         nReset_ms;              ///> ART sent, -1 before
+    int64_t         nResume_ms;             ///> First respiration after recovery, -1 before
+    bool            bWarmup;                ///> Recovery went through a warmup
+    uint32_t        nRespirationCount;      ///> gDataModel.nRespirationCount at the reset
+};
+
+static float Uniform(std::mt19937& rng, float fLow, float fHigh)
+{
+    return std::uniform_real_distribution<float>(fLow, fHigh)(rng);
+}
+
+static float LogUniform(std::mt19937& rng, float fLow, float fHigh)
+{
+    return expf(Uniform(rng, logf(fLow), logf(fHigh)));
+}
+
+// Draw the scenario of a session from its seed, nForced (eRecoveryScenario) replaces the drawn cause when not negative
+static tRecoveryScenario DrawScenario(uint32_t nSeed, int nForced)
+{
+    std::mt19937 rng(nSeed);
+    tRecoveryScenario scenario = {};
+    scenario.nScenario = std::uniform_int_distribution<int>(0, kRecovery_Count - 1)(rng);
+    if (nForced >= 0)
+    {
+        scenario.nScenario = nForced;
+    }
+
+    tPlantParams& params = scenario.params;
+    params = Plant_DefaultParams();
+    params.fCompliance          = LogUniform(rng, 1.5f, 8.0f);
+    params.fAirwayResistance    = LogUniform(rng, 0.05f, 0.3f);
+    for (int a = 0; a < kPlantPressureChannelCount; ++a)
+    {
+        params.pSensors[a].fOffset_counts   = Uniform(rng, 35.0f, 47.0f);
+        params.pSensors[a].fNoise_counts    = Uniform(rng, 0.3f, 2.0f);
+    }
+
+    scenario.fInhale_mmH2O  = Uniform(rng, 150.0f, 300.0f);
+    scenario.fExhale_mmH2O  = Uniform(rng, 30.0f, 80.0f);
+    scenario.fRate          = Uniform(rng, 12.0f, 30.0f);
+    scenario.nEvent_ms      = kEventMin_ms + static_cast<uint32_t>(Uniform(rng, 0.0f, kEventSpread_ms));
+    scenario.nResetDelay_ms = kResetMin_ms + static_cast<uint32_t>(Uniform(rng, 0.0f, kResetSpread_ms));
+    return scenario;
+}
+
+// Drop the replies of commands sent from the observer
+static void DrainReplies()
+{
+    std::string line;
+    while (Simulator_ReadLine(line))
+    {
+    }
+}
+
+// Called after every loop iteration, applies the error cause, removes it at the alarm, resets and waits for ventilation
+static void Observe(void* pContext)
+{
+    tRecoverySession& session = *static_cast<tRecoverySession*>(pContext);
+    const tRecoveryScenario& scenario = *session.pScenario;
+    uint32_t now = millis();
+    DrainReplies();
+
+    if (!session.bCaused && now - session.nStart_ms >= scenario.nEvent_ms)
+    {
+        session.bCaused = true;
+        if (scenario.nScenario == kRecovery_Pressure)
+        {
+            float limit = scenario.fInhale_mmH2O * 0.5f;
+            Simulator_Send(Simulator_FrameBytes("AHP", &limit, sizeof(limit)));
+        }
+        else
+        {
+            FaultInjection_Inject(kFault_AdcStuck, kSensor_Pressure0, 1023);
+        }
+    }
+
+    if (session.nAlarm_ms < 0)
+    {
+        if (session.bCaused && gDataModel.nState == kState_Error)
+        {
+            // Cause removed at once, the alarm stays latched until the operator resets it
+            session.nAlarm_ms = now;
+            if (scenario.nScenario == kRecovery_Pressure)
+            {
+                Simulator_Send(Simulator_FrameBytes("AHP", &session.fLimit_mmH2O, sizeof(session.fLimit_mmH2O)));
+            }
+            else
+            {
+                FaultInjection_Inject(kFault_None, 0, 0);
+            }
+        }
+        return;
+    }
+
+    if (session.nReset_ms < 0)
+    {
+        if (now - session.nAlarm_ms >= scenario.nResetDelay_ms)
+        {
+            session.nReset_ms           = now;
+            session.nRespirationCount   = gDataModel.nRespirationCount;
+            Simulator_Send(Simulator_Frame("ART", {}));
+        }
+        return;
+    }
+
+    session.bWarmup |= gDataModel.nState == kState_Warmup;
+    if (session.nResume_ms < 0 && gDataModel.nRespirationCount != session.nRespirationCount)
+    {
+        session.nResume_ms = now;
+    }
+}
+
+// Send a command and require its ACK
+static bool Command(const std::string& szFrame)
+{
+    std::string reply;
+    return Simulator_Command(szFrame, reply) && reply == "ACK";
+}
+
+// Child process: one session, prints its cause, the gap seen from the host and the firmware, and the recovery path
+static int RunSession(uint32_t nSeed, float fDuration_s, int nForced)
+{
+    tRecoveryScenario scenario = DrawScenario(nSeed, nForced);
+
+    Simulator_Init(scenario.params, nSeed);
+    Simulator_Run(kPeriodWarmup, nullptr, nullptr);
+
+    // Profile is set in the data model as CUR does once validated, CUR bounds don't cover therapy pressures in mmH2O.
+    // Curve ratios are in respiration periods per minute: inhale a third of the period, exhale the rest.
+    Control_SetRespirationRate(scenario.fRate);
+    gDataModel.fInhalePressureTarget_mmH2O = scenario.fInhale_mmH2O;
+    gDataModel.fExhalePressureTarget_mmH2O = scenario.fExhale_mmH2O;
+    gDataModel.fInhaleRatio                = 60.0f / 3.0f;
+    gDataModel.fExhaleRatio                = 60.0f * 2.0f / 3.0f - scenario.fRate * kPeriodStabilization * 1e-3f;
+    updateCurve();
+
+    int8_t start = 1;
+    if (!Command(Simulator_FrameBytes("CYC", &start, sizeof(start))))
+    {
+        return 1;
+    }
+
+    tRecoverySession session = {};
+    session.pScenario       = &scenario;
+    session.fLimit_mmH2O    = gConfiguration.fMaxPressureLimit_mmH2O;
+    session.nStart_ms       = millis();
+    session.nAlarm_ms       = -1;
+    session.nReset_ms       = -1;
+    session.nResume_ms      = -1;
+
+    uint32_t duration = static_cast<uint32_t>(fDuration_s * 1000.0f);
+    for (uint32_t elapsed = 0; elapsed < duration && session.nResume_ms < 0; elapsed += 100)
+    {
+        Simulator_Run(100, Observe, &session);
+    }
+
+    // Host gap, resume delay after the reset, firmware gap, warmup
+    long long gap = session.nResume_ms >= 0 ? session.nResume_ms - session.nAlarm_ms : -1;
+    long long resume = session.nResume_ms >= 0 ? session.nResume_ms - session.nReset_ms : -1;
+    printf("R %d %lld %lld %lld %d\n", scenario.nScenario, gap, resume,
+           session.nResume_ms >= 0 ? (long long)gSafeties.nRecoveryGap_ms : -1LL, session.bWarmup ? 1 : 0);
+    return 0;
+}
+
+/// \struct tRecoveryStats
+/// \brief Recoveries of a scenario over every session
+struct tRecoveryStats
+{
+    std::vector<int64_t>    gaps;           ///> Alarm to first respiration
+    std::vector<int64_t>    resumes;        ///> Reset to first respiration
+    int                     nSessions;
+    int                     nStuck;         ///> Never ventilated again
+    int                     nWarmups;       ///> Recovered through a warmup
+    int                     nMismatch;      ///> Firmware gap off the host gap by more than a loop
+};
+
+// Nearest rank percentile of sorted values
+static int64_t Percentile(const std::vector<int64_t>& sorted, float fRank)
+{
+    if (sorted.empty())
+    {
+        return -1;
+    }
+    size_t index = static_cast<size_t>(ceilf(fRank * sorted.size()));
+    return sorted[std::min(std::max<size_t>(index, 1), sorted.size()) - 1];
+}
+
+static void Usage()
+{
+    printf("usage: tlc_recovery [--sessions N] [--seed N] [--duration S] [--threads N] [--scenario NAME]\n"
+           "scenarios:");
+    for (const char* szName : kRecoveryNames)
+    {
+        printf(" %s", szName);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    int sessions = 200;
+    uint32_t seed = 1;
+    float duration = 30.0f;
+    unsigned threads = Runner_DefaultThreads();
+    long long runSeed = -1;
+    int forced = -1;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        bool bValue = a + 1 < argc;
+        if (!strcmp(argv[a], "--run") && bValue)                runSeed = atoll(argv[++a]);
+        else if (!strcmp(argv[a], "--sessions") && bValue)      sessions = std::max(atoi(argv[++a]), 1);
+        else if (!strcmp(argv[a], "--seed") && bValue)          seed = strtoul(argv[++a], nullptr, 0);
+        else if (!strcmp(argv[a], "--duration") && bValue)      duration = std::max((float)atof(argv[++a]), 15.0f);
+        else if (!strcmp(argv[a], "--threads") && bValue)       threads = std::max(atoi(argv[++a]), 1);
+        else if (!strcmp(argv[a], "--scenario") && bValue)
+        {
+            const char* szName = argv[++a];
+            for (int b = 0; b < kRecovery_Count; ++b)
+            {
+                forced = strcmp(szName, kRecoveryNames[b]) ? forced : b;
+            }
+            if (forced < 0)
+            {
+                Usage();
+                return 2;
+            }
+        }
+        else
+        {
+            Usage();
+            return 2;
+        }
+    }
+
+    if (runSeed >= 0)
+    {
+        return RunSession(static_cast<uint32_t>(runSeed), duration, forced);
+    }
+
+    std::string self = Runner_Self();
+    std::vector<std::string> commands;
+    for (int a = 0; a < sessions; ++a)
+    {
+        char command[512];
+        snprintf(command, sizeof(command), "'%s' --run %u --duration %g%s%s", self.c_str(), seed + a, duration,
+                 forced >= 0 ? " --scenario " : "", forced >= 0 ? kRecoveryNames[forced] : "");
+        commands.push_back(command);
+    }
+
+    printf("Sessions: %d of at most %gs from seed %u on %u workers\n", sessions, duration, seed, threads);
+    fflush(stdout);
+    std::vector<std::string> outputs = Runner_Map(commands, threads);
+
+    tRecoveryStats stats[kRecovery_Count] = {};
+    int failed = 0;
+    for (const std::string& output : outputs)
+    {
+        int scenario, warmup;
+        long long gap, resume, firmwareGap;
+        if (sscanf(output.c_str(), "R %d %lld %lld %lld %d", &scenario, &gap, &resume, &firmwareGap, &warmup) != 5 ||
+            scenario < 0 || scenario >= kRecovery_Count)
+        {
+            ++failed;
+            continue;
+        }
+
+        tRecoveryStats& recovery = stats[scenario];
+        ++recovery.nSessions;
+        if (gap < 0)
+        {
+            ++recovery.nStuck;
+            continue;
+        }
+        recovery.gaps.push_back(gap);
+        recovery.resumes.push_back(resume);
+        recovery.nWarmups   += warmup;
+        recovery.nMismatch  += llabs(firmwareGap - gap) > kPeriodControl ? 1 : 0;
+    }
+
+    printf("\nVentilation gap in ms, alarm to the first respiration after recovery, and reset to that respiration:\n");
+    printf("%-10s %9s %9s %9s %8s %8s %8s %8s %8s %8s %9s\n", "cause", "sessions", "stuck", "warmups", "gap p50", "gap p95", "gap max",
+           "rst p50", "rst p95", "rst max", "mismatch");
+    bool bPass = failed == 0;
+    for (int a = 0; a < kRecovery_Count; ++a)
+    {
+        tRecoveryStats& recovery = stats[a];
+        std::sort(recovery.gaps.begin(), recovery.gaps.end());
+        std::sort(recovery.resumes.begin(), recovery.resumes.end());
+        printf("%-10s %9d %9d %9d %8lld %8lld %8lld %8lld %8lld %8lld %9d\n", kRecoveryNames[a], recovery.nSessions, recovery.nStuck, recovery.nWarmups,
+               (long long)Percentile(recovery.gaps, 0.50f), (long long)Percentile(recovery.gaps, 0.95f),
+               (long long)(recovery.gaps.empty() ? -1 : recovery.gaps.back()),
+               (long long)Percentile(recovery.resumes, 0.50f), (long long)Percentile(recovery.resumes, 0.95f),
+               (long long)(recovery.resumes.empty() ? -1 : recovery.resumes.back()), recovery.nMismatch);
+
+        // Every session ventilates again, the firmware reports the gap the host saw
+        bPass &= recovery.nStuck == 0 && recovery.nMismatch == 0;
+    }
+
+    if (!bPass)
+    {
+        printf("\nFAIL: %d sessions failed to run, or a recovery was stuck or misreported\n", failed);
+    }
+    return bPass ? 0 : 1;
+}
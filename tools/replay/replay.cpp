@@ -0,0 +1,246 @@
+///
+/// \file       replay.cpp
+/// \brief      Replay of a recorder capture through the firmware on the host simulator
+///
+/// Feeds the ADC samples of a capture to Sensors_Process() through the recorder replay queue and sends
+/// its commands to Communications_Process(), each at its captured tick on the simulated clock. The
+/// firmware runs as on the device, the plant model is only left running underneath. Respiration never
+/// runs on replayed samples (CYC ends a replay), so respiration starts are left out: a replay goes through
+/// the sensors, the fusion, the safeties and the command parser. Every sample the firmware consumes gives
+/// a CSV row of what it made of it: readings, fused pressure, state and safety flags. Firmware replies go to stderr.
+///
+/// --capture records a capture of a simulated session, in the format the device streams with REC 1.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "simulator.h"
+#include "host.h"
+#include "trace.h"
+
+#include "configuration.h"
+#include "control.h"
+#include "datamodel.h"
+#include "serialportreader.h"
+#include "recorder.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// \struct tReplay
+/// \brief Replay observer state
+struct tReplay
+{
+    FILE*       pCsv;               ///> CSV output
+    int64_t     nTickOffset;        ///> Capture tick minus simulated millis()
+    uint8_t     nSampleCount;       ///> gDataModel.nSampleCount seen at the previous loop
+    uint32_t    nConsumed;          ///> Samples consumed by Sensors_Process()
+};
+
+// Called after every loop iteration, prints a row for every sample Sensors_Process() consumed
+static void Observe(void* pContext)
+{
+    tReplay& replay = *static_cast<tReplay*>(pContext);
+
+    std::string line;
+    while (Simulator_ReadLine(line))
+    {
+        fprintf(stderr, "%s\n", line.c_str());
+    }
+
+    if (gDataModel.nSampleCount == replay.nSampleCount)
+    {
+        return;
+    }
+    replay.nSampleCount = gDataModel.nSampleCount;
+    ++replay.nConsumed;
+
+    fprintf(replay.pCsv, "%lld,%u,%u,%u,%.2f,%u,%u,%d,%u\n", (long long)(millis() + replay.nTickOffset),
+            gDataModel.nSensorRaw[kSensor_Pressure0], gDataModel.nSensorRaw[kSensor_Pressure1], gDataModel.nSensorRaw[kSensor_Battery],
+            gDataModel.fPressureFused_mmH2O, gDataModel.nRawPressureSpread, gDataModel.nSensorRangeFlags,
+            static_cast<int>(gDataModel.nState), gDataModel.nSafetyFlags);
+}
+
+// Replay a capture file, returns non zero if it can't be read or the firmware didn't take every sample
+static int Replay(const char* szTrace, FILE* pCsv, const int* pOffsets)
+{
+    std::vector<tTraceFrame> frames;
+    bool bComplete = Trace_Read(szTrace, frames);
+    if (frames.empty())
+    {
+        fprintf(stderr, "tlc_replay: no recorder frame in %s\n", szTrace);
+        return 1;
+    }
+    if (!bComplete)
+    {
+        fprintf(stderr, "tlc_replay: %s ends inside a frame, last frame dropped\n", szTrace);
+    }
+
+    Simulator_Init(Plant_DefaultParams(), 1);
+    Simulator_Run(kPeriodWarmup, nullptr, nullptr);
+    for (uint8_t a = 0; pOffsets != nullptr && a < kPressureChannelCount; ++a)
+    {
+        gConfiguration.nPressureSensorOffset[a] = static_cast<uint16_t>(pOffsets[a]);
+    }
+
+    uint8_t mode = kRecorderMode_Replay;
+    std::string reply;
+    if (!Simulator_Command(Simulator_FrameBytes("REC", &mode, sizeof(mode)), reply) || reply != "ACK")
+    {
+        fprintf(stderr, "tlc_replay: replay mode refused\n");
+        return 1;
+    }
+
+    tReplay replay = {};
+    replay.pCsv         = pCsv;
+    replay.nTickOffset  = static_cast<int64_t>(frames[0].nTick) - millis();
+    replay.nSampleCount = gDataModel.nSampleCount;
+    fprintf(pCsv, "tick_ms,raw0,raw1,battery,pressure_mmH2O,spread_raw,range_flags,state,safety_flags\n");
+
+    uint32_t samples = 0;
+    uint32_t dropped = 0;
+    uint32_t commands = 0;
+    uint32_t skipped = 0;
+    for (const tTraceFrame& frame : frames)
+    {
+        int64_t due = static_cast<int64_t>(frame.nTick) - replay.nTickOffset;
+        if (due > static_cast<int64_t>(millis()))
+        {
+            Simulator_Run(static_cast<uint32_t>(due - millis()), Observe, &replay);
+        }
+
+        if (frame.nType == 'A' && frame.szPayload.size() == kRecorderChannelCount * sizeof(uint16_t))
+        {
+            // The host stands in for the ADC: RPS is refused while respiration runs, samples go to the queue directly
+            uint16_t raw[kRecorderChannelCount];
+            memcpy(raw, frame.szPayload.data(), sizeof(raw));
+            ++samples;
+            dropped += Recorder_PushReplay(raw) ? 0 : 1;
+        }
+        else if (frame.nType == 'C')
+        {
+            // A recorder command or a respiration start would end the replay
+            const std::string& command = frame.szPayload;
+            bool bStart = command.compare(0, 3, "CYC") == 0 && command.size() > 3 && command[3] != 0;
+            if (bStart || command.compare(0, 3, "REC") == 0)
+            {
+                ++skipped;
+                continue;
+            }
+            Simulator_Send(command);
+            ++commands;
+        }
+    }
+
+    // Let the firmware drain the queue
+    Simulator_Run(kRecorderReplayQueue * kPeriodSensors * 2, Observe, &replay);
+
+    fprintf(stderr, "tlc_replay: %u samples, %u consumed, %u dropped (queue full), %u commands, %u skipped\n",
+            samples, replay.nConsumed, dropped, commands, skipped);
+    return (dropped == 0 && replay.nConsumed == samples) ? 0 : 1;
+}
+
+// Capture a simulated session as the device streams it with REC 1: capture starts, then ventilation
+static int Capture(const char* szTrace, uint32_t nDuration_ms, uint32_t nSeed)
+{
+    Simulator_Init(Plant_DefaultParams(), nSeed);
+    Simulator_Run(kPeriodWarmup, nullptr, nullptr);
+
+    // Profile is set in the data model as CUR does once validated, CUR bounds don't cover therapy pressures in mmH2O
+    Control_SetRespirationRate(20.0f);
+    gDataModel.fInhalePressureTarget_mmH2O = 250.0f;
+    gDataModel.fExhalePressureTarget_mmH2O = 50.0f;
+    gDataModel.fInhaleRatio                = 1.0f;
+    gDataModel.fExhaleRatio                = 2.0f;
+    updateCurve();
+
+    uint8_t mode = kRecorderMode_Capture;
+    int8_t start = 1;
+    Simulator_Send(Simulator_FrameBytes("REC", &mode, sizeof(mode)));
+    Simulator_Run(kPeriodCommunications * 2, nullptr, nullptr);
+    Simulator_Send(Simulator_FrameBytes("CYC", &start, sizeof(start)));
+
+    // Serial output is taken every loop, before the simulator would compact it
+    std::string stream = gHost.szSerialTx;
+    gHost.szSerialTx.clear();
+    Simulator_Run(nDuration_ms, [](void* pContext)
+    {
+        static_cast<std::string*>(pContext)->append(gHost.szSerialTx);
+        gHost.szSerialTx.clear();
+    }, &stream);
+
+    FILE* pFile = fopen(szTrace, "wb");
+    if (pFile == nullptr)
+    {
+        fprintf(stderr, "tlc_replay: can't write %s\n", szTrace);
+        return 1;
+    }
+    fwrite(stream.data(), 1, stream.size(), pFile);
+    fclose(pFile);
+    return 0;
+}
+
+static void Usage()
+{
+    printf("usage: tlc_replay TRACE [--csv FILE] [--offsets N N]\n"
+           "       tlc_replay --capture TRACE [--duration S] [--seed N]\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* szTrace = nullptr;
+    const char* szCsv = nullptr;
+    bool capture = false;
+    float duration = 10.0f;
+    uint32_t seed = 1;
+    int offsets[kPressureChannelCount] = {};
+    bool bOffsets = false;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        bool bValue = a + 1 < argc;
+        if (!strcmp(argv[a], "--capture") && bValue)        { capture = true; szTrace = argv[++a]; }
+        else if (!strcmp(argv[a], "--csv") && bValue)       szCsv = argv[++a];
+        else if (!strcmp(argv[a], "--duration") && bValue)  duration = std::max((float)atof(argv[++a]), 0.1f);
+        else if (!strcmp(argv[a], "--seed") && bValue)      seed = strtoul(argv[++a], nullptr, 0);
+        else if (!strcmp(argv[a], "--offsets") && a + kPressureChannelCount < argc)
+        {
+            for (int b = 0; b < kPressureChannelCount; ++b)
+            {
+                offsets[b] = atoi(argv[++a]);
+            }
+            bOffsets = true;
+        }
+        else if (argv[a][0] != '-' && szTrace == nullptr)   szTrace = argv[a];
+        else
+        {
+            Usage();
+            return 2;
+        }
+    }
+
+    if (szTrace == nullptr)
+    {
+        Usage();
+        return 2;
+    }
+
+    if (capture)
+    {
+        return Capture(szTrace, static_cast<uint32_t>(duration * 1000.0f), seed);
+    }
+
+    FILE* pCsv = szCsv != nullptr ? fopen(szCsv, "w") : stdout;
+    if (pCsv == nullptr)
+    {
+        fprintf(stderr, "tlc_replay: can't write %s\n", szCsv);
+        return 1;
+    }
+    int result = Replay(szTrace, pCsv, bOffsets ? offsets : nullptr);
+    if (pCsv != stdout)
+    {
+        fclose(pCsv);
+    }
+    return result;
+}
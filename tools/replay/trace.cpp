@@ -0,0 +1,73 @@
+///
+/// \file       trace.cpp
+/// \brief      Reader of the serial captures of the recorder
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "trace.h"
+
+#include "recorder.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/// \enum eTraceConsts
+/// \brief Frame layout, as written by the recorder
+enum eTraceConsts
+{
+    kTraceHeaderSize    = 1 + 1 + sizeof(uint32_t) + 1,     ///> Sync, type, tick, payload size
+};
+
+bool Trace_Parse(const std::string& szStream, std::vector<tTraceFrame>& frames)
+{
+    size_t offset = 0;
+    while ((offset = szStream.find(static_cast<char>(kRecorderSync), offset)) != std::string::npos)
+    {
+        if (offset + kTraceHeaderSize > szStream.size())
+        {
+            return false;
+        }
+
+        tTraceFrame frame;
+        frame.nType = static_cast<uint8_t>(szStream[offset + 1]);
+        memcpy(&frame.nTick, szStream.data() + offset + 2, sizeof(frame.nTick));
+        size_t size = static_cast<uint8_t>(szStream[offset + kTraceHeaderSize - 1]);
+        if (offset + kTraceHeaderSize + size > szStream.size())
+        {
+            return false;
+        }
+
+        // A sync byte without a known type is noise on the line, resynchronize after it
+        if (frame.nType != 'A' && frame.nType != 'C')
+        {
+            ++offset;
+            continue;
+        }
+
+        frame.szPayload.assign(szStream, offset + kTraceHeaderSize, size);
+        frames.push_back(frame);
+        offset += kTraceHeaderSize + size;
+    }
+
+    return true;
+}
+
+bool Trace_Read(const char* szPath, std::vector<tTraceFrame>& frames)
+{
+    FILE* pFile = fopen(szPath, "rb");
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+
+    std::string stream;
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+    {
+        stream.append(buffer, count);
+    }
+    fclose(pFile);
+
+    return Trace_Parse(stream, frames);
+}
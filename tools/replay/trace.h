@@ -0,0 +1,34 @@
+///
+/// \file       trace.h
+/// \brief      Reader of the serial captures of the recorder
+///
+/// A capture is the raw serial output of the device while the recorder captures (REC 1): recorder frames
+/// interleaved with the text protocol. Text is skipped, the sync byte is never part of it.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#ifndef TLC_TRACE_H
+#define TLC_TRACE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// \struct tTraceFrame
+/// \brief Recorder frame
+struct tTraceFrame
+{
+    uint8_t     nType;              ///> 'A' ADC sample or 'C' command
+    uint32_t    nTick;              ///> millis() of the device when captured
+    std::string szPayload;          ///> Raw channels (uint16 each) or the command line as received
+};
+
+/// \fn bool Trace_Parse(const std::string& szStream, std::vector<tTraceFrame>& frames)
+/// \brief Append the frames of a captured serial stream, returns false if the stream ends inside a frame
+bool Trace_Parse(const std::string& szStream, std::vector<tTraceFrame>& frames);
+
+/// \fn bool Trace_Read(const char* szPath, std::vector<tTraceFrame>& frames)
+/// \brief Read the frames of a capture file, returns false if it can't be read or ends inside a frame
+bool Trace_Read(const char* szPath, std::vector<tTraceFrame>& frames);
+
+#endif // TLC_TRACE_H
@@ -0,0 +1,719 @@
+///
+/// \file       safetymc.cpp
+/// \brief      Monte Carlo validation of the safeties on the host simulator
+///
+/// Runs thousands of ventilation sessions with randomized lung, profile, sensor noise and gain error,
+/// each with at most one injected fault (pump runaway, exhale valve stuck, sensor drift, stuck, open
+/// or shorted sensor, battery drain) and random serial garbage. Sensor and exhale valve faults go through
+/// the firmware fault injector (FAULT_INJECTION) at their onset, as FIJ does on a bench. The plant gives the ground truth of
+/// every eAlarm hazard; the raised nSafetyFlags bits are matched against it to measure detection
+/// latency, misses and false alarms. Sessions run in parallel child processes, one worker thread per core.
+///
+/// Ground truth of an alarm is its hazard held for kHazardHold_ms, onset at the start of the hold,
+/// or a hazard run cut short by the alarm itself: a latched alarm stops the session under it.
+/// A raise is a false alarm when the hazard wasn't near its threshold (indifference band) within the
+/// lookback of that alarm, the sensors and battery filters delay a raise after the hazard is gone.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "simulator.h"
+#include "runner.h"
+#include "host.h"
+
+#include "configuration.h"
+#include "control.h"
+#include "datamodel.h"
+#include "faultinjection.h"
+#include "sensors.h"
+#include "serialportreader.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// \enum eScenario
+/// \brief Fault injected in a session
+enum eScenario
+{
+    kScenario_None = 0,         ///> No fault, false alarms only
+    kScenario_PumpRunaway,      ///> Pump runs at full duty, lowered high pressure limit
+    kScenario_ValveStuck,       ///> Exhale valve stops moving
+    kScenario_SensorDrift,      ///> A pressure sensor drifts
+    kScenario_SensorStuck,      ///> A pressure sensor freezes
+    kScenario_SensorOpen,       ///> A pressure sensor input reads the low rail
+    kScenario_SensorShort,      ///> A pressure sensor input reads the high rail
+    kScenario_BatteryDrain,     ///> Battery runs down through the minimum level
+
+    kScenario_Count
+};
+
+static const char* const kScenarioNames[kScenario_Count] =
+{
+    "none", "pump-runaway", "valve-stuck", "sensor-drift", "sensor-stuck", "sensor-open", "sensor-short", "battery-drain",
+};
+
+// Scenario draw weights, in eScenario order
+static const int kScenarioWeights[kScenario_Count] = { 30, 15, 5, 10, 10, 5, 5, 20 };
+
+// Scenarios the firmware must ride through: a stuck sensor is voted out and ventilation goes on, in eScenario order
+static const bool kScenarioKeepsVentilating[kScenario_Count] = { false, false, false, false, true, false, false, false };
+
+/// \enum eOutcome
+/// \brief Outcome of an alarm in a session
+enum eOutcome
+{
+    kOutcome_NoHazard = 0,      ///> Hazard never held
+    kOutcome_Detected,          ///> Raised after the hazard onset, or while near it
+    kOutcome_Early,             ///> Raised near the threshold, before the hazard held
+    kOutcome_Covered,           ///> Not raised, but another alarm was raised after the onset
+    kOutcome_Censored,          ///> Not raised, onset too close to the end of observation to tell
+    kOutcome_Missed,            ///> Not raised
+
+    kOutcome_Count
+};
+
+/// \struct tAlarmTruth
+/// \brief Ground truth timing of an alarm
+struct tAlarmTruth
+{
+    const char* szName;         ///> Report name
+    uint32_t    nLookback_ms;   ///> Raise after the hazard was last near is not false
+    uint32_t    nCensor_ms;     ///> Onset this close to the end of observation is censored
+};
+
+// In eAlarm bit order
+static const tAlarmTruth kAlarmTruths[kAlarmCount] =
+{
+    { "MaxPressureLimit",            100,    1000 },
+    { "MinPressureLimit",            100,    1000 },
+    { "PressureSensorRedudancyFail", 100,    1000 },
+    { "InvalidConfiguration",        0,      1000 },
+    { "BatteryLow",                  60000,  60000 },   // ~10s filter then 8 of 8 samples at 1Hz
+    { "SensorRange",                 100,    1000 },
+    { "PressureRedundancyLost",      3000,   5000 },    // Stuck channel needs 1s without variance, residual ~500ms
+};
+
+/// \enum eSafetyMcConsts
+/// \brief Harness constants
+enum eSafetyMcConsts
+{
+    kHazardHold_ms      = 3 * kPeriodSensors,   ///> Hazard must hold this long to be one, a rule needs its persistence window
+    kFaultOnsetMin_ms   = 2000,                 ///> Earliest fault onset after ventilation starts
+};
+
+const float kPressureBand_mmH2O     = 10.0f;    // Indifference band of pressure limits, plus kGainErrorMax of the limit
+const float kSpreadBand_mmH2O       = 10.0f;    // Indifference band of the redundancy delta
+const float kBatteryBand_V          = 0.3f;     // Indifference band of the battery level, ADC step is ~15mV
+const float kRangeBand_counts       = 2.0f;     // Indifference band of the sensor span
+const float kGainErrorMax           = 0.02f;    // Pressure sensor sensitivity error, uniform within +/-
+const float kSerialNoiseRate_s      = 1.0f;     // Serial garbage bursts per second, when enabled
+
+/// \struct tScenario
+/// \brief Randomized session
+struct tScenario
+{
+    int             nScenario;                  ///> eScenario
+    tPlantParams    params;                     ///> Plant with its faults
+    uint8_t         nFault;                     ///> Injected eFault, kFault_None for a plant fault or none
+    uint8_t         nFaultChannel;              ///> ADC channel of the injected fault
+    int32_t         nFaultValue;                ///> Value of the injected fault, negative sticks an ADC channel where it reads
+    float           fFaultOnset_s;              ///> Injection time in plant time
+    float           fInhale_mmH2O;              ///> Inhale pressure target
+    float           fExhale_mmH2O;              ///> Exhale pressure target
+    float           fRate;                      ///> Respirations per minute
+    float           fMaxPressureLimit_mmH2O;    ///> High pressure limit sent with AHP, 0 keeps the configuration
+    bool            bSerialNoise;               ///> Random bytes are sent to the serial port
+};
+
+/// \struct tAlarmTrack
+/// \brief Ground truth and detection of an alarm in a session
+struct tAlarmTrack
+{
+    int64_t     nRunStart_ms;       ///> Start of the current hazard run, -1 when none
+    int64_t     nOnset_ms;          ///> Held hazard onset, -1 when none
+    int64_t     nLastNear_ms;       ///> Last time the hazard was near its threshold, -1 when never
+    int64_t     nDetect_ms;         ///> First raise that wasn't false, -1 when none
+    int         nFalse;             ///> False raises
+};
+
+/// \struct tSession
+/// \brief Session observer state
+struct tSession
+{
+    const tScenario*    pScenario;
+    tAlarmTrack         pAlarms[kAlarmCount];
+    uint16_t            nFlags;             ///> nSafetyFlags seen at the previous loop
+    bool                bInjected;          ///> Scenario fault was injected
+    uint64_t            nStart_us;          ///> Ventilation start
+    int64_t             nEnd_ms;            ///> End of observation, -1 while observing
+    uint64_t            nNextNoise_us;      ///> Next serial garbage burst
+    std::mt19937        rng;                ///> Serial garbage generator
+};
+
+static float Uniform(std::mt19937& rng, float fLow, float fHigh)
+{
+    return std::uniform_real_distribution<float>(fLow, fHigh)(rng);
+}
+
+static float LogUniform(std::mt19937& rng, float fLow, float fHigh)
+{
+    return expf(Uniform(rng, logf(fLow), logf(fHigh)));
+}
+
+// Draw the scenario of a session from its seed, nForced (eScenario) replaces the drawn fault when not negative
+static tScenario DrawScenario(uint32_t nSeed, float fDuration_s, int nForced)
+{
+    std::mt19937 rng(nSeed);
+    tScenario scenario = {};
+    scenario.nScenario = std::discrete_distribution<int>(std::begin(kScenarioWeights), std::end(kScenarioWeights))(rng);
+    if (nForced >= 0)
+    {
+        scenario.nScenario = nForced;
+    }
+
+    tPlantParams& params = scenario.params;
+    params = Plant_DefaultParams();
+    params.fCompliance          = LogUniform(rng, 1.5f, 8.0f);
+    params.fAirwayResistance    = LogUniform(rng, 0.05f, 0.3f);
+    params.fLeakResistance      = Uniform(rng, 0.0f, 1.0f) < 0.3f ? Uniform(rng, 2.0f, 10.0f) : 0.0f;
+    params.fBatteryNoise_V      = Uniform(rng, 0.0f, 0.05f);
+    params.fBattery_V           = Uniform(rng, 11.5f, 12.8f);
+    for (int a = 0; a < kPlantPressureChannelCount; ++a)
+    {
+        params.pSensors[a].fOffset_counts   = Uniform(rng, 35.0f, 47.0f);
+        params.pSensors[a].fGainError       = Uniform(rng, -kGainErrorMax, kGainErrorMax);
+        params.pSensors[a].fNoise_counts    = Uniform(rng, 0.3f, 2.0f);
+    }
+
+    scenario.fInhale_mmH2O  = Uniform(rng, 150.0f, 300.0f);
+    scenario.fExhale_mmH2O  = Uniform(rng, 30.0f, 80.0f);
+    scenario.fRate          = Uniform(rng, 12.0f, 30.0f);
+    scenario.bSerialNoise   = Uniform(rng, 0.0f, 1.0f) < 0.5f;
+
+    // Onsets in plant time: warmup runs before ventilation starts
+    float onset = (kPeriodWarmup + kFaultOnsetMin_ms) * 1e-3f + Uniform(rng, 0.0f, fDuration_s * 0.75f);
+    scenario.nFaultChannel  = static_cast<uint8_t>(std::uniform_int_distribution<int>(0, kPlantPressureChannelCount - 1)(rng));
+    scenario.fFaultOnset_s  = onset;
+    switch (scenario.nScenario)
+    {
+    case kScenario_PumpRunaway:
+        params.fPumpRunawayOnset_s      = onset;
+        scenario.fMaxPressureLimit_mmH2O = Uniform(rng, scenario.fInhale_mmH2O + 50.0f, 600.0f);
+        break;
+    case kScenario_ValveStuck:
+        scenario.nFault         = kFault_ServoStuck;
+        break;
+    case kScenario_SensorDrift:
+        scenario.nFault         = kFault_AdcDrift;
+        scenario.nFaultValue    = lroundf(LogUniform(rng, 500.0f, 50000.0f) * (Uniform(rng, 0.0f, 1.0f) < 0.5f ? -1.0f : 1.0f));
+        break;
+    case kScenario_SensorStuck:
+        scenario.nFault         = kFault_AdcStuck;
+        scenario.nFaultValue    = -1;
+        break;
+    case kScenario_SensorOpen:
+        scenario.nFault         = kFault_AdcStuck;
+        scenario.nFaultValue    = 0;
+        break;
+    case kScenario_SensorShort:
+        scenario.nFault         = kFault_AdcStuck;
+        scenario.nFaultValue    = 1023;
+        break;
+    case kScenario_BatteryDrain:
+        params.fBatteryDrain_V_s = (params.fBattery_V - gConfiguration.fMinBatteryLevel) / onset;
+        break;
+    default:
+        break;
+    }
+
+    return scenario;
+}
+
+// Noiseless pressure channel reading as the firmware sees it, injected faults included
+static float SensorCounts(uint8_t nChannel)
+{
+    float counts = fminf(fmaxf(Plant_SensorCounts(nChannel), 0.0f), 1023.0f);
+    return FaultInjection_Adc(nChannel, static_cast<uint16_t>(lroundf(counts)));
+}
+
+// Hazard of an alarm now from the plant; bNear relaxes the threshold by the indifference band
+static bool Hazard(int nAlarm, bool bNear)
+{
+    float pressure = gPlant.fPressure_mmH2O;
+    switch (1 << nAlarm)
+    {
+    case kAlarm_MaxPressureLimit:
+    {
+        float limit = gConfiguration.fMaxPressureLimit_mmH2O;
+        return pressure >= limit - (bNear ? kPressureBand_mmH2O + kGainErrorMax * fabsf(limit) : 0.0f);
+    }
+
+    case kAlarm_MinPressureLimit:
+    {
+        float limit = gConfiguration.fMinPressureLimit_mmH2O;
+        return pressure <= limit + (bNear ? kPressureBand_mmH2O + kGainErrorMax * fabsf(limit) : 0.0f);
+    }
+
+    case kAlarm_PressureSensorRedudancyFail:
+    {
+        // Out of span channels are left out of the spread, SensorRange covers them. A stuck channel is
+        // voted out of it, PressureRedundancyLost covers it.
+        float counts[kPlantPressureChannelCount];
+        for (uint8_t a = 0; a < kPlantPressureChannelCount; ++a)
+        {
+            counts[a] = SensorCounts(a);
+            if (counts[a] < 1.0f || counts[a] > 1022.0f || (gFaultInjection.nAdcMask[a] & (1 << kFault_AdcStuck)))
+            {
+                return false;
+            }
+            counts[a] -= gConfiguration.nPressureSensorOffset[a];
+        }
+        float spread = Sensors_PressureTransfer(fabsf(counts[0] - counts[1]));
+        return spread >= gConfiguration.fMaxPressureDelta_mmH2O - (bNear ? kSpreadBand_mmH2O : 0.0f);
+    }
+
+    case kAlarm_BatteryLow:
+        return Plant_BatteryVoltage() <= gConfiguration.fMinBatteryLevel + (bNear ? kBatteryBand_V : 0.0f);
+
+    case kAlarm_SensorRange:
+    {
+        float band = bNear ? kRangeBand_counts : 0.0f;
+        for (uint8_t a = 0; a < kPlantPressureChannelCount; ++a)
+        {
+            float counts = SensorCounts(a);
+            if (counts < 1.0f + band || counts > 1022.0f - band)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    case kAlarm_PressureRedundancyLost:
+    {
+        // A faulted channel that reads away from the truth, by half the redundancy delta the fusion votes out at.
+        // Two channels can't out-vote a drift, the redundancy safety stops on it instead.
+        for (uint8_t a = 0; a < kPlantPressureChannelCount; ++a)
+        {
+            uint16_t mask = gFaultInjection.nAdcMask[a];
+            if (mask == 0 || ((mask & (1 << kFault_AdcDrift)) && kPressureChannelCount < 3))
+            {
+                continue;
+            }
+            if (bNear)
+            {
+                return true;
+            }
+
+            float deviation = Sensors_PressureTransfer(fabsf(SensorCounts(a) - Plant_SensorCounts(a)));
+            if (deviation >= gConfiguration.fMaxPressureDelta_mmH2O * 0.5f)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    default:
+        return false;
+    }
+}
+
+// Send a burst of random bytes, sometimes terminated like a frame, and drop the replies
+static void SerialNoise(tSession& session)
+{
+    int length = std::uniform_int_distribution<int>(1, 32)(session.rng);
+    std::string burst;
+    for (int a = 0; a < length; ++a)
+    {
+        burst.push_back(static_cast<char>(std::uniform_int_distribution<int>(0, 255)(session.rng)));
+    }
+    if (std::uniform_int_distribution<int>(0, 1)(session.rng))
+    {
+        burst.append("\r\n");
+    }
+    Simulator_Send(burst);
+
+    std::string line;
+    while (Simulator_ReadLine(line))
+    {
+    }
+
+    float gap_s = std::exponential_distribution<float>(kSerialNoiseRate_s)(session.rng);
+    session.nNextNoise_us = gHost.nTime_us + static_cast<uint64_t>(gap_s * 1e6f);
+}
+
+// Called after every loop iteration, tracks the ground truth and the raised alarms until ventilation stops
+static void Observe(void* pContext)
+{
+    tSession& session = *static_cast<tSession*>(pContext);
+    if (session.nEnd_ms >= 0)
+    {
+        return;
+    }
+
+    int64_t now = static_cast<int64_t>((gHost.nTime_us - session.nStart_us) / 1000);
+
+    // Inject the scenario fault at its onset, a stuck channel keeps the reading it has then
+    const tScenario& scenario = *session.pScenario;
+    if (scenario.nFault != kFault_None && !session.bInjected && gPlant.fTime_s >= scenario.fFaultOnset_s)
+    {
+        int32_t value = scenario.nFaultValue;
+        if (value < 0 && scenario.nFault == kFault_AdcStuck)
+        {
+            value = lroundf(SensorCounts(scenario.nFaultChannel));
+        }
+        session.bInjected = FaultInjection_Inject(scenario.nFault, scenario.nFaultChannel, value);
+    }
+    uint16_t flags  = gDataModel.nSafetyFlags;
+    uint16_t raised = flags & ~session.nFlags;
+    session.nFlags  = flags;
+
+    for (int a = 0; a < kAlarmCount; ++a)
+    {
+        tAlarmTrack& track = session.pAlarms[a];
+        if (Hazard(a, false))
+        {
+            if (track.nRunStart_ms < 0)
+            {
+                track.nRunStart_ms = now;
+            }
+            if (track.nOnset_ms < 0 && now - track.nRunStart_ms >= kHazardHold_ms)
+            {
+                track.nOnset_ms = track.nRunStart_ms;
+            }
+        }
+        else
+        {
+            track.nRunStart_ms = -1;
+        }
+
+        if (Hazard(a, true))
+        {
+            track.nLastNear_ms = now;
+        }
+
+        if (raised & (1 << a))
+        {
+            bool bFalse = track.nLastNear_ms < 0 || now - track.nLastNear_ms > (int64_t)kAlarmTruths[a].nLookback_ms;
+            if (bFalse)
+            {
+                ++track.nFalse;
+            }
+            else if (track.nDetect_ms < 0)
+            {
+                track.nDetect_ms = now;
+                if (track.nOnset_ms < 0 && track.nRunStart_ms >= 0)
+                {
+                    track.nOnset_ms = track.nRunStart_ms;
+                }
+            }
+        }
+    }
+
+    // Latched alarms stop ventilation, the plant then no longer runs the scenario
+    if (gDataModel.nState == kState_Error || !gDataModel.bStartFlag)
+    {
+        session.nEnd_ms = now;
+        return;
+    }
+
+    if (scenario.bSerialNoise && gHost.nTime_us >= session.nNextNoise_us)
+    {
+        SerialNoise(session);
+    }
+}
+
+// Send a command and require its ACK
+static bool Command(const std::string& szFrame)
+{
+    std::string reply;
+    return Simulator_Command(szFrame, reply) && reply == "ACK";
+}
+
+// Child process: one randomized session, prints its scenario, ventilation time and the outcome of every alarm
+static int RunSession(uint32_t nSeed, float fDuration_s, int nForced)
+{
+    // Defaults the scenario draw reads, before the firmware loads its configuration
+    Configuration_SetDefaults();
+    tScenario scenario = DrawScenario(nSeed, fDuration_s, nForced);
+
+    Simulator_Init(scenario.params, nSeed);
+    Simulator_Run(kPeriodWarmup, nullptr, nullptr);
+
+    // Profile is set in the data model as CUR does once validated, CUR bounds don't cover therapy pressures in mmH2O
+    Control_SetRespirationRate(scenario.fRate);
+    gDataModel.fInhalePressureTarget_mmH2O = scenario.fInhale_mmH2O;
+    gDataModel.fExhalePressureTarget_mmH2O = scenario.fExhale_mmH2O;
+    gDataModel.fInhaleRatio                = 1.0f;
+    gDataModel.fExhaleRatio                = 2.0f;
+    updateCurve();
+
+    if (scenario.fMaxPressureLimit_mmH2O > 0.0f &&
+        !Command(Simulator_FrameBytes("AHP", &scenario.fMaxPressureLimit_mmH2O, sizeof(float))))
+    {
+        return 1;
+    }
+
+    int8_t start = 1;
+    if (!Command(Simulator_FrameBytes("CYC", &start, sizeof(start))))
+    {
+        return 1;
+    }
+
+    tSession session;
+    session.pScenario   = &scenario;
+    for (tAlarmTrack& track : session.pAlarms)
+    {
+        track = { -1, -1, -1, -1, 0 };
+    }
+    session.nFlags          = gDataModel.nSafetyFlags;
+    session.bInjected       = false;
+    session.nStart_us       = gHost.nTime_us;
+    session.nEnd_ms         = -1;
+    session.nNextNoise_us   = gHost.nTime_us;
+    session.rng.seed(nSeed ^ 0x5EED5EEDu);
+
+    uint32_t duration = static_cast<uint32_t>(fDuration_s * 1000.0f);
+    for (uint32_t elapsed = 0; elapsed < duration && session.nEnd_ms < 0; elapsed += 100)
+    {
+        Simulator_Run(100, Observe, &session);
+    }
+    int64_t end = session.nEnd_ms >= 0 ? session.nEnd_ms : static_cast<int64_t>(duration);
+
+    // First raise of another alarm that wasn't false, covers a hazard its own alarm missed
+    printf("S %d %lld %d\n", scenario.nScenario, (long long)end, gDataModel.nState == kState_Error ? 1 : 0);
+    for (int a = 0; a < kAlarmCount; ++a)
+    {
+        const tAlarmTrack& track = session.pAlarms[a];
+        int outcome = kOutcome_NoHazard;
+        int64_t latency = -1;
+        if (track.nOnset_ms < 0 && track.nDetect_ms >= 0)
+        {
+            outcome = kOutcome_Early;
+        }
+        else if (track.nOnset_ms >= 0)
+        {
+            bool bCovered = false;
+            for (int b = 0; b < kAlarmCount; ++b)
+            {
+                bCovered |= b != a && session.pAlarms[b].nDetect_ms >= track.nOnset_ms;
+            }
+
+            if (track.nDetect_ms >= 0)
+            {
+                outcome = kOutcome_Detected;
+                latency = std::max<int64_t>(track.nDetect_ms - track.nOnset_ms, 0);
+            }
+            else if (bCovered)
+            {
+                outcome = kOutcome_Covered;
+            }
+            else if (end - track.nOnset_ms < (int64_t)kAlarmTruths[a].nCensor_ms)
+            {
+                outcome = kOutcome_Censored;
+            }
+            else
+            {
+                outcome = kOutcome_Missed;
+            }
+        }
+        printf("A %d %d %lld %d\n", a, outcome, (long long)latency, track.nFalse);
+    }
+
+    return 0;
+}
+
+/// \struct tAlarmStats
+/// \brief Outcomes of an alarm over every session
+struct tAlarmStats
+{
+    int                     pOutcomes[kOutcome_Count];
+    std::vector<int64_t>    latencies;
+    int                     nFalse;
+    int                     nFalseSessions;
+};
+
+// Nearest rank percentile of sorted values
+static int64_t Percentile(const std::vector<int64_t>& sorted, float fRank)
+{
+    if (sorted.empty())
+    {
+        return -1;
+    }
+    size_t index = static_cast<size_t>(ceilf(fRank * sorted.size()));
+    return sorted[std::min(std::max<size_t>(index, 1), sorted.size()) - 1];
+}
+
+static void PrintMs(int64_t nValue)
+{
+    if (nValue < 0)
+    {
+        printf(" %8s", "-");
+    }
+    else
+    {
+        printf(" %8lld", (long long)nValue);
+    }
+}
+
+static void Usage()
+{
+    printf("usage: tlc_safetymc [--sessions N] [--seed N] [--duration S] [--threads N] [--scenario NAME]\n"
+           "scenarios:");
+    for (const char* szName : kScenarioNames)
+    {
+        printf(" %s", szName);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    int sessions = 2000;
+    uint32_t seed = 1;
+    float duration = 60.0f;
+    unsigned threads = Runner_DefaultThreads();
+    long long runSeed = -1;
+    int forced = -1;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        bool bValue = a + 1 < argc;
+        if (!strcmp(argv[a], "--run") && bValue)                runSeed = atoll(argv[++a]);
+        else if (!strcmp(argv[a], "--sessions") && bValue)      sessions = std::max(atoi(argv[++a]), 1);
+        else if (!strcmp(argv[a], "--seed") && bValue)          seed = strtoul(argv[++a], nullptr, 0);
+        else if (!strcmp(argv[a], "--duration") && bValue)      duration = std::max((float)atof(argv[++a]), 1.0f);
+        else if (!strcmp(argv[a], "--threads") && bValue)       threads = std::max(atoi(argv[++a]), 1);
+        else if (!strcmp(argv[a], "--scenario") && bValue)
+        {
+            const char* szName = argv[++a];
+            for (int b = 0; b < kScenario_Count; ++b)
+            {
+                forced = strcmp(szName, kScenarioNames[b]) ? forced : b;
+            }
+            if (forced < 0)
+            {
+                Usage();
+                return 2;
+            }
+        }
+        else
+        {
+            Usage();
+            return 2;
+        }
+    }
+
+    if (runSeed >= 0)
+    {
+        return RunSession(static_cast<uint32_t>(runSeed), duration, forced);
+    }
+
+    std::string self = Runner_Self();
+    std::vector<std::string> commands;
+    for (int a = 0; a < sessions; ++a)
+    {
+        char command[512];
+        snprintf(command, sizeof(command), "'%s' --run %u --duration %g%s%s", self.c_str(), seed + a, duration,
+                 forced >= 0 ? " --scenario " : "", forced >= 0 ? kScenarioNames[forced] : "");
+        commands.push_back(command);
+    }
+
+    printf("Sessions: %d of %gs from seed %u on %u workers\n", sessions, duration, seed, threads);
+    fflush(stdout);
+    std::vector<std::string> outputs = Runner_Map(commands, threads);
+
+    tAlarmStats stats[kAlarmCount] = {};
+    int scenarioSessions[kScenario_Count] = {};
+    int scenarioStops[kScenario_Count] = {};
+    double ventilation_ms = 0.0;
+    int failed = 0;
+
+    for (const std::string& output : outputs)
+    {
+        int scenario, stopped;
+        long long end;
+        const char* pLine = output.c_str();
+        if (sscanf(pLine, "S %d %lld %d", &scenario, &end, &stopped) != 3 || scenario < 0 || scenario >= kScenario_Count)
+        {
+            ++failed;
+            continue;
+        }
+        ++scenarioSessions[scenario];
+        scenarioStops[scenario] += stopped;
+        ventilation_ms += end;
+
+        for (pLine = strchr(pLine, '\n'); pLine != nullptr; pLine = strchr(pLine + 1, '\n'))
+        {
+            int alarm, outcome, falseCount;
+            long long latency;
+            if (sscanf(pLine + 1, "A %d %d %lld %d", &alarm, &outcome, &latency, &falseCount) != 4 ||
+                alarm < 0 || alarm >= kAlarmCount || outcome < 0 || outcome >= kOutcome_Count)
+            {
+                continue;
+            }
+
+            tAlarmStats& alarmStats = stats[alarm];
+            ++alarmStats.pOutcomes[outcome];
+            if (outcome == kOutcome_Detected)
+            {
+                alarmStats.latencies.push_back(latency);
+            }
+            alarmStats.nFalse           += falseCount;
+            alarmStats.nFalseSessions   += falseCount > 0 ? 1 : 0;
+        }
+    }
+
+    double hours = ventilation_ms / 3.6e6;
+    printf("Ventilation: %.2f h observed, %d failed sessions\n\n", hours, failed);
+
+    printf("%-14s %9s %9s\n", "scenario", "sessions", "stopped");
+    for (int a = 0; a < kScenario_Count; ++a)
+    {
+        printf("%-14s %9d %9d\n", kScenarioNames[a], scenarioSessions[a], scenarioStops[a]);
+    }
+
+    printf("\nDetection of hazards, latency in ms from onset:\n");
+    printf("%-28s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n", "alarm", "hazards", "detected", "covered", "censored", "missed", "early", "p50", "p95", "p99", "max");
+    for (int a = 0; a < kAlarmCount; ++a)
+    {
+        tAlarmStats& alarmStats = stats[a];
+        std::sort(alarmStats.latencies.begin(), alarmStats.latencies.end());
+        int hazards = sessions - failed - alarmStats.pOutcomes[kOutcome_NoHazard] - alarmStats.pOutcomes[kOutcome_Early];
+        printf("%-28s %8d %8d %8d %8d %8d %8d", kAlarmTruths[a].szName, hazards, alarmStats.pOutcomes[kOutcome_Detected],
+               alarmStats.pOutcomes[kOutcome_Covered], alarmStats.pOutcomes[kOutcome_Censored], alarmStats.pOutcomes[kOutcome_Missed],
+               alarmStats.pOutcomes[kOutcome_Early]);
+        PrintMs(Percentile(alarmStats.latencies, 0.50f));
+        PrintMs(Percentile(alarmStats.latencies, 0.95f));
+        PrintMs(Percentile(alarmStats.latencies, 0.99f));
+        PrintMs(alarmStats.latencies.empty() ? -1 : alarmStats.latencies.back());
+        printf("\n");
+    }
+
+    printf("\nFalse alarms, raised with no hazard near within the alarm lookback:\n");
+    printf("%-28s %8s %8s %10s\n", "alarm", "raises", "sessions", "per hour");
+    for (int a = 0; a < kAlarmCount; ++a)
+    {
+        printf("%-28s %8d %8d %10.3f\n", kAlarmTruths[a].szName, stats[a].nFalse, stats[a].nFalseSessions, hours > 0.0 ? stats[a].nFalse / hours : 0.0);
+    }
+
+    // Degraded sensors the fusion can attribute must not stop ventilation
+    bool bPass = failed == 0;
+    for (int a = 0; a < kScenario_Count; ++a)
+    {
+        if (kScenarioKeepsVentilating[a] && scenarioStops[a] > 0)
+        {
+            printf("\nFAIL: %d of %d %s sessions stopped ventilating\n", scenarioStops[a], scenarioSessions[a], kScenarioNames[a]);
+            bPass = false;
+        }
+    }
+    if (failed > 0)
+    {
+        printf("\nFAIL: %d sessions failed to run\n", failed);
+    }
+
+    return bPass ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+///
+/// \file       arduino.cpp
+/// \brief      Host stand-in of the Arduino core used by the firmware
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    hostarduino
+#include "host.h"
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <TimerOne.h>
+
+tHost           gHost;
+HardwareSerial  Serial;
+EEPROMClass     EEPROM;
+TimerOne        Timer1;
+
+volatile uint8_t    ADCSRA, ADCSRB, ADMUX, DIDR0, TIMSK1, TIFR1, SREG, MCUSR, WDTCSR;
+volatile uint16_t   ADC, TCNT1, ICR1, OCR1A, OCR1B;
+
+// Linker symbols of the AVR memory report. A heap end above the stack leaves stack painting out.
+uint8_t __heap_start;
+extern "C" { void* __brkval = reinterpret_cast<void*>(~static_cast<uintptr_t>(0) >> 1); }
+
+void Host_Init()
+{
+    gHost.nTime_us      = 0;
+    gHost.pAnalogRead   = nullptr;
+    memset(gHost.pPinMode, INPUT, sizeof(gHost.pPinMode));
+    memset(gHost.pPinOutput, LOW, sizeof(gHost.pPinOutput));
+    gHost.szSerialRx.clear();
+    gHost.szSerialTx.clear();
+
+    ADCSRA = ADCSRB = ADMUX = DIDR0 = TIMSK1 = TIFR1 = SREG = MCUSR = WDTCSR = 0;
+    ADC = TCNT1 = ICR1 = OCR1A = OCR1B = 0;
+    memset(EEPROM.pData, 0xFF, sizeof(EEPROM.pData));
+    Timer1 = TimerOne();
+}
+
+void Host_Advance(uint32_t nDelta_us)
+{
+    gHost.nTime_us += nDelta_us;
+}
+
+uint32_t millis()
+{
+    return static_cast<uint32_t>(gHost.nTime_us / 1000);
+}
+
+uint32_t micros()
+{
+    return static_cast<uint32_t>(gHost.nTime_us);
+}
+
+void delay(uint32_t nDelay_ms)
+{
+    Host_Advance(nDelay_ms * 1000);
+}
+
+void delayMicroseconds(unsigned int nDelay_us)
+{
+    Host_Advance(nDelay_us);
+}
+
+int analogRead(uint8_t nPin)
+{
+    uint8_t channel = (nPin >= A0) ? nPin - A0 : nPin;
+    return gHost.pAnalogRead ? gHost.pAnalogRead(channel) : 0;
+}
+
+void pinMode(uint8_t nPin, uint8_t nMode)
+{
+    if (nPin < kHostPinCount)
+    {
+        gHost.pPinMode[nPin] = nMode;
+    }
+}
+
+void digitalWrite(uint8_t nPin, uint8_t nValue)
+{
+    if (nPin < kHostPinCount)
+    {
+        gHost.pPinOutput[nPin] = nValue;
+    }
+}
+
+char* dtostrf(double fValue, signed char nWidth, unsigned char nPrecision, char* szBuffer)
+{
+    sprintf(szBuffer, "%*.*f", nWidth, nPrecision, fValue);
+    return szBuffer;
+}
+
+char* ltoa(long nValue, char* szBuffer, int nRadix)
+{
+    if (nValue < 0 && nRadix == 10)
+    {
+        szBuffer[0] = '-';
+        ultoa(-static_cast<unsigned long>(nValue), szBuffer + 1, nRadix);
+        return szBuffer;
+    }
+
+    return ultoa(static_cast<unsigned long>(nValue), szBuffer, nRadix);
+}
+
+char* itoa(int nValue, char* szBuffer, int nRadix)
+{
+    // int is 16 bits on the target
+    if (nRadix != 10)
+    {
+        return ultoa(static_cast<uint16_t>(nValue), szBuffer, nRadix);
+    }
+
+    return ltoa(static_cast<int16_t>(nValue), szBuffer, nRadix);
+}
+
+char* ultoa(unsigned long nValue, char* szBuffer, int nRadix)
+{
+    char digits[8 * sizeof(unsigned long) + 1];
+    int  count = 0;
+    do
+    {
+        unsigned long digit = nValue % nRadix;
+        digits[count++] = static_cast<char>(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        nValue /= nRadix;
+    } while (nValue != 0);
+
+    for (int a = 0; a < count; ++a)
+    {
+        szBuffer[a] = digits[count - 1 - a];
+    }
+    szBuffer[count] = '\0';
+    return szBuffer;
+}
+
+void HardwareSerial::begin(long)
+{
+}
+
+void HardwareSerial::setTimeout(long)
+{
+}
+
+int HardwareSerial::available()
+{
+    return static_cast<int>(gHost.szSerialRx.size());
+}
+
+int HardwareSerial::read()
+{
+    if (gHost.szSerialRx.empty())
+    {
+        return -1;
+    }
+
+    int value = static_cast<uint8_t>(gHost.szSerialRx[0]);
+    gHost.szSerialRx.erase(0, 1);
+    return value;
+}
+
+size_t HardwareSerial::readBytes(uint8_t* pBuffer, size_t nLength)
+{
+    size_t count = min(nLength, gHost.szSerialRx.size());
+    memcpy(pBuffer, gHost.szSerialRx.data(), count);
+    gHost.szSerialRx.erase(0, count);
+    return count;
+}
+
+size_t HardwareSerial::readBytes(char* pBuffer, size_t nLength)
+{
+    return readBytes(reinterpret_cast<uint8_t*>(pBuffer), nLength);
+}
+
+size_t HardwareSerial::write(uint8_t nValue)
+{
+    gHost.szSerialTx.push_back(static_cast<char>(nValue));
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* pBuffer, size_t nLength)
+{
+    gHost.szSerialTx.append(reinterpret_cast<const char*>(pBuffer), nLength);
+    return nLength;
+}
+
+size_t HardwareSerial::print(const char* szValue)
+{
+    size_t length = strlen(szValue);
+    gHost.szSerialTx.append(szValue, length);
+    return length;
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper* szValue)
+{
+    return print(reinterpret_cast<const char*>(szValue));
+}
+
+size_t HardwareSerial::print(char cValue)
+{
+    return write(static_cast<uint8_t>(cValue));
+}
+
+size_t HardwareSerial::println(const char* szValue)
+{
+    return print(szValue) + println();
+}
+
+size_t HardwareSerial::println(const __FlashStringHelper* szValue)
+{
+    return print(szValue) + println();
+}
+
+size_t HardwareSerial::println()
+{
+    return print("\r\n");
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+
+#define BUTTON_UP       0x08
+#define BUTTON_DOWN     0x04
+#define BUTTON_LEFT     0x10
+#define BUTTON_RIGHT    0x02
+#define BUTTON_SELECT   0x01
+
+// No display on the host, no button is ever pressed
+class Adafruit_RGBLCDShield
+{
+public:
+    void    begin(uint8_t, uint8_t) {}
+    void    clear() {}
+    void    setBacklight(uint8_t) {}
+    void    setCursor(uint8_t, uint8_t) {}
+    void    print(const char*) {}
+    void    print(const __FlashStringHelper*) {}
+    uint8_t readButtons() { return 0; }
+};
@@ -0,0 +1,131 @@
+///
+/// \file       Arduino.h
+/// \brief      Host stand-in of the Arduino core used by the firmware
+///
+/// Only what the firmware uses is provided. Registers are plain variables driven by the simulator,
+/// flash is ordinary memory and time only advances when the simulator says so.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   hostarduino Host Arduino core
+#ifndef TLC_HOST_ARDUINO_H
+#define TLC_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0
+#define OUTPUT  1
+
+#define PI 3.1415926535897932384626433832795
+
+// Flash is ordinary memory on the host
+#define PROGMEM
+#define PSTR(s)                 (s)
+#define F(s)                    (reinterpret_cast<const __FlashStringHelper*>(s))
+#define pgm_read_byte(p)        (*(const uint8_t*)(p))
+#define pgm_read_word(p)        (*(const uint16_t*)(p))
+#define pgm_read_dword(p)       (*(const uint32_t*)(p))
+#define pgm_read_float(p)       (*(const float*)(p))
+#define pgm_read_ptr(p)         (*(void* const*)(p))
+#define memcpy_P                memcpy
+#define strcpy_P                strcpy
+#define strncmp_P               strncmp
+#define strcmp_P                strcmp
+#define sprintf_P               sprintf
+#define snprintf_P              snprintf
+
+// Interrupt vectors are plain functions called by the simulator, interrupts never preempt the loop
+#define ISR(vector)             extern "C" void vector(void)
+#define cli()
+#define sei()
+#define noInterrupts()
+#define interrupts()
+
+#define _BV(b)                  (1 << (b))
+#define bit(b)                  (1UL << (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef uint8_t byte;
+class __FlashStringHelper;
+
+template <class T> inline T min(T a, T b) { return a < b ? a : b; }
+template <class T> inline T max(T a, T b) { return a > b ? a : b; }
+
+// ATmega328P registers used by the firmware
+extern volatile uint8_t     ADCSRA, ADCSRB, ADMUX, DIDR0, TIMSK1, TIFR1, SREG, MCUSR, WDTCSR;
+extern volatile uint16_t    ADC, TCNT1, ICR1, OCR1A, OCR1B;
+
+#define ADEN    7
+#define ADSC    6
+#define ADATE   5
+#define ADIF    4
+#define ADIE    3
+#define REFS0   6
+#define TOIE1   0
+#define OCIE1B  2
+#define OCF1B   2
+#define TOV1    0
+#define PORF    0
+#define EXTRF   1
+#define BORF    2
+#define WDRF    3
+#define WDIE    6
+
+// RAM usage is not modelled, MEM reports are meaningless on the host
+#define RAMSTART    0x100
+#define RAMEND      0x8FF
+
+uint32_t millis();
+uint32_t micros();
+void     delay(uint32_t nDelay_ms);
+void     delayMicroseconds(unsigned int nDelay_us);
+int      analogRead(uint8_t nPin);
+void     pinMode(uint8_t nPin, uint8_t nMode);
+void     digitalWrite(uint8_t nPin, uint8_t nValue);
+
+char*    dtostrf(double fValue, signed char nWidth, unsigned char nPrecision, char* szBuffer);
+char*    itoa(int nValue, char* szBuffer, int nRadix);
+char*    ltoa(long nValue, char* szBuffer, int nRadix);
+char*    ultoa(unsigned long nValue, char* szBuffer, int nRadix);
+
+/// \class HardwareSerial
+/// \brief Serial port, received bytes are queued by the simulator and sent bytes are collected for it
+class HardwareSerial
+{
+public:
+    void    begin(long nBaudRate);
+    void    setTimeout(long nTimeout_ms);
+    explicit operator bool() const { return true; }
+
+    int     available();
+    int     read();
+    size_t  readBytes(uint8_t* pBuffer, size_t nLength);
+    size_t  readBytes(char* pBuffer, size_t nLength);
+
+    size_t  write(uint8_t nValue);
+    size_t  write(const uint8_t* pBuffer, size_t nLength);
+    void    flush() {}
+
+    size_t  print(const char* szValue);
+    size_t  print(const __FlashStringHelper* szValue);
+    size_t  print(char cValue);
+    size_t  println(const char* szValue);
+    size_t  println(const __FlashStringHelper* szValue);
+    size_t  println();
+};
+extern HardwareSerial Serial;
+
+#endif // TLC_HOST_ARDUINO_H
@@ -0,0 +1,16 @@
+#pragma once
+#include <Arduino.h>
+
+// 1KB of ATmega328P EEPROM, erased to 0xFF
+class EEPROMClass
+{
+public:
+    uint8_t&    operator[](int nAddress) { return pData[nAddress & 0x3FF]; }
+    uint8_t     read(int nAddress) { return pData[nAddress & 0x3FF]; }
+    void        write(int nAddress, uint8_t nValue) { pData[nAddress & 0x3FF] = nValue; }
+    void        update(int nAddress, uint8_t nValue) { pData[nAddress & 0x3FF] = nValue; }
+    uint16_t    length() { return sizeof(pData); }
+
+    uint8_t     pData[1024];
+};
+extern EEPROMClass EEPROM;
@@ -0,0 +1,14 @@
+#pragma once
+#include <Arduino.h>
+
+// Servo pulse width in microseconds, read back by the plant
+class ServoTimer2
+{
+public:
+    void    attach(int nPin) { nAttachedPin = nPin; }
+    void    write(int nPulse_us) { nPulseWidth_us = nPulse_us; }
+    int     read() { return nPulseWidth_us; }
+
+    int     nAttachedPin    = -1;
+    int     nPulseWidth_us  = 0;
+};
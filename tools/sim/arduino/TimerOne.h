@@ -0,0 +1,19 @@
+#pragma once
+#include <Arduino.h>
+
+// Timer1 in phase and frequency correct PWM, the simulator calls the overflow callback at the bottom of every period
+class TimerOne
+{
+public:
+    void    initialize(long nPeriod_us = 1000000) { nPeriod = nPeriod_us; ICR1 = (uint16_t)(nPeriod_us * 8); }
+    void    pwm(char nPin, unsigned int nDuty) { if (nPin == 9) nDutyA = nDuty; else nDutyB = nDuty; }
+    void    setPwmDuty(char nPin, unsigned int nDuty) { pwm(nPin, nDuty); }
+    void    attachInterrupt(void (*pIsr)()) { pCallback = pIsr; TIMSK1 |= _BV(TOIE1); }
+    void    detachInterrupt() { TIMSK1 &= ~_BV(TOIE1); }
+
+    long            nPeriod     = 1000000;  // PWM period in microseconds
+    unsigned int    nDutyA      = 0;        // Duty of pin 9 (0..1023)
+    unsigned int    nDutyB      = 0;        // Duty of pin 10 (0..1023)
+    void            (*pCallback)() = nullptr;
+};
+extern TimerOne Timer1;
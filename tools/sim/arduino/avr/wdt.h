@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+
+#define WDTO_15MS   0
+#define WDTO_1S     6
+#define WDTO_2S     7
+#define WDTO_4S     8
+#define WDTO_8S     9
+
+// The watchdog is not modelled, the simulated loop never stalls
+inline void wdt_enable(uint8_t) {}
+inline void wdt_disable() {}
+inline void wdt_reset() {}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Unused by the firmware, included through common.h
+class millisDelay {};
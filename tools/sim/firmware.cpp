@@ -0,0 +1,7 @@
+///
+/// \file       firmware.cpp
+/// \brief      Main source file of the firmware, compiled for the host simulator
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "tlc.ino"
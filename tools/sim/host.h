@@ -0,0 +1,44 @@
+///
+/// \file       host.h
+/// \brief      Simulator side of the host Arduino core
+///
+/// Simulated time, pins and the serial port seen from the simulator. The firmware only sees Arduino.h.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    hostarduino
+#ifndef TLC_HOST_H
+#define TLC_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+/// \enum eHostConsts
+/// \brief Host Arduino core constants
+enum eHostConsts
+{
+    kHostPinCount   = 20,   ///> Digital and analog pins of the ATmega328P
+};
+
+/// \struct tHost
+/// \brief State of the host Arduino core
+struct tHost
+{
+    uint64_t    nTime_us;                   ///> Simulated time since reset
+    uint8_t     pPinMode[kHostPinCount];    ///> pinMode of every pin
+    uint8_t     pPinOutput[kHostPinCount];  ///> digitalWrite level of every pin
+    uint16_t    (*pAnalogRead)(uint8_t nChannel);   ///> Conversion of ADC channel 0..7, nullptr reads 0
+    std::string szSerialRx;                 ///> Bytes sent to the firmware, not read yet
+    std::string szSerialTx;                 ///> Bytes sent by the firmware, not consumed yet
+};
+extern tHost gHost;
+
+/// \fn void Host_Init()
+/// \brief Reset time, pins, registers, EEPROM (erased) and the serial port
+void Host_Init();
+
+/// \fn void Host_Advance(uint32_t nDelta_us)
+/// \brief Advance simulated time
+void Host_Advance(uint32_t nDelta_us);
+
+#endif // TLC_HOST_H
@@ -0,0 +1,166 @@
+///
+/// \file       plant.cpp
+/// \brief      Plant model of the ventilator: pump, circuit, exhale valve, lung, sensors and battery
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    plant
+#include "plant.h"
+#include "defs.h"
+
+#include <math.h>
+
+tPlant gPlant;
+
+const float kPressureCountsPerMmH2O = kMPX5010_Sensitivity_mV_mmH2O * 1024.0f / 5000.0f;   // Inverse of the firmware pressure transfer
+const float kBatteryCountsPerVolt   = 1024.0f / 5.0f / kBatteryLevelGain;                   // Inverse of the firmware battery transfer
+const float kAdcFullScale           = 1023.0f;
+
+tPlantParams Plant_DefaultParams()
+{
+    tPlantParams params = {};
+    params.fCompliance          = 5.0f;     // 50 mL/cmH2O
+    params.fAirwayResistance    = 0.1f;     // 10 cmH2O/(L/s)
+    params.fLeakResistance      = 0.0f;
+    params.fExhaleResistance    = 0.3f;
+    params.fPumpStall_mmH2O     = 900.0f;
+    params.fPumpResistance      = 0.5f;
+    params.fPumpExponent        = 1.5f;
+    params.fPumpTimeConstant_s  = 0.03f;
+    params.fValveStroke_s       = 0.15f;
+    params.nServoOpen_us        = 2270;
+    params.nServoClose_us       = 750;
+    params.fBattery_V           = 12.6f;
+    params.fBatteryDrain_V_s    = 0.0f;
+    params.fBatteryNoise_V      = 0.02f;
+    params.fPumpRunawayOnset_s  = -1.0f;
+    params.fEffortRate          = 0.0f;
+    params.fEffortAmplitude_mmH2O = 0.0f;
+    params.fEffortDuration_s    = 0.8f;
+    params.fEffortOnset_s       = 0.0f;
+
+    for (int a = 0; a < kPlantPressureChannelCount; ++a)
+    {
+        tSensorParams& sensor = params.pSensors[a];
+        sensor.fOffset_counts   = 41.0f;    // 0.2V at atmosphere
+        sensor.fGainError       = 0.0f;
+        sensor.fNoise_counts    = 0.7f;
+    }
+
+    return params;
+}
+
+void Plant_Init(const tPlantParams& params, uint32_t nSeed)
+{
+    gPlant.params               = params;
+    gPlant.fTime_s              = 0.0f;
+    gPlant.fLungPressure_mmH2O  = 0.0f;
+    gPlant.fPressure_mmH2O      = 0.0f;
+    gPlant.fPumpPressure_mmH2O  = 0.0f;
+    gPlant.fValveOpening        = 1.0f;
+    gPlant.fFlow_mL_s           = 0.0f;
+    gPlant.fMuscle_mmH2O        = 0.0f;
+    gPlant.rng.seed(nSeed);
+}
+
+// Event scheduled at fOnset_s has started, negative onsets never start
+static bool HasStarted(float fOnset_s)
+{
+    return fOnset_s >= 0.0f && gPlant.fTime_s >= fOnset_s;
+}
+
+float Plant_EffortStart(float fTime_s)
+{
+    const tPlantParams& params = gPlant.params;
+    if (params.fEffortRate <= 0.0f || fTime_s < params.fEffortOnset_s)
+    {
+        return -1.0f;
+    }
+
+    float period = 60.0f / params.fEffortRate;
+    float start = params.fEffortOnset_s + floorf((fTime_s - params.fEffortOnset_s) / period) * period;
+    return (fTime_s - start < params.fEffortDuration_s) ? start : -1.0f;
+}
+
+void Plant_Step(float fDelta_s, unsigned int nDuty, int nServo_us)
+{
+    const tPlantParams& params = gPlant.params;
+
+    // Pump pressure follows the duty with a first order lag
+    float duty = HasStarted(params.fPumpRunawayOnset_s) ? 1.0f : fminf(nDuty, 1023u) / 1023.0f;
+    float target = params.fPumpStall_mmH2O * powf(duty, params.fPumpExponent);
+    gPlant.fPumpPressure_mmH2O += (target - gPlant.fPumpPressure_mmH2O) * fminf(fDelta_s / params.fPumpTimeConstant_s, 1.0f);
+
+    // Exhale valve moves toward the servo position at its stroke rate
+    float position = (float)(nServo_us - params.nServoClose_us) / (float)(params.nServoOpen_us - params.nServoClose_us);
+    position = fminf(fmaxf(position, 0.0f), 1.0f);
+    float step = fDelta_s / params.fValveStroke_s;
+    gPlant.fValveOpening += fminf(fmaxf(position - gPlant.fValveOpening, -step), step);
+
+    // Patient effort pulls the alveolar pressure down, the elastic recoil is unchanged
+    float start = Plant_EffortStart(gPlant.fTime_s);
+    gPlant.fMuscle_mmH2O = (start >= 0.0f) ? -params.fEffortAmplitude_mmH2O * sinf(3.14159265f * (gPlant.fTime_s - start) / params.fEffortDuration_s) : 0.0f;
+    float alveolar = gPlant.fLungPressure_mmH2O + gPlant.fMuscle_mmH2O;
+
+    // Flow balance at the proximal node, the pump check valve blocks back flow
+    float gPump    = 1.0f / params.fPumpResistance;
+    float gAirway  = 1.0f / params.fAirwayResistance;
+    float gVent    = gPlant.fValveOpening / params.fExhaleResistance;
+    if (params.fLeakResistance > 0.0f)
+    {
+        gVent += 1.0f / params.fLeakResistance;
+    }
+
+    float pressure = (gPump * gPlant.fPumpPressure_mmH2O + gAirway * alveolar) / (gPump + gAirway + gVent);
+    if (pressure > gPlant.fPumpPressure_mmH2O)
+    {
+        pressure = gAirway * alveolar / (gAirway + gVent);
+    }
+
+    gPlant.fPressure_mmH2O       = pressure;
+    gPlant.fFlow_mL_s            = (pressure - alveolar) * gAirway;
+    gPlant.fLungPressure_mmH2O  += gPlant.fFlow_mL_s / params.fCompliance * fDelta_s;
+    gPlant.fTime_s              += fDelta_s;
+}
+
+float Plant_SensorCounts(uint8_t nChannel)
+{
+    const tSensorParams& sensor = gPlant.params.pSensors[nChannel];
+    return sensor.fOffset_counts + gPlant.fPressure_mmH2O * kPressureCountsPerMmH2O * (1.0f + sensor.fGainError);
+}
+
+float Plant_BatteryVoltage()
+{
+    return gPlant.params.fBattery_V - gPlant.params.fBatteryDrain_V_s * gPlant.fTime_s;
+}
+
+// Quantize to the 10 bits ADC
+static uint16_t Quantize(float fCounts)
+{
+    return (uint16_t)lroundf(fminf(fmaxf(fCounts, 0.0f), kAdcFullScale));
+}
+
+uint16_t Plant_Adc(uint8_t nChannel)
+{
+    if (nChannel < kPlantPressureChannelCount)
+    {
+        const tSensorParams& sensor = gPlant.params.pSensors[nChannel];
+        float counts = Plant_SensorCounts(nChannel);
+        if (sensor.fNoise_counts > 0.0f)
+        {
+            counts += std::normal_distribution<float>(0.0f, sensor.fNoise_counts)(gPlant.rng);
+        }
+        return Quantize(counts);
+    }
+
+    if (nChannel == kPlantPressureChannelCount)
+    {
+        float voltage = Plant_BatteryVoltage();
+        if (gPlant.params.fBatteryNoise_V > 0.0f)
+        {
+            voltage += std::normal_distribution<float>(0.0f, gPlant.params.fBatteryNoise_V)(gPlant.rng);
+        }
+        return Quantize(voltage * kBatteryCountsPerVolt);
+    }
+
+    return 0;
+}
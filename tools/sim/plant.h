@@ -0,0 +1,110 @@
+///
+/// \file       plant.h
+/// \brief      Plant model of the ventilator: pump, circuit, exhale valve, lung, sensors and battery
+///
+/// Single compartment lung behind an airway resistance, with optional periodic patient inspiratory efforts
+/// (muscle pressure pulling the alveolar pressure down). The pump is a pressure source behind a
+/// resistance and a check valve, the exhale valve and a leak vent the proximal node to atmosphere.
+/// The proximal node has no compliance, so its pressure is solved from the flow balance at every step.
+/// Pressure sensors read the proximal pressure in ADC counts, with offset, gain error and noise.
+/// Sensor and exhale valve faults go through the firmware fault injector (FAULT_INJECTION), the plant
+/// only models the faults the firmware can't inject: a pump driver runaway and a draining battery.
+///
+/// Units: pressure in mmH2O, flow in mL/s, resistance in mmH2O/(mL/s), compliance in mL/mmH2O.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   plant Plant model
+#ifndef TLC_PLANT_H
+#define TLC_PLANT_H
+
+#include <stdint.h>
+#include <random>
+
+/// \enum ePlantConsts
+/// \brief Plant model constants
+enum ePlantConsts
+{
+    kPlantPressureChannelCount  = 2,    ///> Redundant pressure sensors, as kPressureChannelCount
+    kPlantAdcChannelCount       = 3,    ///> Pressure 0, pressure 1, battery
+};
+
+/// \struct tSensorParams
+/// \brief Pressure sensor parameters
+struct tSensorParams
+{
+    float       fOffset_counts;         ///> Reading at atmosphere
+    float       fGainError;             ///> Relative error of the sensitivity
+    float       fNoise_counts;          ///> Standard deviation of the reading noise
+};
+
+/// \struct tPlantParams
+/// \brief Plant model parameters
+struct tPlantParams
+{
+    float           fCompliance;            ///> Lung compliance
+    float           fAirwayResistance;      ///> Airway resistance between circuit and lung
+    float           fLeakResistance;        ///> Circuit leak to atmosphere, 0 for none
+    float           fExhaleResistance;      ///> Exhale valve fully open
+    float           fPumpStall_mmH2O;       ///> Pump pressure at full duty and no flow
+    float           fPumpResistance;        ///> Pump internal resistance
+    float           fPumpExponent;          ///> Pump pressure exponent of the duty
+    float           fPumpTimeConstant_s;    ///> Pump pressure response time constant
+    float           fValveStroke_s;         ///> Exhale valve full stroke time
+    int             nServoOpen_us;          ///> Servo pulse of the fully open exhale valve
+    int             nServoClose_us;         ///> Servo pulse of the closed exhale valve
+    float           fBattery_V;             ///> Battery voltage at start
+    float           fBatteryDrain_V_s;      ///> Battery voltage drop rate
+    float           fBatteryNoise_V;        ///> Battery reading noise
+    float           fPumpRunawayOnset_s;    ///> Pump runs at full duty whatever the command from this time, negative for never
+    float           fEffortRate;            ///> Patient inspiratory efforts per minute, 0 for a passive patient
+    float           fEffortAmplitude_mmH2O; ///> Peak muscle pressure of an effort
+    float           fEffortDuration_s;      ///> Effort length, half sine of the muscle pressure
+    float           fEffortOnset_s;         ///> First effort start
+    tSensorParams   pSensors[kPlantPressureChannelCount];   ///> Pressure sensors
+};
+
+/// \struct tPlant
+/// \brief Plant model state
+struct tPlant
+{
+    tPlantParams    params;                 ///> Parameters of the running session
+    float           fTime_s;                ///> Time since start
+    float           fLungPressure_mmH2O;    ///> Alveolar pressure
+    float           fPressure_mmH2O;        ///> Proximal pressure, read by the sensors
+    float           fPumpPressure_mmH2O;    ///> Pump source pressure
+    float           fValveOpening;          ///> Exhale valve opening (0..1)
+    float           fFlow_mL_s;             ///> Flow into the lung
+    float           fMuscle_mmH2O;          ///> Patient muscle pressure, negative during an effort
+    std::mt19937    rng;                    ///> Noise generator, seeded per session
+};
+extern tPlant gPlant;
+
+/// \fn tPlantParams Plant_DefaultParams()
+/// \brief Adult lung, healthy sensors at the nominal atmosphere offset, full battery
+tPlantParams Plant_DefaultParams();
+
+/// \fn void Plant_Init(const tPlantParams& params, uint32_t nSeed)
+/// \brief Start a session at atmosphere
+void Plant_Init(const tPlantParams& params, uint32_t nSeed);
+
+/// \fn void Plant_Step(float fDelta_s, unsigned int nDuty, int nServo_us)
+/// \brief Integrate the plant for fDelta_s with pump duty (0..1023) and exhale servo pulse applied
+void Plant_Step(float fDelta_s, unsigned int nDuty, int nServo_us);
+
+/// \fn float Plant_EffortStart(float fTime_s)
+/// \brief Start of the patient effort in progress at fTime_s, negative when none
+float Plant_EffortStart(float fTime_s);
+
+/// \fn uint16_t Plant_Adc(uint8_t nChannel)
+/// \brief ADC conversion of channel 0..2 now, noise included
+uint16_t Plant_Adc(uint8_t nChannel);
+
+/// \fn float Plant_SensorCounts(uint8_t nChannel)
+/// \brief Noiseless pressure sensor reading in counts now, not clamped to the ADC span
+float Plant_SensorCounts(uint8_t nChannel);
+
+/// \fn float Plant_BatteryVoltage()
+/// \brief Noiseless battery voltage now
+float Plant_BatteryVoltage();
+
+#endif // TLC_PLANT_H
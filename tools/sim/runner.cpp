@@ -0,0 +1,83 @@
+///
+/// \file       runner.cpp
+/// \brief      Parallel runner of simulator sessions
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    runner
+#include "runner.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+std::string Runner_Self()
+{
+    char path[4096];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length <= 0)
+    {
+        return std::string();
+    }
+
+    return std::string(path, length);
+}
+
+unsigned Runner_DefaultThreads()
+{
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+// Run a command line, returns its standard output, empty if it failed
+static std::string RunCommand(const std::string& szCommand)
+{
+    FILE* pPipe = popen(szCommand.c_str(), "r");
+    if (pPipe == nullptr)
+    {
+        return std::string();
+    }
+
+    std::string output;
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), pPipe)) > 0)
+    {
+        output.append(buffer, length);
+    }
+
+    int status = pclose(pPipe);
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        output.clear();
+    }
+
+    return output;
+}
+
+std::vector<std::string> Runner_Map(const std::vector<std::string>& commands, unsigned nThreads)
+{
+    std::vector<std::string> outputs(commands.size());
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]()
+    {
+        for (size_t index = next++; index < commands.size(); index = next++)
+        {
+            outputs[index] = RunCommand(commands[index]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned a = 0; a < (nThreads > 0 ? nThreads : 1); ++a)
+    {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& thread : workers)
+    {
+        thread.join();
+    }
+
+    return outputs;
+}
@@ -0,0 +1,30 @@
+///
+/// \file       runner.h
+/// \brief      Parallel runner of simulator sessions
+///
+/// Firmware globals allow one simulated session per process, so every session is a child process
+/// of the tool itself (mode selected by its arguments). A pool of worker threads, one per core by
+/// default, takes sessions from a shared queue and collects the standard output of each child.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   runner Session runner
+#ifndef TLC_RUNNER_H
+#define TLC_RUNNER_H
+
+#include <string>
+#include <vector>
+
+/// \fn std::string Runner_Self()
+/// \brief Path of the running executable, to start sessions with
+std::string Runner_Self();
+
+/// \fn unsigned Runner_DefaultThreads()
+/// \brief One worker per core
+unsigned Runner_DefaultThreads();
+
+/// \fn std::vector<std::string> Runner_Map(const std::vector<std::string>& commands, unsigned nThreads)
+/// \brief Run every shell command line in parallel on nThreads workers, returns the output of each in order.
+/// A failed child gives an empty output.
+std::vector<std::string> Runner_Map(const std::vector<std::string>& commands, unsigned nThreads);
+
+#endif // TLC_RUNNER_H
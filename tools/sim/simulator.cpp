@@ -0,0 +1,196 @@
+///
+/// \file       simulator.cpp
+/// \brief      Host simulator running the unmodified firmware against the plant model
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "simulator.h"
+#include "host.h"
+
+#include "configuration.h"
+#include "control.h"
+#include "datamodel.h"
+#include "TimerOne.h"
+
+// Firmware entry points, tlc.ino
+void setup();
+void loop();
+
+// Firmware interrupt vectors
+extern "C" void TIMER1_COMPB_vect(void);
+extern "C" void ADC_vect(void);
+
+/// \enum eSimulatorConsts
+/// \brief Simulator private constants
+enum eSimulatorConsts
+{
+    kSimTxCompactSize   = 16384,    ///> Pending serial output size above which debug lines are dropped
+    kSimReplyTimeout_ms = 1000,     ///> Wait for a command reply
+};
+
+static const char kDebugPrefix[] = "DEBUG:";
+
+HXCOMPILATIONASSERT(assertSimStepCheck, (kSimLoopTime_us % kSimPlantStep_us == 0 && (kPeriodPumpPWM_us / 2) % kSimPlantStep_us == 0));
+
+// Complete conversions started by the firmware, each conversion complete interrupt may start the next one
+static void ServiceAdc()
+{
+    while ((ADCSRA & _BV(ADSC)) && (ADCSRA & _BV(ADIE)))
+    {
+        ADC     = Plant_Adc(ADMUX & 0x07);
+        ADCSRA &= ~_BV(ADSC);
+        ADC_vect();
+    }
+}
+
+// Timer1 interrupts of the phase and frequency correct PWM: overflow at the bottom, compare B at the top (OCR1B = ICR1)
+static void ServiceTimer1()
+{
+    uint64_t period = static_cast<uint64_t>(Timer1.nPeriod);
+    uint64_t phase  = gHost.nTime_us % period;
+
+    if (phase == 0 && (TIMSK1 & _BV(TOIE1)) && Timer1.pCallback != nullptr)
+    {
+        Timer1.pCallback();
+        ServiceAdc();
+    }
+    else if (phase == period / 2 && (TIMSK1 & _BV(OCIE1B)))
+    {
+        TIMER1_COMPB_vect();
+        ServiceAdc();
+    }
+}
+
+// Advance simulated time by a loop iteration, integrating the plant and firing interrupts on the way
+static void Advance(uint32_t nDelta_us)
+{
+    for (uint32_t elapsed = 0; elapsed < nDelta_us; elapsed += kSimPlantStep_us)
+    {
+        Plant_Step(kSimPlantStep_us * 1e-6f, Timer1.nDutyA, exhaleValveServo.nPulseWidth_us);
+        Host_Advance(kSimPlantStep_us);
+        ServiceTimer1();
+    }
+}
+
+// Drop debug lines from pending serial output, they are printed at every communications period
+static void CompactSerialOutput()
+{
+    std::string& tx = gHost.szSerialTx;
+    if (tx.size() < kSimTxCompactSize)
+    {
+        return;
+    }
+
+    std::string kept;
+    size_t start = 0;
+    for (size_t end = tx.find("\r\n"); end != std::string::npos; end = tx.find("\r\n", start))
+    {
+        if (tx.compare(start, sizeof(kDebugPrefix) - 1, kDebugPrefix) != 0)
+        {
+            kept.append(tx, start, end + 2 - start);
+        }
+        start = end + 2;
+    }
+    kept.append(tx, start, std::string::npos);
+    tx.swap(kept);
+}
+
+void Simulator_Init(const tPlantParams& params, uint32_t nSeed)
+{
+    Host_Init();
+    Plant_Init(params, nSeed);
+    gHost.pAnalogRead = Plant_Adc;
+
+    // Commissioned device: valid configuration in EEPROM, pressure offsets zeroed at atmosphere (IPS)
+    Configuration_SetDefaults();
+    for (uint8_t a = 0; a < kPressureChannelCount; ++a)
+    {
+        gConfiguration.nPressureSensorOffset[a] = static_cast<uint16_t>(lroundf(params.pSensors[a].fOffset_counts));
+    }
+    gConfiguration.nServoExhaleOpenAngle    = params.nServoOpen_us;
+    gConfiguration.nServoExhaleCloseAngle   = params.nServoClose_us;
+    Configuration_Write();
+
+    // Power-on reset
+    MCUSR = _BV(PORF);
+    setup();
+}
+
+void Simulator_Run(uint32_t nDuration_ms, void (*pObserver)(void* pContext), void* pContext)
+{
+    uint64_t end = gHost.nTime_us + static_cast<uint64_t>(nDuration_ms) * 1000;
+    while (gHost.nTime_us < end)
+    {
+        loop();
+        Advance(kSimLoopTime_us);
+        CompactSerialOutput();
+
+        if (pObserver != nullptr)
+        {
+            pObserver(pContext);
+        }
+    }
+}
+
+std::string Simulator_FrameBytes(const char* szOpcode, const void* pValue, size_t nSize)
+{
+    std::string frame(szOpcode, 3);
+    frame.append(static_cast<const char*>(pValue), nSize);
+    frame.append("\r\n");
+    return frame;
+}
+
+std::string Simulator_Frame(const char* szOpcode, const std::vector<float>& values)
+{
+    if (values.empty())
+    {
+        return Simulator_FrameBytes(szOpcode, nullptr, 0);
+    }
+
+    int32_t count = static_cast<int32_t>(values.size());
+    std::string payload(reinterpret_cast<const char*>(&count), sizeof(count));
+    payload.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+    return Simulator_FrameBytes(szOpcode, payload.data(), payload.size());
+}
+
+void Simulator_Send(const std::string& szFrame)
+{
+    gHost.szSerialRx.append(szFrame);
+}
+
+bool Simulator_ReadLine(std::string& szLine)
+{
+    std::string& tx = gHost.szSerialTx;
+    for (size_t end = tx.find("\r\n"); end != std::string::npos; end = tx.find("\r\n"))
+    {
+        bool bDebug = tx.compare(0, sizeof(kDebugPrefix) - 1, kDebugPrefix) == 0;
+        szLine.assign(tx, 0, end);
+        tx.erase(0, end + 2);
+        if (!bDebug)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Simulator_Command(const std::string& szFrame, std::string& szReply)
+{
+    Simulator_Send(szFrame);
+    for (uint32_t a = 0; a < kSimReplyTimeout_ms; ++a)
+    {
+        Simulator_Run(1, nullptr, nullptr);
+        if (Simulator_ReadLine(szReply))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Simulator_BuzzerOn()
+{
+    return gHost.pPinMode[PIN_OUT_BUZZER] == OUTPUT && gHost.pPinOutput[PIN_OUT_BUZZER] == LOW;
+}
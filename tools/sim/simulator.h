@@ -0,0 +1,61 @@
+///
+/// \file       simulator.h
+/// \brief      Host simulator running the unmodified firmware against the plant model
+///
+/// The firmware sources are compiled for the host against the Arduino stand-ins of this directory.
+/// Every loop() iteration takes kSimLoopTime_us of simulated time, during which the plant is
+/// integrated and the Timer1 and ADC interrupts fire at their simulated time. Firmware globals
+/// make the simulator a singleton: one session per process, sessions run in parallel as processes.
+///
+/// \author     The Lung Carburetor contributors
+/// \defgroup   simulator Host simulator
+#ifndef TLC_SIMULATOR_H
+#define TLC_SIMULATOR_H
+
+#include "plant.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// \enum eSimConsts
+/// \brief Simulator constants
+enum eSimConsts
+{
+    kSimLoopTime_us     = 200,  ///> Simulated duration of a loop() iteration
+    kSimPlantStep_us    = 100,  ///> Plant integration step
+};
+
+/// \fn void Simulator_Init(const tPlantParams& params, uint32_t nSeed)
+/// \brief Power up the firmware with a valid configuration in EEPROM, pressure offsets zeroed on the plant sensors
+void Simulator_Init(const tPlantParams& params, uint32_t nSeed);
+
+/// \fn void Simulator_Run(uint32_t nDuration_ms, void (*pObserver)(void* pContext), void* pContext)
+/// \brief Run the firmware loop for nDuration_ms, pObserver (may be nullptr) is called after every loop() iteration
+void Simulator_Run(uint32_t nDuration_ms, void (*pObserver)(void* pContext), void* pContext);
+
+/// \fn std::string Simulator_Frame(const char* szOpcode, const std::vector<float>& values)
+/// \brief Build a command frame: opcode, int32 count, float values, then CRLF. No value gives a bare opcode.
+std::string Simulator_Frame(const char* szOpcode, const std::vector<float>& values);
+
+/// \fn std::string Simulator_FrameBytes(const char* szOpcode, const void* pValue, size_t nSize)
+/// \brief Build a command frame: opcode, nSize raw bytes of pValue, then CRLF
+std::string Simulator_FrameBytes(const char* szOpcode, const void* pValue, size_t nSize);
+
+/// \fn void Simulator_Send(const std::string& szFrame)
+/// \brief Queue bytes on the firmware serial port
+void Simulator_Send(const std::string& szFrame);
+
+/// \fn bool Simulator_ReadLine(std::string& szLine)
+/// \brief Pop the next line sent by the firmware, debug lines are skipped. Returns false when none is complete.
+bool Simulator_ReadLine(std::string& szLine);
+
+/// \fn bool Simulator_Command(const std::string& szFrame, std::string& szReply)
+/// \brief Send a frame and run the loop until its reply line, returns false if none came within a second
+bool Simulator_Command(const std::string& szFrame, std::string& szReply);
+
+/// \fn bool Simulator_BuzzerOn()
+/// \brief Buzzer is sounding (active low output)
+bool Simulator_BuzzerOn();
+
+#endif // TLC_SIMULATOR_H
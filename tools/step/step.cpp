@@ -0,0 +1,336 @@
+///
+/// \file       step.cpp
+/// \brief      Rise time and overshoot of the inhale pressure on the host simulator
+///
+/// Runs respirations on a set of lungs and measures the proximal pressure of the plant on every inhale:
+/// rise time from 10% to 90% of the PEEP to inhale target step, overshoot past the target in % of the
+/// step, and settling time within kSettleBand of the target. Each lung runs with the gains under test
+/// (the configured ones, or --gains for every gain set) and with their derivative term off, to show what
+/// the filtered derivative does. The median over the measured respirations is reported per lung.
+/// Sessions run in parallel child processes, one worker thread per core.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "simulator.h"
+#include "runner.h"
+
+#include "configuration.h"
+#include "control.h"
+#include "datamodel.h"
+#include "serialportreader.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// \struct tStepLung
+/// \brief Lung of the measurement set
+struct tStepLung
+{
+    const char* szName;             ///> Report name
+    float       fCompliance;        ///> mL/mmH2O
+    float       fResistance;        ///> mmH2O/(mL/s)
+    float       fLeakResistance;    ///> mmH2O/(mL/s), 0 for none
+};
+
+static const tStepLung kLungs[] =
+{
+    { "normal",         5.0f,   0.10f,  0.0f },     // 50 mL/cmH2O, 10 cmH2O/(L/s)
+    { "stiff",          2.0f,   0.10f,  0.0f },     // ARDS
+    { "obstructive",    6.0f,   0.25f,  0.0f },     // COPD
+    { "leaky",          5.0f,   0.10f,  2.5f },     // Mask or cuff leak
+    { "small",          1.5f,   0.20f,  0.0f },     // Pediatric
+};
+static const int kLungCount = sizeof(kLungs) / sizeof(kLungs[0]);
+
+/// \enum eStepConsts
+/// \brief Harness constants
+enum eStepConsts
+{
+    kVariantCount       = 2,        ///> Configured gains, derivative off
+};
+
+static const char* const kVariantNames[kVariantCount] = { "gains", "no-derivative" };
+
+const float kRiseLow        = 0.1f;     // Rise time starts at this fraction of the step
+const float kRiseHigh       = 0.9f;     // Rise time ends at this fraction of the step
+const float kSettleBand     = 0.05f;    // Settled within this fraction of the step around the target
+
+/// \struct tStepProfile
+/// \brief Respiration profile of the sessions
+struct tStepProfile
+{
+    float       fInhale_mmH2O;      ///> Inhale pressure target
+    float       fExhale_mmH2O;      ///> Exhale pressure target (PEEP)
+    float       fRate;              ///> Respirations per minute
+    int         nSettleBreaths;     ///> Respirations before measuring
+    int         nMeasureBreaths;    ///> Measured respirations
+};
+
+/// \struct tStepBreath
+/// \brief Inhale response of a respiration
+struct tStepBreath
+{
+    float       fRise_ms;           ///> 10% to 90% of the step, negative when 90% is never reached
+    float       fOvershoot;         ///> Peak past the target, % of the step
+    float       fSettle_ms;         ///> Inhale start to the last exit of the settling band
+};
+
+/// \struct tStepSession
+/// \brief Session observer state
+struct tStepSession
+{
+    const tStepProfile* pProfile;
+    uint32_t        nLastControlTick;
+    bool            bInhale;            ///> Inhale being measured
+    uint32_t        nStart_ms;          ///> Inhale start
+    int64_t         nLow_ms;            ///> First reach of the low fraction, -1 before
+    int64_t         nHigh_ms;           ///> First reach of the high fraction, -1 before
+    int64_t         nOutside_ms;        ///> Last sample outside the settling band
+    float           fPeak_mmH2O;        ///> Highest pressure of the inhale
+    std::vector<tStepBreath> breaths;
+    bool            bError;
+};
+
+// Called after every loop iteration, samples the plant pressure of every inhale at every control tick
+static void Observe(void* pContext)
+{
+    tStepSession& session = *static_cast<tStepSession*>(pContext);
+    const tStepProfile& profile = *session.pProfile;
+    session.bError |= gDataModel.nState == kState_Error;
+
+    if (gDataModel.nTickControl == session.nLastControlTick)
+    {
+        return;
+    }
+    session.nLastControlTick = gDataModel.nTickControl;
+
+    float step = profile.fInhale_mmH2O - profile.fExhale_mmH2O;
+    bool bInhale = gDataModel.nCycleState == kCycleState_Inhale;
+    uint32_t breaths = gDataModel.nRespirationCount;
+    if (bInhale && !session.bInhale)
+    {
+        session.nStart_ms       = millis();
+        session.nLow_ms         = -1;
+        session.nHigh_ms        = -1;
+        session.nOutside_ms     = millis();
+        session.fPeak_mmH2O     = gPlant.fPressure_mmH2O;
+    }
+    else if (!bInhale && session.bInhale && breaths > (uint32_t)profile.nSettleBreaths &&
+             session.breaths.size() < (size_t)profile.nMeasureBreaths)
+    {
+        tStepBreath breath;
+        breath.fRise_ms     = (session.nLow_ms >= 0 && session.nHigh_ms >= 0) ? static_cast<float>(session.nHigh_ms - session.nLow_ms) : -1.0f;
+        breath.fOvershoot   = std::max(session.fPeak_mmH2O - profile.fInhale_mmH2O, 0.0f) / step * 100.0f;
+        breath.fSettle_ms   = static_cast<float>(session.nOutside_ms - session.nStart_ms);
+        session.breaths.push_back(breath);
+    }
+    session.bInhale = bInhale;
+
+    if (!bInhale)
+    {
+        return;
+    }
+
+    float pressure = gPlant.fPressure_mmH2O;
+    float fraction = (pressure - profile.fExhale_mmH2O) / step;
+    if (session.nLow_ms < 0 && fraction >= kRiseLow)
+    {
+        session.nLow_ms = millis();
+    }
+    if (session.nHigh_ms < 0 && fraction >= kRiseHigh)
+    {
+        session.nHigh_ms = millis();
+    }
+    if (fabsf(fraction - 1.0f) > kSettleBand)
+    {
+        session.nOutside_ms = millis();
+    }
+    session.fPeak_mmH2O = std::max(session.fPeak_mmH2O, pressure);
+}
+
+// Send a command and require its ACK
+static bool Command(const std::string& szFrame)
+{
+    std::string reply;
+    return Simulator_Command(szFrame, reply) && reply == "ACK";
+}
+
+// Median of the values, negative values (never reached) sort last
+static float Median(std::vector<float> values)
+{
+    if (values.empty())
+    {
+        return -1.0f;
+    }
+    std::sort(values.begin(), values.end(), [](float a, float b) { return (a < 0.0f) == (b < 0.0f) ? a < b : b < 0.0f; });
+    return values[values.size() / 2];
+}
+
+// Child process: one lung with a variant of the gains, prints the median response over the measured inhales
+static int RunSession(int nLung, int nVariant, const tStepProfile& profile)
+{
+    // Gains under test, before the simulator loads the configuration of its EEPROM
+    std::vector<float> gains;
+    for (const tGains& set : gConfiguration.pGains)
+    {
+        gains.insert(gains.end(), { set.fP, set.fI, nVariant == 0 ? set.fD : 0.0f });
+    }
+
+    const tStepLung& lung = kLungs[nLung];
+    tPlantParams params = Plant_DefaultParams();
+    params.fCompliance          = lung.fCompliance;
+    params.fAirwayResistance    = lung.fResistance;
+    params.fLeakResistance      = lung.fLeakResistance;
+
+    Simulator_Init(params, 1 + nLung);
+    Simulator_Run(kPeriodWarmup, nullptr, nullptr);
+
+    // Profile is set in the data model as CUR does once validated, CUR bounds don't cover therapy pressures in mmH2O.
+    // Curve ratios are in respiration periods per minute: inhale a third of the period, exhale the rest.
+    float period_s = 60.0f / profile.fRate;
+    Control_SetRespirationRate(profile.fRate);
+    gDataModel.fInhalePressureTarget_mmH2O = profile.fInhale_mmH2O;
+    gDataModel.fExhalePressureTarget_mmH2O = profile.fExhale_mmH2O;
+    gDataModel.fInhaleRatio                = profile.fRate * period_s / 3.0f;
+    gDataModel.fExhaleRatio                = profile.fRate * (period_s * 2.0f / 3.0f - kPeriodStabilization * 1e-3f);
+    updateCurve();
+
+    int8_t start = 1;
+    if (!Command(Simulator_Frame("SGP", gains)) ||
+        !Command(Simulator_FrameBytes("CYC", &start, sizeof(start))))
+    {
+        return 1;
+    }
+
+    tStepSession session = {};
+    session.pProfile = &profile;
+    uint32_t limit = (uint32_t)(period_s * 1000.0f * 2 * (profile.nSettleBreaths + profile.nMeasureBreaths + 1));
+    for (uint32_t elapsed = 0; elapsed < limit && session.breaths.size() < (size_t)profile.nMeasureBreaths; elapsed += 100)
+    {
+        Simulator_Run(100, Observe, &session);
+    }
+
+    std::vector<float> rises, overshoots, settles;
+    for (const tStepBreath& breath : session.breaths)
+    {
+        rises.push_back(breath.fRise_ms);
+        overshoots.push_back(breath.fOvershoot);
+        settles.push_back(breath.fSettle_ms);
+    }
+    printf("%f %f %f %d %d\n", Median(rises), Median(overshoots), Median(settles), (int)session.breaths.size(), session.bError ? 1 : 0);
+    return 0;
+}
+
+static void Usage()
+{
+    printf("usage: tlc_step [--gains P I D] [--inhale MMH2O] [--exhale MMH2O] [--rate N] [--settle N] [--measure N] [--threads N]\n");
+}
+
+int main(int argc, char** argv)
+{
+    tStepProfile profile = { 200.0f, 50.0f, 15.0f, 3, 10 };
+    unsigned threads = Runner_DefaultThreads();
+    int runLung = -1;
+    int runVariant = 0;
+    float pGains[3];
+    bool bGains = false;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        bool bValue = a + 1 < argc;
+        if (!strcmp(argv[a], "--run") && a + 2 < argc)
+        {
+            runLung     = std::min(std::max(atoi(argv[++a]), 0), kLungCount - 1);
+            runVariant  = std::min(std::max(atoi(argv[++a]), 0), kVariantCount - 1);
+        }
+        else if (!strcmp(argv[a], "--gains") && a + 3 < argc)
+        {
+            for (float& gain : pGains)
+            {
+                gain = (float)atof(argv[++a]);
+            }
+            bGains = true;
+        }
+        else if (!strcmp(argv[a], "--inhale") && bValue)    profile.fInhale_mmH2O = (float)atof(argv[++a]);
+        else if (!strcmp(argv[a], "--exhale") && bValue)    profile.fExhale_mmH2O = (float)atof(argv[++a]);
+        else if (!strcmp(argv[a], "--rate") && bValue)      profile.fRate = std::min(std::max((float)atof(argv[++a]), 6.0f), 40.0f);
+        else if (!strcmp(argv[a], "--settle") && bValue)    profile.nSettleBreaths = std::max(atoi(argv[++a]), 0);
+        else if (!strcmp(argv[a], "--measure") && bValue)   profile.nMeasureBreaths = std::max(atoi(argv[++a]), 1);
+        else if (!strcmp(argv[a], "--threads") && bValue)   threads = std::max(atoi(argv[++a]), 1);
+        else
+        {
+            Usage();
+            return 2;
+        }
+    }
+
+    if (profile.fInhale_mmH2O <= profile.fExhale_mmH2O)
+    {
+        Usage();
+        return 2;
+    }
+
+    // Configured gains are the firmware defaults, --gains replaces them in every gain set
+    Configuration_SetDefaults();
+    for (int a = 0; bGains && a < kGainSet_Count; ++a)
+    {
+        gConfiguration.pGains[a] = { pGains[0], pGains[1], pGains[2] };
+    }
+    if (runLung >= 0)
+    {
+        return RunSession(runLung, runVariant, profile);
+    }
+
+    std::string self = Runner_Self();
+    std::vector<std::string> commands;
+    for (int lung = 0; lung < kLungCount; ++lung)
+    {
+        for (int variant = 0; variant < kVariantCount; ++variant)
+        {
+            char command[512];
+            snprintf(command, sizeof(command), "'%s' --run %d %d --inhale %g --exhale %g --rate %g --settle %d --measure %d", self.c_str(), lung, variant,
+                     profile.fInhale_mmH2O, profile.fExhale_mmH2O, profile.fRate, profile.nSettleBreaths, profile.nMeasureBreaths);
+            std::string line = command;
+            if (bGains)
+            {
+                snprintf(command, sizeof(command), " --gains %.9g %.9g %.9g", pGains[0], pGains[1], pGains[2]);
+                line += command;
+            }
+            commands.push_back(line);
+        }
+    }
+
+    printf("Inhale %g mmH2O over PEEP %g mmH2O at %g/min, %d measured respirations after %d\n",
+           profile.fInhale_mmH2O, profile.fExhale_mmH2O, profile.fRate, profile.nMeasureBreaths, profile.nSettleBreaths);
+    fflush(stdout);
+    std::vector<std::string> outputs = Runner_Map(commands, threads);
+
+    printf("\nMedian inhale response, rise %d%%-%d%% of the step, settling within %d%% of the target:\n",
+           (int)(kRiseLow * 100.0f), (int)(kRiseHigh * 100.0f), (int)(kSettleBand * 100.0f));
+    printf("%-12s %-14s %9s %12s %10s %9s %7s\n", "lung", "gains", "rise ms", "overshoot %", "settle ms", "breaths", "error");
+    int failed = 0;
+    for (size_t a = 0; a < outputs.size(); ++a)
+    {
+        float rise, overshoot, settle;
+        int breaths, error;
+        if (sscanf(outputs[a].c_str(), "%f %f %f %d %d", &rise, &overshoot, &settle, &breaths, &error) != 5)
+        {
+            ++failed;
+            continue;
+        }
+
+        char riseText[16];
+        snprintf(riseText, sizeof(riseText), rise < 0.0f ? "-" : "%.0f", rise);
+        printf("%-12s %-14s %9s %12.1f %10.0f %9d %7d\n", kLungs[a / kVariantCount].szName, kVariantNames[a % kVariantCount],
+               riseText, overshoot, settle, breaths, error);
+    }
+
+    if (failed > 0)
+    {
+        printf("\nFAIL: %d sessions failed to run\n", failed);
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,357 @@
+///
+/// \file       trigger.cpp
+/// \brief      Patient trigger delay and false trigger rate on the host simulator
+///
+/// Runs ventilation sessions in semi-automatic trigger mode with randomized lung, sensor noise, PEEP and
+/// patient: periodic inspiratory efforts (muscle pressure of the plant) of random rate, strength and
+/// length, or a passive patient. Every seed runs twice, with the absolute pressure threshold alone
+/// (slope 0) and with the slope detector (--slope), so the two detectors see the same sessions.
+///
+/// An effort is triggerable when the cycle waits for a trigger at its onset. Its delay runs from the
+/// onset to the respiration it triggered; it is missed when it ends, or a timed respiration starts,
+/// first. A patient triggered respiration with no effort in progress is a false trigger, rated per hour
+/// of ventilation. Sessions run in parallel child processes, one worker thread per core.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include "simulator.h"
+#include "runner.h"
+#include "host.h"
+
+#include "configuration.h"
+#include "control.h"
+#include "datamodel.h"
+#include "serialportreader.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// \enum eTriggerConsts
+/// \brief Harness constants
+enum eTriggerConsts
+{
+    kEffortSettle_ms    = 5000,     ///> Efforts and observation start this long after ventilation, the controller settles first
+    kDetectorCount      = 2,        ///> Threshold alone, threshold and slope
+};
+
+static const char* const kDetectorNames[kDetectorCount] = { "threshold", "slope" };
+
+const float kPassiveShare   = 0.2f;     // Share of sessions with a passive patient, false triggers only
+const float kBackupRatio    = 0.6f;     // Backup respiration rate relative to the effort rate
+
+/// \struct tTriggerScenario
+/// \brief Randomized session
+struct tTriggerScenario
+{
+    tPlantParams    params;                 ///> Plant with its patient efforts
+    float           fInhale_mmH2O;          ///> Inhale pressure target
+    float           fExhale_mmH2O;          ///> Exhale pressure target, PEEP
+    float           fRate;                  ///> Backup respirations per minute
+};
+
+/// \struct tTriggerSession
+/// \brief Session observer state
+struct tTriggerSession
+{
+    float           fObserve_s;             ///> Observation start
+    float           fEffort_s;              ///> Start of the effort being tracked, negative when none
+    bool            bTriggerable;           ///> Tracked effort started while waiting for a trigger
+    bool            bResolved;              ///> Tracked effort triggered or was missed
+    uint32_t        nRespirationCount;      ///> gDataModel.nRespirationCount seen at the previous loop
+    uint32_t        nDeadline_us;           ///> Backup respiration deadline seen at the previous loop
+    std::vector<int64_t> delays;            ///> Delay of every triggered effort
+    int             nMissed;                ///> Triggerable efforts not triggered
+    int             nFalse;                 ///> Patient triggers with no effort in progress
+    int             nTimed;                 ///> Backup respirations
+};
+
+static float Uniform(std::mt19937& rng, float fLow, float fHigh)
+{
+    return std::uniform_real_distribution<float>(fLow, fHigh)(rng);
+}
+
+static float LogUniform(std::mt19937& rng, float fLow, float fHigh)
+{
+    return expf(Uniform(rng, logf(fLow), logf(fHigh)));
+}
+
+// Draw the scenario of a session from its seed, the same for every detector
+static tTriggerScenario DrawScenario(uint32_t nSeed)
+{
+    std::mt19937 rng(nSeed);
+    tTriggerScenario scenario = {};
+
+    tPlantParams& params = scenario.params;
+    params = Plant_DefaultParams();
+    params.fCompliance          = LogUniform(rng, 1.5f, 8.0f);
+    params.fAirwayResistance    = LogUniform(rng, 0.05f, 0.3f);
+    for (int a = 0; a < kPlantPressureChannelCount; ++a)
+    {
+        params.pSensors[a].fOffset_counts   = Uniform(rng, 35.0f, 47.0f);
+        params.pSensors[a].fNoise_counts    = Uniform(rng, 0.3f, 2.0f);
+    }
+
+    float effortRate = Uniform(rng, 10.0f, 20.0f);
+    if (Uniform(rng, 0.0f, 1.0f) >= kPassiveShare)
+    {
+        params.fEffortRate              = effortRate;
+        params.fEffortAmplitude_mmH2O   = LogUniform(rng, 10.0f, 80.0f);
+        params.fEffortDuration_s        = Uniform(rng, 0.5f, 1.0f);
+        params.fEffortOnset_s           = (kPeriodWarmup + kEffortSettle_ms) * 1e-3f + Uniform(rng, 0.0f, 60.0f / effortRate);
+    }
+
+    // Absolute threshold stays the configured one, PEEP is kept above it
+    scenario.fInhale_mmH2O  = Uniform(rng, 150.0f, 250.0f);
+    scenario.fExhale_mmH2O  = Uniform(rng, gConfiguration.fPatientTrigger_mmH2O + 10.0f, gConfiguration.fPatientTrigger_mmH2O + 40.0f);
+    scenario.fRate          = effortRate * kBackupRatio;
+    return scenario;
+}
+
+// Called after every loop iteration, follows the efforts of the plant and the respirations they trigger
+static void Observe(void* pContext)
+{
+    tTriggerSession& session = *static_cast<tTriggerSession*>(pContext);
+    if (gPlant.fTime_s < session.fObserve_s)
+    {
+        // First respiration starts on the atmospheric pressure below the threshold, not on a patient
+        session.nRespirationCount   = gDataModel.nRespirationCount;
+        session.nDeadline_us        = gDataModel.nRespirationDeadline_us;
+        return;
+    }
+
+    float effort = Plant_EffortStart(gPlant.fTime_s);
+
+    // Effort ended untriggered
+    if (session.fEffort_s >= 0.0f && effort != session.fEffort_s)
+    {
+        session.nMissed += (session.bTriggerable && !session.bResolved) ? 1 : 0;
+        session.fEffort_s = -1.0f;
+    }
+
+    if (gDataModel.nRespirationCount != session.nRespirationCount)
+    {
+        // Backup respiration when its deadline was reached, patient triggered otherwise
+        bool bTimed = static_cast<int32_t>(micros() - session.nDeadline_us) >= 0;
+        if (bTimed)
+        {
+            ++session.nTimed;
+            if (session.fEffort_s >= 0.0f && session.bTriggerable && !session.bResolved)
+            {
+                ++session.nMissed;
+                session.bResolved = true;
+            }
+        }
+        else if (session.fEffort_s >= 0.0f && session.bTriggerable && !session.bResolved)
+        {
+            session.delays.push_back(static_cast<int64_t>((gPlant.fTime_s - session.fEffort_s) * 1000.0f));
+            session.bResolved = true;
+        }
+        else if (effort < 0.0f)
+        {
+            ++session.nFalse;
+        }
+    }
+
+    // New effort, triggerable when the cycle waits for a trigger at its onset
+    if (effort >= 0.0f && session.fEffort_s < 0.0f && gDataModel.nRespirationCount == session.nRespirationCount)
+    {
+        session.fEffort_s       = effort;
+        session.bTriggerable    = gDataModel.nCycleState == kCycleState_WaitTrigger;
+        session.bResolved       = false;
+    }
+    else if (effort >= 0.0f && session.fEffort_s < 0.0f)
+    {
+        // Respiration started at the effort onset, before it was seen
+        session.fEffort_s       = effort;
+        session.bTriggerable    = false;
+        session.bResolved       = true;
+    }
+
+    session.nRespirationCount   = gDataModel.nRespirationCount;
+    session.nDeadline_us        = gDataModel.nRespirationDeadline_us;
+}
+
+// Send a command and require its ACK
+static bool Command(const std::string& szFrame)
+{
+    std::string reply;
+    return Simulator_Command(szFrame, reply) && reply == "ACK";
+}
+
+// Child process: one session with a detector, prints its ventilation time, counts and every delay
+static int RunSession(uint32_t nSeed, float fDuration_s, float fSlope_mmH2O_s)
+{
+    // Defaults the scenario draw reads, before the firmware loads its configuration
+    Configuration_SetDefaults();
+    tTriggerScenario scenario = DrawScenario(nSeed);
+
+    Simulator_Init(scenario.params, nSeed);
+    Simulator_Run(kPeriodWarmup, nullptr, nullptr);
+
+    // Profile is set in the data model as CUR does once validated, CUR bounds don't cover therapy pressures in mmH2O.
+    // Curve ratios are in respiration periods per minute: 1 s inhale, 1.2 s exhale.
+    Control_SetRespirationRate(scenario.fRate);
+    gDataModel.fInhalePressureTarget_mmH2O = scenario.fInhale_mmH2O;
+    gDataModel.fExhalePressureTarget_mmH2O = scenario.fExhale_mmH2O;
+    gDataModel.fInhaleRatio                = scenario.fRate * 1.0f;
+    gDataModel.fExhaleRatio                = scenario.fRate * 1.2f;
+    updateCurve();
+
+    int32_t mode = kTriggerMode_PatientSemiAutomatic;
+    int8_t start = 1;
+    if (!Command(Simulator_FrameBytes("TRI", &mode, sizeof(mode))) ||
+        !Command(Simulator_Frame("STR", { gConfiguration.fPatientTrigger_mmH2O, fSlope_mmH2O_s, static_cast<float>(gConfiguration.nPatientTriggerRefractory_ms) })) ||
+        !Command(Simulator_FrameBytes("CYC", &start, sizeof(start))))
+    {
+        return 1;
+    }
+
+    tTriggerSession session = {};
+    session.fObserve_s          = (kPeriodWarmup + kEffortSettle_ms) * 1e-3f;
+    session.fEffort_s           = -1.0f;
+    session.nRespirationCount   = gDataModel.nRespirationCount;
+    session.nDeadline_us        = gDataModel.nRespirationDeadline_us;
+
+    Simulator_Run(static_cast<uint32_t>(fDuration_s * 1000.0f), Observe, &session);
+    bool bStopped = gDataModel.nState != kState_Process;
+
+    uint32_t observed = static_cast<uint32_t>(std::max(gPlant.fTime_s - session.fObserve_s, 0.0f) * 1000.0f);
+    printf("S %u %d %d %d %d\n", observed, session.nMissed, session.nFalse, session.nTimed, bStopped ? 1 : 0);
+    for (int64_t delay : session.delays)
+    {
+        printf("D %lld\n", (long long)delay);
+    }
+    return 0;
+}
+
+/// \struct tDetectorStats
+/// \brief Outcomes of a detector over every session
+struct tDetectorStats
+{
+    std::vector<int64_t>    delays;
+    int                     nMissed;
+    int                     nFalse;
+    int                     nTimed;
+    int                     nStopped;
+    int                     nFailed;
+    double                  fVentilation_ms;
+};
+
+// Nearest rank percentile of sorted values
+static int64_t Percentile(const std::vector<int64_t>& sorted, float fRank)
+{
+    if (sorted.empty())
+    {
+        return -1;
+    }
+    size_t index = static_cast<size_t>(ceilf(fRank * sorted.size()));
+    return sorted[std::min(std::max<size_t>(index, 1), sorted.size()) - 1];
+}
+
+static void Usage()
+{
+    printf("usage: tlc_trigger [--sessions N] [--seed N] [--duration S] [--slope MMH2O_S] [--threads N]\n");
+}
+
+int main(int argc, char** argv)
+{
+    int sessions = 200;
+    uint32_t seed = 1;
+    float duration = 60.0f;
+    unsigned threads = Runner_DefaultThreads();
+    long long runSeed = -1;
+
+    // Slope of the configuration defaults
+    Configuration_SetDefaults();
+    float slope = gConfiguration.fPatientTriggerSlope_mmH2O_s;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        bool bValue = a + 1 < argc;
+        if (!strcmp(argv[a], "--run") && bValue)                runSeed = atoll(argv[++a]);
+        else if (!strcmp(argv[a], "--sessions") && bValue)      sessions = std::max(atoi(argv[++a]), 1);
+        else if (!strcmp(argv[a], "--seed") && bValue)          seed = strtoul(argv[++a], nullptr, 0);
+        else if (!strcmp(argv[a], "--duration") && bValue)      duration = std::max((float)atof(argv[++a]), 10.0f);
+        else if (!strcmp(argv[a], "--slope") && bValue)         slope = std::max((float)atof(argv[++a]), 0.0f);
+        else if (!strcmp(argv[a], "--threads") && bValue)       threads = std::max(atoi(argv[++a]), 1);
+        else
+        {
+            Usage();
+            return 2;
+        }
+    }
+
+    if (runSeed >= 0)
+    {
+        return RunSession(static_cast<uint32_t>(runSeed), duration, slope);
+    }
+
+    std::string self = Runner_Self();
+    std::vector<std::string> commands;
+    for (int a = 0; a < sessions; ++a)
+    {
+        for (int b = 0; b < kDetectorCount; ++b)
+        {
+            char command[512];
+            snprintf(command, sizeof(command), "'%s' --run %u --duration %g --slope %g", self.c_str(), seed + a, duration, b == 0 ? 0.0f : slope);
+            commands.push_back(command);
+        }
+    }
+
+    printf("Sessions: %d of %gs from seed %u on %u workers, slope %g mmH2O/s\n", sessions, duration, seed, threads, slope);
+    fflush(stdout);
+    std::vector<std::string> outputs = Runner_Map(commands, threads);
+
+    tDetectorStats stats[kDetectorCount] = {};
+    for (size_t a = 0; a < outputs.size(); ++a)
+    {
+        tDetectorStats& detector = stats[a % kDetectorCount];
+        unsigned ventilation;
+        int missed, falseCount, timed, stopped;
+        const char* pLine = outputs[a].c_str();
+        if (sscanf(pLine, "S %u %d %d %d %d", &ventilation, &missed, &falseCount, &timed, &stopped) != 5)
+        {
+            ++detector.nFailed;
+            continue;
+        }
+        detector.fVentilation_ms   += ventilation;
+        detector.nMissed           += missed;
+        detector.nFalse            += falseCount;
+        detector.nTimed            += timed;
+        detector.nStopped          += stopped;
+
+        for (pLine = strchr(pLine, '\n'); pLine != nullptr; pLine = strchr(pLine + 1, '\n'))
+        {
+            long long delay;
+            if (sscanf(pLine + 1, "D %lld", &delay) == 1)
+            {
+                detector.delays.push_back(delay);
+            }
+        }
+    }
+
+    printf("\nTrigger delay in ms from effort onset, false triggers per hour of ventilation:\n");
+    printf("%-10s %9s %9s %9s %8s %8s %8s %8s %9s %9s %8s\n", "detector", "efforts", "triggered", "missed", "p50", "p95", "max", "false", "per hour", "backup", "stopped");
+    bool bPass = true;
+    for (int a = 0; a < kDetectorCount; ++a)
+    {
+        tDetectorStats& detector = stats[a];
+        std::sort(detector.delays.begin(), detector.delays.end());
+        int triggered = static_cast<int>(detector.delays.size());
+        double hours = detector.fVentilation_ms / 3.6e6;
+        printf("%-10s %9d %9d %9d %8lld %8lld %8lld %8d %9.2f %9d %8d\n", kDetectorNames[a], triggered + detector.nMissed, triggered, detector.nMissed,
+               (long long)Percentile(detector.delays, 0.50f), (long long)Percentile(detector.delays, 0.95f),
+               (long long)(detector.delays.empty() ? -1 : detector.delays.back()), detector.nFalse, hours > 0.0 ? detector.nFalse / hours : 0.0,
+               detector.nTimed, detector.nStopped);
+        bPass &= detector.nFailed == 0;
+    }
+
+    if (!bPass)
+    {
+        printf("\nFAIL: %d sessions failed to run\n", stats[0].nFailed + stats[1].nFailed);
+    }
+    return bPass ? 0 : 1;
+}
@@ -0,0 +1,293 @@
+///
+/// \file       wcet.cpp
+/// \brief      Worst-case execution time gate of the device image on simavr
+///
+/// Runs the tlc.ino image built by avr-gcc on simavr, a cycle-accurate ATmega328P at 16 MHz, with scripted
+/// inputs: a respiration waveform on both pressure channels and a full battery on the ADC, then serial
+/// traffic while ventilating, with adversarial bursts (max-length SGP arrays, back-to-back STA, CAL with
+/// every point, garbage). The firmware times its own tasks with micros() (WCT), simavr runs micros() from
+/// the emulated Timer0, so the worst times it reports are those of the device cycles, at the 4 us
+/// resolution of micros(). Fails when a loop iteration exceeded the budget of one control period.
+///
+/// Exit code 0 passes, 1 fails, 77 skips (no image): ctest SKIP_RETURN_CODE.
+///
+/// \author     The Lung Carburetor contributors
+/// \ingroup    simulator
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_adc.h>
+#include <simavr/avr_uart.h>
+
+#include "simulator.h"
+
+#include "configuration.h"
+#include "tasktiming.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/// \enum eWcetConsts
+/// \brief Harness constants
+enum eWcetConsts
+{
+    kWcetFrequency      = 16000000,                         ///> Arduino Uno clock
+    kWcetCyclesPerMs    = kWcetFrequency / 1000,
+    kWcetByteCycles     = kWcetFrequency / (kSerialBaudRate / 10),  ///> Cycles per byte on the wire, 8N1
+    kWcetVcc_mV         = 5000,                             ///> AVcc, ADC reference
+    kWcetExitSkip       = 77,                               ///> ctest SKIP_RETURN_CODE
+};
+
+const float kSensorOffset_mV    = 200.0f;   // MPX5010 output at atmosphere
+const float kBattery_V          = 12.6f;    // Full battery
+const float kInhale_mmH2O       = 250.0f;   // Waveform the pressure channels read
+const float kExhale_mmH2O       = 50.0f;
+const float kRate               = 20.0f;    // Respirations per minute of the waveform
+
+/// \struct tHarness
+/// \brief Simulated device and its serial port
+struct tHarness
+{
+    avr_t*      pAvr;
+    avr_irq_t*  pUartInput;
+    avr_irq_t*  pAdc[kSensor_Count];
+    bool        bXon;                       ///> UART input FIFO takes bytes
+    std::string szTx;                       ///> Bytes to send, paced at the baud rate
+    avr_cycle_count_t nNextByte;            ///> Cycle of the next byte on the wire
+    std::string szRx;                       ///> Bytes sent by the firmware
+};
+static tHarness gHarness;
+
+static void OnUartOutput(avr_irq_t*, uint32_t nValue, void*)
+{
+    gHarness.szRx.push_back(static_cast<char>(nValue));
+}
+
+static void OnUartXon(avr_irq_t*, uint32_t, void*)
+{
+    gHarness.bXon = true;
+}
+
+static void OnUartXoff(avr_irq_t*, uint32_t, void*)
+{
+    gHarness.bXon = false;
+}
+
+// Pressure both channels read at time fTime_s: exhale level, ramp to the inhale level over a third of the inhale
+static float Waveform(float fTime_s)
+{
+    float period = 60.0f / kRate;
+    float phase = fmodf(fTime_s, period) / period;
+    if (phase >= 1.0f / 3.0f)
+    {
+        return kExhale_mmH2O;
+    }
+    return kExhale_mmH2O + (kInhale_mmH2O - kExhale_mmH2O) * fminf(phase * 9.0f, 1.0f);
+}
+
+static void SetAdc(float fTime_s)
+{
+    float pressure_mV = kSensorOffset_mV + Waveform(fTime_s) * kMPX5010_Sensitivity_mV_mmH2O;
+    avr_raise_irq(gHarness.pAdc[kSensor_Pressure0], static_cast<uint32_t>(pressure_mV));
+    avr_raise_irq(gHarness.pAdc[kSensor_Pressure1], static_cast<uint32_t>(pressure_mV));
+    avr_raise_irq(gHarness.pAdc[kSensor_Battery], static_cast<uint32_t>(kBattery_V / kBatteryLevelGain * 1000.0f));
+}
+
+// Run the device for nDuration_ms, feeding serial bytes and ADC inputs. Returns false if the cpu stopped.
+static bool Run(uint32_t nDuration_ms)
+{
+    avr_t* avr = gHarness.pAvr;
+    avr_cycle_count_t end = avr->cycle + static_cast<avr_cycle_count_t>(nDuration_ms) * kWcetCyclesPerMs;
+    avr_cycle_count_t nextAdc = avr->cycle;
+    while (avr->cycle < end)
+    {
+        int state = avr_run(avr);
+        if (state == cpu_Done || state == cpu_Crashed)
+        {
+            return false;
+        }
+
+        if (avr->cycle >= nextAdc)
+        {
+            SetAdc(static_cast<float>(avr->cycle) / kWcetFrequency);
+            nextAdc = avr->cycle + kWcetCyclesPerMs;
+        }
+
+        if (gHarness.bXon && !gHarness.szTx.empty() && avr->cycle >= gHarness.nNextByte)
+        {
+            avr_raise_irq(gHarness.pUartInput, static_cast<uint8_t>(gHarness.szTx[0]));
+            gHarness.szTx.erase(0, 1);
+            gHarness.nNextByte = avr->cycle + kWcetByteCycles;
+        }
+    }
+    return true;
+}
+
+// Send a frame and wait until it is on the wire
+static bool Send(const std::string& szFrame)
+{
+    gHarness.szTx += szFrame;
+    while (!gHarness.szTx.empty())
+    {
+        if (!Run(1))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int Fail(const char* szMessage)
+{
+    printf("FAIL: %s\n", szMessage);
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: tlc_wcet tlc.ino.elf\n");
+        return 2;
+    }
+
+    elf_firmware_t firmware = {};
+    if (elf_read_firmware(argv[1], &firmware) != 0)
+    {
+        printf("SKIP: no firmware image %s, build it with the Arduino IDE or arduino-cli (avr-gcc)\n", argv[1]);
+        return kWcetExitSkip;
+    }
+
+    avr_t* avr = avr_make_mcu_by_name("atmega328p");
+    if (avr == nullptr)
+    {
+        return Fail("simavr has no atmega328p core");
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+    avr->frequency  = kWcetFrequency;
+    avr->vcc        = kWcetVcc_mV;
+    avr->avcc       = kWcetVcc_mV;
+    avr->aref       = kWcetVcc_mV;
+    gHarness.pAvr   = avr;
+
+    // Serial port: raw bytes both ways, input paced by the UART FIFO flow control
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    gHarness.pUartInput = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), OnUartOutput, nullptr);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XON), OnUartXon, nullptr);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XOFF), OnUartXoff, nullptr);
+    gHarness.bXon = true;
+
+    // Sensors are wired in eSensor order on ADC0..ADC2
+    for (uint8_t a = 0; a < kSensor_Count; ++a)
+    {
+        gHarness.pAdc[a] = avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + a);
+    }
+
+    // Boot and warmup, then ventilate on the waveform
+    int8_t start = 1;
+    if (!Run(kPeriodWarmup + 500) ||
+        !Send(Simulator_FrameBytes("CUR", std::vector<float>{ kRate, 30.0f, 5.0f, 1.0f, 2.0f }.data(), 5 * sizeof(float))) ||
+        !Send(Simulator_FrameBytes("CYC", &start, sizeof(start))) ||
+        !Run(3000))
+    {
+        return Fail("cpu stopped during warmup");
+    }
+
+    // Timing of the adversarial traffic only
+    uint8_t clear = 1;
+    if (!Send(Simulator_FrameBytes("WCT", &clear, sizeof(clear))) || !Run(100))
+    {
+        return Fail("cpu stopped");
+    }
+
+    // Default gains of every gain set, the control keeps running as configured
+    Configuration_SetDefaults();
+    std::vector<float> gains;
+    for (int a = 0; a < kGainSet_Count; ++a)
+    {
+        gains.insert(gains.end(), { gConfiguration.pGains[a].fP, gConfiguration.pGains[a].fI, gConfiguration.pGains[a].fD });
+    }
+    std::vector<float> calibration = { 0.0f };
+    for (int a = 0; a < kCalibrationPointCount; ++a)
+    {
+        calibration.push_back(41.0f + a * 100.0f);
+        calibration.push_back(a * 100.0f / (kMPX5010_Sensitivity_mV_mmH2O * 1024.0f / 5000.0f));
+    }
+
+    std::string garbage;
+    srand(1);
+    for (int a = 0; a < kRxBufferSize; ++a)
+    {
+        garbage.push_back(static_cast<char>(rand() & 0xFF));
+    }
+
+    for (int round = 0; round < 20; ++round)
+    {
+        std::string burst;
+        for (int a = 0; a < 8; ++a)
+        {
+            burst += Simulator_Frame("SGP", gains);
+        }
+        for (int a = 0; a < 16; ++a)
+        {
+            burst += Simulator_Frame("STA", {});
+        }
+        burst += Simulator_Frame("CAL", calibration);
+        burst += garbage + "\r\n";
+
+        if (!Send(burst) || !Run(200))
+        {
+            return Fail("cpu stopped under serial traffic");
+        }
+    }
+
+    // Worst times: budget, every eTask, overrun count, last overrun tick
+    gHarness.szRx.clear();
+    if (!Send(Simulator_Frame("WCT", {})) || !Run(100))
+    {
+        return Fail("cpu stopped");
+    }
+
+    std::vector<unsigned long> values;
+    size_t begin = 0;
+    for (size_t end = gHarness.szRx.find("\r\n"); end != std::string::npos && values.size() != kTask_Count + 3; end = gHarness.szRx.find("\r\n", begin))
+    {
+        std::string line = gHarness.szRx.substr(begin, end - begin);
+        begin = end + 2;
+
+        values.clear();
+        for (char* p = &line[0]; *p != '\0'; )
+        {
+            char* next;
+            values.push_back(strtoul(p, &next, 10));
+            p = (*next == ',') ? next + 1 : (next == p ? p + strlen(p) : next);
+        }
+    }
+    if (values.size() != kTask_Count + 3)
+    {
+        return Fail("no WCT reply");
+    }
+
+    static const char* const kTaskNames[kTask_Count] = { "Communications", "Sensors", "Control", "LcdKeypad", "Safeties", "Loop" };
+    unsigned long budget = values[0];
+    printf("%-16s %10s %12s\n", "task", "worst us", "worst cycles");
+    for (int a = 0; a < kTask_Count; ++a)
+    {
+        printf("%-16s %10lu %12lu\n", kTaskNames[a], values[1 + a], values[1 + a] * (kWcetFrequency / 1000000));
+    }
+    printf("budget %lu us, %lu overruns\n", budget, values[1 + kTask_Count]);
+
+    if (values[1 + kTask_Count] != 0 || values[kTask_Loop + 1] > budget)
+    {
+        return Fail("a loop iteration exceeded the control period");
+    }
+    return 0;
+}